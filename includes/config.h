@@ -58,7 +58,9 @@ Source: Conversation with Bing, 21/8/2023
 #define portGET_RUN_TIME_COUNTER_VALUE() usecTimestamp()
 
 
-// Task priorities. Higher number higher priority
+// Task priorities, from the FreeRTOS firmware: higher number higher priority.
+// The threads are created with these numbers unchanged, so under Zephyr they
+// run the other way round, a lower number preempts a higher one.
 #define PASSTHROUGH_TASK_PRI    5
 #define STABILIZER_TASK_PRI     5
 #define SENSORS_TASK_PRI        4
@@ -79,7 +81,6 @@ Source: Conversation with Bing, 21/8/2023
 #define USDLOG_TASK_PRI         1
 #define USDWRITE_TASK_PRI       0
 #define PCA9685_TASK_PRI        2
-#define CMD_HIGH_LEVEL_TASK_PRI 2
 #define BQ_OSD_TASK_PRI         1
 #define GTGPS_DECK_TASK_PRI     1
 #define LIGHTHOUSE_TASK_PRI     3
@@ -99,6 +100,14 @@ Source: Conversation with Bing, 21/8/2023
 #define CRTP_SRV_TASK_PRI       0
 #define PLATFORM_SRV_TASK_PRI   0
 
+// Task priorities in Zephyr numbering, lower number higher priority, for the
+// tasks that have to run above or below the stabilizer
+#define RATE_LOOP_TASK_PRI        (STABILIZER_TASK_PRI - 1) // preempts the stabilizer
+#define DYN_NOTCH_TASK_PRI        (STABILIZER_TASK_PRI + 1)
+#define CMD_HIGH_LEVEL_TASK_PRI   (STABILIZER_TASK_PRI + 1) // decodes and solves must not delay the stabilizer
+#define CONTROLLER_BENCH_TASK_PRI (STABILIZER_TASK_PRI + 2) // below every other task
+#define ESTIMATOR_REPLAY_TASK_PRI (STABILIZER_TASK_PRI + 2) // below every other task
+
 // Not compiled
 #if 0
   #define INFO_TASK_PRI           2
@@ -119,6 +128,7 @@ Source: Conversation with Bing, 21/8/2023
 #define PARAM_TASK_NAME         "PARAM"
 #define SENSORS_TASK_NAME       "SENSORS"
 #define STABILIZER_TASK_NAME    "STABILIZER"
+#define RATE_LOOP_TASK_NAME     "RATELOOP"
 #define NRF24LINK_TASK_NAME     "NRF24LINK"
 #define ESKYLINK_TASK_NAME      "ESKYLINK"
 #define SYSLINK_TASK_NAME       "SYSLINK"
@@ -142,6 +152,7 @@ Source: Conversation with Bing, 21/8/2023
 #define UART1_TEST_TASK_NAME    "UART1TEST"
 #define UART2_TEST_TASK_NAME    "UART2TEST"
 #define KALMAN_TASK_NAME        "KALMAN"
+#define DYN_NOTCH_TASK_NAME     "DYNNOTCH"
 #define ERROR_UKF_TASK_NAME     "ERROR_UKF"
 #define ACTIVE_MARKER_TASK_NAME "ACTIVEMARKER-DECK"
 #define AI_DECK_GAP_TASK_NAME   "AI-DECK-GAP"
@@ -156,6 +167,8 @@ Source: Conversation with Bing, 21/8/2023
 #define CPX_TASK_NAME           "CPX"
 #define APP_TASK_NAME           "APP"
 #define FLAPPERDECK_TASK_NAME   "FLAPPERDECK"
+#define CONTROLLER_BENCH_TASK_NAME "CTRLBENCH"
+#define ESTIMATOR_REPLAY_TASK_NAME "ESTREPLAY"
 
 
 // -------Task stack sizes----------
@@ -179,6 +192,7 @@ We are setting the configMINIMAL_STACK_SIZE as 1024 right now below
 #define PARAM_TASK_STACKSIZE          (2 * configMINIMAL_STACK_SIZE)
 #define SENSORS_TASK_STACKSIZE        (2 * configMINIMAL_STACK_SIZE)
 #define STABILIZER_TASK_STACKSIZE     (3 * configMINIMAL_STACK_SIZE)
+#define RATE_LOOP_TASK_STACKSIZE      configMINIMAL_STACK_SIZE
 #define NRF24LINK_TASK_STACKSIZE      configMINIMAL_STACK_SIZE
 #define ESKYLINK_TASK_STACKSIZE       configMINIMAL_STACK_SIZE
 #define SYSLINK_TASK_STACKSIZE        (2 * configMINIMAL_STACK_SIZE)
@@ -208,8 +222,11 @@ We are setting the configMINIMAL_STACK_SIZE as 1024 right now below
 #define LPS_DECK_STACKSIZE            (3 * configMINIMAL_STACK_SIZE)
 #define OA_DECK_TASK_STACKSIZE        (2 * configMINIMAL_STACK_SIZE)
 #define KALMAN_TASK_STACKSIZE         (3 * configMINIMAL_STACK_SIZE)
+#define DYN_NOTCH_TASK_STACKSIZE      (2 * configMINIMAL_STACK_SIZE)
 #define FLAPPERDECK_TASK_STACKSIZE    (2 * configMINIMAL_STACK_SIZE)
 #define ERROR_UKF_TASK_STACKSIZE      (4 * configMINIMAL_STACK_SIZE)
+#define CONTROLLER_BENCH_TASK_STACKSIZE (3 * configMINIMAL_STACK_SIZE)
+#define ESTIMATOR_REPLAY_TASK_STACKSIZE KALMAN_TASK_STACKSIZE
 
 //The radio channel. From 0 to 125
 #define RADIO_CHANNEL 80
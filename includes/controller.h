@@ -25,6 +25,16 @@ void controller(control_t *control, const setpoint_t *setpoint,
                                          const state_t *state,
                                          const uint32_t tick);
 ControllerType controllerGetType(void);
+
+/**
+ * Request another controller at runtime. The new controller is initialized
+ * here, by the caller, and the stabilizer switches to it in its next
+ * controller() call, seeding it from the last output of the current one.
+ *
+ * @return 0 on success, EINVAL if the controller is not available in this
+ *         build, EBUSY if the current controller can not be released
+ */
+int controllerRequest(ControllerType controller);
 const char* controllerGetName();
 
 
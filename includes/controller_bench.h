@@ -0,0 +1,63 @@
+/**
+ * controller_bench.h - On-target benchmark of the controllers, filters,
+ * estimator covariance updates and math3d kernels
+ */
+
+#ifndef __CONTROLLER_BENCH_H__
+#define __CONTROLLER_BENCH_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+  ControllerBenchYawVelocity,  // controllerPid(), manual attitude, yaw rate setpoint
+  ControllerBenchYawAbs,       // controllerPid(), manual attitude, absolute yaw setpoint
+  ControllerBenchPosition,     // controllerPid(), absolute position setpoint
+  ControllerBenchThrustZero,   // controllerPid(), thrust zero reset path
+  ControllerBenchAttitude,     // attitude and rate PIDs alone
+  ControllerBenchPositionOnly, // positionController() alone
+  ControllerBenchRate,         // rate PIDs alone, as run by the split rate loop
+  ControllerBenchLpf2p,        // lpf2pApply() on three axes
+  ControllerBenchBank1,        // filterBank3Apply() with one low pass stage
+  ControllerBenchBank2,        // filterBank3Apply() with a low pass and a notch stage
+  ControllerBenchKcPredict,    // kalmanCovPredict() of the 9 state Kalman filter
+  ControllerBenchKcPredictDense, // the same prediction with dense arm_mat_mult_f32()
+  ControllerBenchKcUpdate,     // kalmanCovScalarUpdate() of a measurement of 3 states
+  ControllerBenchKcUpdateDense, // the same update with dense arm_mat_mult_f32()
+  ControllerBenchQvrot,        // qvrot() of 16 vectors, by value
+  ControllerBenchQvrotBatch,   // qvrot_batch() of 16 vectors
+  ControllerBenchQvrotAccum,   // vadd(), vscl() and qvrot() of 16 vectors, by value
+  ControllerBenchQvrotAccumBatch, // qvrot_accum_batch() of 16 vectors
+  ControllerBenchMmul,         // chain of 4 mmul(), by value
+  ControllerBenchMmulChain,    // mmul_chain() of 4 matrices
+  ControllerBench_COUNT,
+} ControllerBenchCase;
+
+typedef struct {
+  uint32_t calls;
+  uint32_t avgCycles;
+  uint32_t maxCycles;
+} controllerBenchResult_t;
+
+/**
+ * Start the benchmark thread, which runs the benchmark when the
+ * controllerBench.run parameter is set.
+ */
+void controllerBenchInit(void);
+
+/**
+ * Run all benchmark cases on a synthetic flight trace. Takes the PID
+ * controller from the stabilizer for the run and resets it afterwards, so it
+ * refuses to run while armed.
+ *
+ * @return 0 on success, EBUSY if the system is armed or the controller is busy
+ */
+int controllerBenchRun(void);
+
+/**
+ * Result of the last run of a case. The unit is CPU cycles on target and
+ * nanoseconds on native_sim.
+ */
+const controllerBenchResult_t* controllerBenchGetResult(ControllerBenchCase benchCase);
+
+#endif //__CONTROLLER_BENCH_H__
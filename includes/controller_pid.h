@@ -5,7 +5,11 @@
 #ifndef __CONTROLLER_PID_H__
 #define __CONTROLLER_PID_H__
 
+#include <stdbool.h>
+#include <zephyr/kernel.h>
+
 #include "stabilizer_types.h"
+#include "imu_types.h"
 
 void controllerPidInit(void);
 bool controllerPidTest(void);
@@ -14,4 +18,45 @@ void controllerPid(control_t *control, const setpoint_t *setpoint,
                                          const state_t *state,
                                          const uint32_t tick);
 
+/**
+ * Seed the PID controller when it takes over from another controller. The
+ * attitude setpoint starts at the current attitude and the thrust at the last
+ * thrust of the previous controller.
+ */
+void controllerPidHandover(const control_t *lastControl, const state_t *state);
+
+/**
+ * Take the PID controller away from the stabilizer and the rate loop for an
+ * offline run, such as the controller benchmark. Until controllerPidRelease(),
+ * controllerPid() called from other threads and controllerPidRateLoop()
+ * output zero and leave the PID state alone.
+ *
+ * @param timeout How long to wait for the stabilizer to finish its update
+ * @return true if taken, false on timeout
+ */
+bool controllerPidAcquire(k_timeout_t timeout);
+
+/**
+ * Reset the PIDs and hand the controller back to the stabilizer.
+ */
+void controllerPidRelease(void);
+
+/**
+ * Split the rate loop off controllerPid(). When enabled, controllerPid() only
+ * runs the position and attitude loops and outputs the thrust, with no roll,
+ * pitch or yaw. controllerPidRateLoop() runs the rate loop with each new gyro
+ * sample, and its output drives the motors, see rateLoopInit().
+ */
+void controllerPidEnableRateLoop(bool enable);
+bool controllerPidRateLoopEnabled(void);
+
+/**
+ * Run the rate loop on the rates last published by controllerPid(). Must be
+ * called at IMU_UPDATE_FREQ and from a context that preempts the stabilizer.
+ *
+ * @param control Output to the power distribution
+ * @param gyro    Gyro sample in deg/s
+ */
+void controllerPidRateLoop(control_t *control, const Axis3f *gyro);
+
 #endif //__CONTROLLER_PID_H__
@@ -46,6 +46,7 @@ Header file for high-level commander that computes smooth setpoints based on hig
 #include "math3d.h"
 
 #include "stabilizer_types.h"
+#include "crtp.h"
 
 #define NUM_TRAJECTORY_DEFINITIONS 10
 
@@ -172,6 +173,119 @@ int crtpCommanderHighLevelDisable();
  */
 int crtpCommanderHighLevelGoTo(const float x, const float y, const float z, const float yaw, const float duration_s, const bool relative);
 
+/**
+ * @brief Append a waypoint to the list flown by crtpCommanderHighLevelGoToWaypoints()
+ *
+ * @param x          x (m)
+ * @param y          y (m)
+ * @param z          z (m)
+ * @param yaw        yaw (rad)
+ * @param duration_s time it should take to fly from the previous waypoint to this one (s)
+ * @param clear      true to discard the previously added waypoints first
+ * @return zero if the command succeeded, an error code otherwise
+ */
+int crtpCommanderHighLevelAddWaypoint(const float x, const float y, const float z, const float yaw, const float duration_s, const bool clear);
+
+/**
+ * @brief Fly a minimum snap trajectory through the added waypoints, then hover at the last one
+ *
+ * The trajectory is planned on-board, the time of the solve is logged as hlCommander.planSolve.
+ *
+ * @param relative   true if the waypoints are relative to the current position
+ * @return zero if the command succeeded, an error code otherwise
+ */
+int crtpCommanderHighLevelGoToWaypoints(const bool relative);
+
+/**
+ * @brief Queue a go to an absolute or relative position
+ *
+ * Queued commands start exactly when the trajectory before them ends, from its
+ * final position, velocity and acceleration. If the current trajectory has
+ * already ended, the command starts right away. Commands that are not queued
+ * discard the queue.
+ *
+ * @param x          x (m)
+ * @param y          y (m)
+ * @param z          z (m)
+ * @param yaw        yaw (rad)
+ * @param duration_s time it should take to reach the position (s)
+ * @param relative   true if x, y, z is relative to the end of the previous trajectory
+ * @return zero if the command succeeded, an error code otherwise
+ */
+int crtpCommanderHighLevelQueueGoTo(const float x, const float y, const float z, const float yaw, const float duration_s, const bool relative);
+
+/**
+ * @brief Queue a trajectory, see crtpCommanderHighLevelQueueGoTo()
+ *
+ * @param trajectoryId id of the trajectory (previously defined by define_trajectory)
+ * @param timeScale    time factor; 1.0 = original speed;
+ *                                  >1.0: slower;
+ *                                  <1.0: faster
+ * @param relative     set to True, if trajectory should be shifted to the end of the previous trajectory
+ * @param reversed     set to True, if trajectory should be executed in reverse
+ * @return zero if the command succeeded, an error code otherwise
+ */
+int crtpCommanderHighLevelQueueStartTrajectory(const uint8_t trajectoryId, const float timeScale, const bool relative, const bool reversed);
+
+/**
+ * @brief Queue a vertical landing, see crtpCommanderHighLevelQueueGoTo()
+ *
+ * @param absoluteHeight_m absolute target height (m)
+ * @param duration_s       time it should take until target height is reached (s)
+ * @return zero if the command succeeded, an error code otherwise
+ */
+int crtpCommanderHighLevelQueueLand(const float absoluteHeight_m, const float duration_s);
+
+/**
+ * @brief Start a trajectory at a given time of the swarm-wide clock
+ *
+ * All CFs that share the swarm-wide clock start the trajectory at the same
+ * instant, independent of when they receive the command.
+ *
+ * @param startTimeUs  swarm time at which the trajectory starts (us), at most about 35 minutes ahead
+ * @param trajectoryId id of the trajectory (previously defined by define_trajectory)
+ * @param timeScale    time factor; 1.0 = original speed;
+ *                                  >1.0: slower;
+ *                                  <1.0: faster
+ * @param relative     set to True, if trajectory should be shifted to current setpoint
+ * @param reversed     set to True, if trajectory should be executed in reverse
+ * @return zero if the command succeeded, ETIME if the start time has passed, an error code otherwise
+ */
+int crtpCommanderHighLevelScheduleStartTrajectory(const uint64_t startTimeUs, const uint8_t trajectoryId, const float timeScale, const bool relative, const bool reversed);
+
+/**
+ * @brief Set the swarm-wide clock
+ *
+ * The high-level commander keeps the offset of the swarm-wide clock to its
+ * local clock, so that all CFs of a swarm can refer to the same points in time.
+ *
+ * @param swarmTimeUs current swarm time (us)
+ * @return zero if the command succeeded, an error code otherwise
+ */
+int crtpCommanderHighLevelSetSwarmTime(const uint64_t swarmTimeUs);
+
+/**
+ * @brief Handle a time sync message that was broadcast to the swarm
+ *
+ * A time sync message is a COMMAND_SET_SWARM_TIME command of the high-level
+ * commander. The radio link calls this when a broadcast packet arrives, so
+ * that the local time of its reception is not delayed by the CRTP queues.
+ * Commands scheduled with COMMAND_SCHEDULE start at the same swarm time on
+ * all CFs that received the same time sync. It does not block, as it is
+ * called from the radio link thread.
+ *
+ * @param p the received packet
+ * @return true if the packet was a time sync message and has been handled
+ */
+bool crtpCommanderHighLevelHandleTimeSync(const CRTPPacket* p);
+
+/**
+ * @brief Get the current time of the swarm-wide clock
+ *
+ * @return current swarm time (us)
+ */
+uint64_t crtpCommanderHighLevelGetSwarmTime();
+
 /**
  * @brief Returns whether the trajectory with the given ID is defined
  *
@@ -188,18 +302,30 @@ bool crtpCommanderHighLevelIsTrajectoryDefined(uint8_t trajectoryId);
  *                                  <1.0: faster
  * @param relative     set to True, if trajectory should be shifted to current setpoint
  * @param reversed     set to True, if trajectory should be executed in reverse
- * @return zero if the command succeeded, an error code otherwise
+ * @return zero if the command succeeded, ERANGE if the trajectory leaves the
+ * envelope of the hlCommander.maxVel/maxAcc/maxJerk parameters at this time
+ * factor, another error code otherwise
  */
 int crtpCommanderHighLevelStartTrajectory(const uint8_t trajectoryId, const float timeScale, const bool relative, const bool reversed);
 
 /**
  * @brief Define a trajectory that has previously been uploaded to memory.
  *
+ * If trajectory data was written since the last definition, the uploaded
+ * memory bank becomes the active one. Trajectories that are already running
+ * are not affected.
+ *
+ * Uncompressed trajectories are verified before they are defined: the exact
+ * maxima of velocity, acceleration and jerk are computed and checked against
+ * the envelope of the hlCommander.maxVel/maxAcc/maxJerk parameters, and the
+ * piece joins are checked against hlCommander.maxJump.
+ *
  * @param trajectoryId The id of the trajectory
  * @param type         The type of trajectory that is stored in memory.
  * @param offset       offset in uploaded memory (bytes)
  * @param nPieces      Nr of pieces in the trajectory
- * @return zero if the command succeeded, an error code otherwise
+ * @return zero if the command succeeded, ERANGE if the trajectory leaves the
+ * envelope, EDOM if it is discontinuous, another error code otherwise
  */
 int crtpCommanderHighLevelDefineTrajectory(const uint8_t trajectoryId, const crtpCommanderTrajectoryType_t type, const uint32_t offset, const uint8_t nPieces);
 
@@ -214,17 +340,22 @@ uint32_t crtpCommanderHighLevelTrajectoryMemSize();
  * @brief Copy trajectory data to the trajectory memeory. After the copy crtpCommanderHighLevelDefineTrajectory()
  *        must be called before the trajectory can be used.
  *
+ * The data is written to the inactive memory bank, so a running trajectory is
+ * not affected. Writing fails while a trajectory is still flying from the
+ * inactive bank, i.e. until it is replaced by a new trajectory or command.
+ *
  * @param offset    offset in uploaded memory (bytes)
  * @param length    Length of the data (bytes) to copy to the trajectory memory
  * @param data[in]  pointer to the trajectory data source
  *
  * @return true   If data was copied
- * @return false  If data is too large
+ * @return false  If data is too large or the inactive bank is in use
  */
 bool crtpCommanderHighLevelWriteTrajectory(const uint32_t offset, const uint32_t length, const uint8_t* data);
 
 /**
- * @brief Copy data from the trajectory memory.
+ * @brief Copy data from the trajectory memory. While an upload is in progress
+ *        the data being uploaded is returned.
  *
  * @param offset             Offset in the trajectory memory (bytes)
  * @param length             Length of the data to copy
@@ -0,0 +1,33 @@
+/**
+ * dyn_notch.h - Gyro notch filters tuned to the motor noise by an on-board FFT
+ */
+#ifndef DYN_NOTCH_H_
+#define DYN_NOTCH_H_
+
+#include <stdbool.h>
+
+#include "imu_types.h"
+
+// Number of noise peaks tracked, each one gets a notch on all axes
+#define DYN_NOTCH_COUNT 2
+
+// Length of the FFT, in gyro samples
+#define DYN_NOTCH_FFT_SIZE 128
+
+/** Start the spectrum analyzer task.
+ *
+ * @param sampleFreq rate of the gyro samples passed to dynNotchApply() [Hz]
+ */
+void dynNotchInit(float sampleFreq);
+bool dynNotchTest(void);
+
+/** Feed a gyro sample to the spectrum analyzer and filter it through the notches.
+ *
+ * Called at the gyro rate from the sensor path. Coefficients retuned by the
+ * analyzer are picked up here between two samples.
+ *
+ * @param gyro gyro sample, replaced by the filtered value
+ */
+void dynNotchApply(Axis3f* gyro);
+
+#endif // DYN_NOTCH_H_
@@ -56,6 +56,7 @@ typedef enum {
   MeasurementTypeGyroscope,
   MeasurementTypeAcceleration,
   MeasurementTypeBarometer,
+  MeasurementType_COUNT,
 } MeasurementType;
 
 typedef struct
@@ -85,85 +86,96 @@ void stateEstimator(state_t *state, const uint32_t tick);
 StateEstimatorType stateEstimatorGetType(void);
 const char* stateEstimatorGetName();
 
-// Support to incorporate additional sensors into the state estimate via the following functions
+// Support to incorporate additional sensors into the state estimate via the following functions.
+// Each measurement type has its own ring. The external position and pose can
+// be enqueued from several tasks, their producers are serialized by a
+// spinlock. Every other type must be enqueued from a single task, which
+// pushes without a lock. All types must be dequeued from a single task.
 void estimatorEnqueue(const measurement_t *measurement);
 
-// These helper functions simplify the caller code, but cause additional memory copies
+// Enqueue a measurement of the given type, copying only the size of that type.
+// Returns false if the measurement was dropped, over the budget of its type or
+// because the ring of the type was full.
+bool estimatorEnqueueData(const MeasurementType type, const void *data);
+
 static inline void estimatorEnqueueTDOA(const tdoaMeasurement_t *tdoa)
 {
-  measurement_t m;
-  m.type = MeasurementTypeTDOA;
-  m.data.tdoa = *tdoa;
-  estimatorEnqueue(&m);
+  estimatorEnqueueData(MeasurementTypeTDOA, tdoa);
 }
 
 static inline void estimatorEnqueuePosition(const positionMeasurement_t *position)
 {
-  measurement_t m;
-  m.type = MeasurementTypePosition;
-  m.data.position = *position;
-  estimatorEnqueue(&m);
+  estimatorEnqueueData(MeasurementTypePosition, position);
 }
 
 static inline void estimatorEnqueuePose(const poseMeasurement_t *pose)
 {
-  measurement_t m;
-  m.type = MeasurementTypePose;
-  m.data.pose = *pose;
-  estimatorEnqueue(&m);
+  estimatorEnqueueData(MeasurementTypePose, pose);
 }
 
 static inline void estimatorEnqueueDistance(const distanceMeasurement_t *distance)
 {
-  measurement_t m;
-  m.type = MeasurementTypeDistance;
-  m.data.distance = *distance;
-  estimatorEnqueue(&m);
+  estimatorEnqueueData(MeasurementTypeDistance, distance);
 }
 
 static inline void estimatorEnqueueTOF(const tofMeasurement_t *tof)
 {
-  measurement_t m;
-  m.type = MeasurementTypeTOF;
-  m.data.tof = *tof;
-  estimatorEnqueue(&m);
+  estimatorEnqueueData(MeasurementTypeTOF, tof);
 }
 
 static inline void estimatorEnqueueAbsoluteHeight(const heightMeasurement_t *height)
 {
-  measurement_t m;
-  m.type = MeasurementTypeAbsoluteHeight;
-  m.data.height = *height;
-  estimatorEnqueue(&m);
+  estimatorEnqueueData(MeasurementTypeAbsoluteHeight, height);
 }
 
 static inline void estimatorEnqueueFlow(const flowMeasurement_t *flow)
 {
-  measurement_t m;
-  m.type = MeasurementTypeFlow;
-  m.data.flow = *flow;
-  estimatorEnqueue(&m);
+  estimatorEnqueueData(MeasurementTypeFlow, flow);
 }
 
 static inline void estimatorEnqueueYawError(const yawErrorMeasurement_t *yawError)
 {
-  measurement_t m;
-  m.type = MeasurementTypeYawError;
-  m.data.yawError = *yawError;
-  estimatorEnqueue(&m);
+  estimatorEnqueueData(MeasurementTypeYawError, yawError);
 }
 
 static inline void estimatorEnqueueSweepAngles(const sweepAngleMeasurement_t *sweepAngle)
 {
-  measurement_t m;
-  m.type = MeasurementTypeSweepAngle;
-  m.data.sweepAngle = *sweepAngle;
-  estimatorEnqueue(&m);
+  estimatorEnqueueData(MeasurementTypeSweepAngle, sweepAngle);
 }
 
-// Helper function for state estimators
+// Helper function for state estimators. Dequeues the next measurement of
+// any type, in the priority order of the types, see estimatorDequeueType().
 bool estimatorDequeue(measurement_t *measurement);
 
+// Dequeue the oldest measurement of a type into data, which must hold that
+// type. Lets the estimator drain the types in its own order.
+bool estimatorDequeueType(const MeasurementType type, void *data);
+
+// Number of measurements of a type dropped because its ring was full
+uint32_t estimatorGetQueueOverflows(const MeasurementType type);
+
+typedef struct {
+  uint32_t admitted; // queued for the estimator
+  uint32_t merged;   // folded into a measurement queued later
+  uint32_t dropped;  // over the budget of the type, or the ring was full
+} estimatorAdmissionStats_t;
+
+// Admission counters of a type, see estimatorSetAdmissionBudget()
+const estimatorAdmissionStats_t* estimatorGetAdmissionStats(const MeasurementType type);
+
+// Limit a type to a number of measurements per second, 0 for no limit, the
+// default. Over budget, TOF, height, flow, yaw error and barometer
+// measurements are merged, and queued at the latest 50 ms after the first of
+// them, and the others are dropped. The IMU types can not be limited.
+void estimatorSetAdmissionBudget(const MeasurementType type, const uint16_t perSecond);
+
+// Hand the queues over to a replay of recorded measurements. While the replay
+// is active, live measurements are dropped and only estimatorEnqueueReplay()
+// fills the queues, bypassing the budgets. On both transitions the consumer
+// drops what was queued before, the next time it dequeues.
+void estimatorQueueSetReplay(bool active);
+bool estimatorEnqueueReplay(const MeasurementType type, const void *data);
+
 #ifdef CONFIG_ESTIMATOR_OOT
 void estimatorOutOfTreeInit(void);
 bool estimatorOutOfTreeTest(void);
@@ -0,0 +1,108 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * estimator_history.h - State history for fusing delayed measurements
+ *
+ * An estimator keeps a snapshot of its state after each prediction, together
+ * with the input of the prediction. A measurement that arrives late is fused
+ * into the snapshot at its timestamp, and the following predictions are
+ * replayed from there to bring the state back to the present, together with
+ * the measurements that were fused after each of them.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "estimator.h"
+
+#define ESTIMATOR_HISTORY_LENGTH 32
+// Measurements remembered for replays. A late measurement older than the
+// oldest one remembered is fused at the present.
+#define ESTIMATOR_HISTORY_FUSED_LENGTH 16
+
+/** Input of one prediction step */
+typedef struct {
+  uint32_t timestamp; // end of the step, in the time base of the estimator
+  Axis3f gyro;        // deg/s
+  Axis3f acc;         // Gs
+  float dt;           // s
+} estimatorHistoryInput_t;
+
+typedef struct {
+  // Predict the state one step forward
+  void (*predict)(void *state, const estimatorHistoryInput_t *input);
+  // Fuse a measurement into the state
+  void (*update)(void *state, const measurement_t *measurement);
+} estimatorHistoryOps_t;
+
+/** A measurement fused after a prediction step */
+typedef struct {
+  uint32_t step;
+  measurement_t measurement;
+} estimatorHistoryFused_t;
+
+typedef struct {
+  estimatorHistoryOps_t ops;
+  void *state;                // current state of the estimator
+  uint8_t *snapshots;         // ESTIMATOR_HISTORY_LENGTH states of stateSize bytes
+  size_t stateSize;
+  estimatorHistoryInput_t inputs[ESTIMATOR_HISTORY_LENGTH];
+  uint32_t head;              // number of predictions so far
+  estimatorHistoryFused_t fused[ESTIMATOR_HISTORY_FUSED_LENGTH];
+  uint32_t fusedCount;        // number of measurements fused so far
+  uint32_t fusedFrom;         // first step whose measurements are all in fused
+  uint8_t maxReplay;          // most predictions replayed for one measurement
+
+  // statistics
+  uint32_t replays;           // measurements fused in the past
+  uint32_t replayedSteps;     // predictions replayed
+  uint32_t fusedLate;         // measurements fused at the present instead
+} estimatorHistory_t;
+
+/**
+ * Init the history of an estimator.
+ *
+ * @param history the history
+ * @param ops predict and update functions of the estimator
+ * @param state current state of the estimator, updated in place
+ * @param snapshots storage for ESTIMATOR_HISTORY_LENGTH copies of the state
+ * @param stateSize size of the state in bytes
+ * @param maxReplay most predictions replayed for one measurement, bounds the
+ *        cost of a late measurement. Older measurements are fused at the present.
+ */
+void estimatorHistoryInit(estimatorHistory_t *history, const estimatorHistoryOps_t *ops,
+                          void *state, void *snapshots, size_t stateSize, uint8_t maxReplay);
+
+/**
+ * Predict the state one step forward and record the step.
+ */
+void estimatorHistoryPredict(estimatorHistory_t *history, const estimatorHistoryInput_t *input);
+
+/**
+ * Fuse a measurement at the time it was taken.
+ *
+ * @param timestamp time of the measurement, in the time base of the estimator
+ * @return true if the measurement was fused in the past, false if it was
+ *         fused at the present
+ */
+bool estimatorHistoryFuse(estimatorHistory_t *history, const measurement_t *measurement, uint32_t timestamp);
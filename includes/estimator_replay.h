@@ -0,0 +1,77 @@
+/**
+ * estimator_replay.h - Run the state estimator on recorded measurements
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stabilizer_types.h"
+
+#define ESTIMATOR_REPLAY_INPUT_SIZE 4096
+#define ESTIMATOR_REPLAY_OUTPUT_RECORDS 128
+
+typedef enum {
+  ReplayRecordMeasurement = 0,  // payload: the measurement data, type in the header
+  ReplayRecordTick = 1,         // payload: uint32_t tick, runs stateEstimator()
+  ReplayRecordGroundTruth = 2,  // payload: replayGroundTruth_t
+  ReplayRecordEnd = 0xFF,
+} replayRecordKind_t;
+
+/**
+ * Trace records, uploaded back to back through MEM_TYPE_ESTIMATOR_REPLAY at
+ * offset 0. The same layout can be produced from the log system or a black
+ * box recording.
+ */
+typedef struct {
+  uint8_t kind;     // replayRecordKind_t
+  uint8_t type;     // MeasurementType of measurement records
+  uint16_t length;  // bytes of payload following the header
+} __attribute__((packed)) replayRecordHeader_t;
+
+typedef struct {
+  float x;
+  float y;
+  float z;
+} __attribute__((packed)) replayGroundTruth_t;
+
+/**
+ * State after each tick, read back through MEM_TYPE_ESTIMATOR_REPLAY at
+ * offset ESTIMATOR_REPLAY_INPUT_SIZE.
+ */
+typedef struct {
+  uint32_t tick;
+  float x;
+  float y;
+  float z;
+  float roll;
+  float pitch;
+  float yaw;
+} __attribute__((packed)) replayStateRecord_t;
+
+/**
+ * Register the trace memory and start the replay thread, which replays the
+ * trace when the estReplay.run parameter is set.
+ */
+void estimatorReplayInit(void);
+
+/**
+ * Replay the uploaded trace. Refuses to run while armed.
+ *
+ * @return 0 on success, EBUSY if armed, EINVAL if the trace is malformed
+ */
+int estimatorReplayRun(void);
+
+/**
+ * True while a replay owns the estimator. The stabilizer must not run the
+ * estimator meanwhile.
+ */
+bool estimatorReplayIsActive(void);
+
+/**
+ * Run stateEstimator() for the stabilizer loop, unless a replay owns the
+ * estimator. The stabilizer calls this in place of stateEstimator().
+ *
+ * @return false if the estimator was skipped and the state left as it was
+ */
+bool estimatorReplayLiveUpdate(state_t *state, const uint32_t tick);
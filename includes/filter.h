@@ -118,14 +118,116 @@ static inline float get_second_order_low_pass(struct SecondOrderLowPass *filter)
   return filter->o[0];
 }
 
+/** Fractional bits of the coefficients of the integer filter.
+ *
+ * The denominator gains are within (-2, 2), so 2 integer bits are enough.
+ */
+#define SECOND_ORDER_LOW_PASS_INT_FRAC 29
+
+/** Fractional bits of the output history of the integer filter.
+ *
+ * Keeping the fraction of the output in the feedback avoids the limit cycles
+ * and the noise floor of rounding the feedback to the input resolution. The
+ * rounding of the feedback settles off by up to half a unit over 1 + a0 + a1,
+ * about 0.13 LSB with 12 bits for a 5 Hz cutoff at 1 kHz.
+ */
+#define SECOND_ORDER_LOW_PASS_INT_STATE_FRAC 12
+
+/** Fixed-point version of the second order low pass filter.
+ *
+ * Coefficients in Q2.29, input history in the input format and output history
+ * with SECOND_ORDER_LOW_PASS_INT_STATE_FRAC extra fractional bits. Inputs are
+ * expected to fit in 16 bits, like raw IMU samples, so that the output
+ * history fits in 32 bits and the 64 bit accumulator can not overflow.
+ */
 struct SecondOrderLowPass_int {
   int32_t a[2]; ///< denominator gains
   int32_t b[2]; ///< numerator gains
   int32_t i[2]; ///< input history
   int32_t o[2]; ///< output history
-  int32_t loop_gain; ///< loop gain
+  int32_t loop_gain; ///< loop gain, the fixed-point one of the coefficients
 };
 
+static inline int32_t saturate_int32(int64_t value)
+{
+  if (value > INT32_MAX) {
+    return INT32_MAX;
+  }
+  if (value < INT32_MIN) {
+    return INT32_MIN;
+  }
+  return (int32_t)value;
+}
+
+// Output history to the input format, rounded to nearest. In 64 bits, so
+// that the rounding can not overflow at the top of the range.
+static inline int32_t second_order_low_pass_int_output(int32_t state)
+{
+  return (int32_t)(((int64_t)state + (1 << (SECOND_ORDER_LOW_PASS_INT_STATE_FRAC - 1))) >> SECOND_ORDER_LOW_PASS_INT_STATE_FRAC);
+}
+
+/** Init fixed-point second order low pass filter.
+ *
+ * Same filter as init_second_order_low_pass(), with the coefficients rounded
+ * to fixed-point.
+ *
+ * @param filter second order low pass filter structure
+ * @param tau time constant of the second order low pass filter
+ * @param Q Q value of the second order low pass filter
+ * @param sample_time sampling period of the signal
+ * @param value initial value of the filter
+ */
+static inline void init_second_order_low_pass_int(struct SecondOrderLowPass_int *filter, float tau, float Q,
+    float sample_time, int32_t value)
+{
+  struct SecondOrderLowPass filter_temp;
+  init_second_order_low_pass(&filter_temp, tau, Q, sample_time, 0.0f);
+
+  const float one = (float)(1 << SECOND_ORDER_LOW_PASS_INT_FRAC);
+  filter->loop_gain = 1 << SECOND_ORDER_LOW_PASS_INT_FRAC;
+  filter->a[0] = saturate_int32((int64_t)lroundf(filter_temp.a[0] * one));
+  filter->a[1] = saturate_int32((int64_t)lroundf(filter_temp.a[1] * one));
+  filter->b[0] = saturate_int32((int64_t)lroundf(filter_temp.b[0] * one));
+  filter->b[1] = saturate_int32((int64_t)lroundf(filter_temp.b[1] * one));
+  filter->i[0] = filter->i[1] = value;
+  filter->o[0] = filter->o[1] = value * (1 << SECOND_ORDER_LOW_PASS_INT_STATE_FRAC);
+}
+
+/** Update fixed-point second order low pass filter state with a new value.
+ *
+ * Rounds to nearest and saturates instead of wrapping around.
+ *
+ * @param filter second order low pass filter structure
+ * @param value new input value of the filter
+ * @return new filtered value
+ */
+static inline int32_t update_second_order_low_pass_int(struct SecondOrderLowPass_int *filter, int32_t value)
+{
+  int64_t input = (int64_t)filter->b[0] * value
+                  + (int64_t)filter->b[1] * filter->i[0]
+                  + (int64_t)filter->b[0] * filter->i[1];
+  int64_t acc = input * (1 << SECOND_ORDER_LOW_PASS_INT_STATE_FRAC)
+                - (int64_t)filter->a[0] * filter->o[0]
+                - (int64_t)filter->a[1] * filter->o[1];
+  int32_t out = saturate_int32((acc + (1ll << (SECOND_ORDER_LOW_PASS_INT_FRAC - 1))) >> SECOND_ORDER_LOW_PASS_INT_FRAC);
+
+  filter->i[1] = filter->i[0];
+  filter->i[0] = value;
+  filter->o[1] = filter->o[0];
+  filter->o[0] = out;
+  return second_order_low_pass_int_output(out);
+}
+
+/** Get current value of the fixed-point second order low pass filter.
+ *
+ * @param filter second order low pass filter structure
+ * @return current value of the filter
+ */
+static inline int32_t get_second_order_low_pass_int(struct SecondOrderLowPass_int *filter)
+{
+  return second_order_low_pass_int_output(filter->o[0]);
+}
+
 /** Second order Butterworth low pass filter.
  */
 typedef struct SecondOrderLowPass Butterworth2LowPass;
@@ -0,0 +1,81 @@
+/**
+ * filter_bank.h - Cascaded biquad filters on 3-axis vectors
+ */
+#ifndef FILTER_BANK_H_
+#define FILTER_BANK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cf_math.h"
+#include "imu_types.h"
+
+#define FILTER_BANK_MAX_STAGES 4
+
+/** Biquad cascade applied to the three axes of a vector.
+ *
+ * All axes share the coefficients. The state of the three axes is stored back
+ * to back in one array, and each axis runs all its stages in one call of
+ * arm_biquad_cascade_df2T_f32().
+ */
+typedef struct {
+  float32_t coeffs[5 * FILTER_BANK_MAX_STAGES]; ///< b0, b1, b2, -a1, -a2 per stage
+  float32_t state[3 * 2 * FILTER_BANK_MAX_STAGES]; ///< 2 delay elements per stage and axis
+  arm_biquad_cascade_df2T_instance_f32 axis[3];
+  uint8_t stages;
+} filterBank3_t;
+
+/** Init an empty filter bank, which passes the samples through.
+ *
+ * @param bank filter bank
+ */
+void filterBank3Init(filterBank3_t* bank);
+
+/** Append a second order Butterworth low pass stage, same as lpf2pInit().
+ *
+ * @param bank filter bank
+ * @param sampleFreq sample frequency [Hz]
+ * @param cutoffFreq cutoff frequency [Hz]
+ * @return false if the bank is full
+ */
+bool filterBank3AddLowPass(filterBank3_t* bank, float sampleFreq, float cutoffFreq);
+
+/** Append a notch stage.
+ *
+ * @param bank filter bank
+ * @param sampleFreq sample frequency [Hz]
+ * @param centerFreq center frequency of the notch [Hz]
+ * @param q quality factor, the center frequency over the bandwidth
+ * @return false if the bank is full
+ */
+bool filterBank3AddNotch(filterBank3_t* bank, float sampleFreq, float centerFreq, float q);
+
+/** Compute the coefficients of a notch stage.
+ *
+ * @param coeffs b0, b1, b2, -a1, -a2 of the stage
+ */
+void filterBankNotchCoeffs(float32_t coeffs[5], float sampleFreq, float centerFreq, float q);
+
+/** Clear the state of all stages.
+ *
+ * @param bank filter bank
+ */
+void filterBank3Reset(filterBank3_t* bank);
+
+/** Filter a new sample of all axes in place.
+ *
+ * @param bank filter bank
+ * @param sample new sample, replaced by the filtered value
+ */
+static inline void filterBank3Apply(filterBank3_t* bank, Axis3f* sample)
+{
+  if (bank->stages == 0) {
+    return;
+  }
+
+  for (int i = 0; i < 3; i++) {
+    arm_biquad_cascade_df2T_f32(&bank->axis[i], &sample->axis[i], &sample->axis[i], 1);
+  }
+}
+
+#endif // FILTER_BANK_H_
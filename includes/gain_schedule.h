@@ -0,0 +1,54 @@
+/**
+ * gain_schedule.h - Gain scheduling of the PID controller by thrust and battery voltage
+ */
+
+#ifndef __GAIN_SCHEDULE_H__
+#define __GAIN_SCHEDULE_H__
+
+#include <stdbool.h>
+
+#define GAIN_SCHEDULE_THRUST_POINTS 4
+#define GAIN_SCHEDULE_VBAT_POINTS 4
+
+/**
+ * Scale factors of the PID gains. The PIDs are not part of this tree, so the
+ * factors are applied to their outputs. This scales the P, I and D terms
+ * alike, the integral included, and the PIDs have limited their outputs
+ * before: a scale above 1 can take the output past the PID output limit, up to
+ * the range of the command. A table can not shape Kp, Ki and Kd separately.
+ */
+typedef struct {
+  float rateRollPitch; // roll and pitch rate PIDs
+  float rateYaw;       // yaw rate PID
+  float positionXy;    // roll and pitch commands of the x and y position PIDs
+} gainScale_t;
+
+/**
+ * Gain table on a uniform grid of thrust and battery voltage. Between the grid
+ * points the scales are interpolated bilinearly, outside of the grid they are
+ * held at the border. This is also the layout of the memory uploaded through
+ * MEM_TYPE_GAIN_SCHEDULE. An upload takes effect when its last byte is written.
+ * The write of the last byte fails, and the table in use is kept, if a range
+ * is empty or a scale is not positive and finite.
+ */
+typedef struct {
+  float thrustMin;
+  float thrustMax;
+  float vbatMin;  // V
+  float vbatMax;  // V
+  gainScale_t scale[GAIN_SCHEDULE_VBAT_POINTS][GAIN_SCHEDULE_THRUST_POINTS];
+} gainScheduleTable_t;
+
+/**
+ * Load the table from the storage, or a table of unit scales if none is stored.
+ */
+void gainScheduleInit(void);
+bool gainScheduleTest(void);
+
+/**
+ * Look up the scale factors at a thrust and battery voltage. Constant time.
+ * All scales are 1 when the scheduling is disabled.
+ */
+void gainScheduleLookup(float thrust, float vbat, gainScale_t *scale);
+
+#endif //__GAIN_SCHEDULE_H__
@@ -0,0 +1,104 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * kalman_covariance.h - Sparse covariance updates of an extended Kalman filter
+ *
+ * The covariance is symmetric and only its upper triangle is stored. The
+ * prediction takes the non-zero entries of the transition matrix F, and
+ * measurements are fused one scalar at a time with the few non-zero entries
+ * of their row of H. Both cost far less than dense n x n matrix products for
+ * the sparsity of the Crazyflie Kalman filter, where F has about half of its
+ * entries zero and most measurements touch one to three states.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#define KC_COV_MAX_STATES 9
+#define KC_COV_PACKED_SIZE(n) ((n) * ((n) + 1) / 2)
+
+// Bounds of the variances, as in the dense Kalman filter
+#define KC_COV_MAX_VARIANCE 100.0f
+#define KC_COV_MIN_VARIANCE 1e-6f
+
+typedef struct {
+  float p[KC_COV_PACKED_SIZE(KC_COV_MAX_STATES)]; // upper triangle, row by row
+  uint8_t n;
+} kalmanCovariance_t;
+
+/** Non-zero entry of a sparse matrix */
+typedef struct {
+  uint8_t row;
+  uint8_t col;
+  float value;
+} kalmanSparseEntry_t;
+
+/** Index of element (i, j) in the packed upper triangle, i <= j */
+static inline int kalmanCovIndex(const kalmanCovariance_t* cov, int i, int j)
+{
+  return i * cov->n - i * (i - 1) / 2 + (j - i);
+}
+
+/** Element (i, j) of the covariance, in any order */
+static inline float kalmanCovGet(const kalmanCovariance_t* cov, int i, int j)
+{
+  return i <= j ? cov->p[kalmanCovIndex(cov, i, j)] : cov->p[kalmanCovIndex(cov, j, i)];
+}
+
+/**
+ * Init a diagonal covariance.
+ *
+ * @param cov the covariance
+ * @param n number of states, at most KC_COV_MAX_STATES
+ * @param variances the n variances on the diagonal
+ */
+void kalmanCovInit(kalmanCovariance_t* cov, uint8_t n, const float* variances);
+
+/**
+ * Predict the covariance, P = F P F' + Q.
+ *
+ * @param cov the covariance
+ * @param f the non-zero entries of F in any order, including the diagonal
+ * @param count number of entries in f
+ * @param processNoise the n variances of the diagonal process noise Q, or NULL
+ */
+void kalmanCovPredict(kalmanCovariance_t* cov, const kalmanSparseEntry_t* f, int count, const float* processNoise);
+
+/**
+ * Fuse a scalar measurement with the Joseph form,
+ * P = (I - K H) P (I - K H)' + K R K'.
+ *
+ * The Joseph form keeps P positive definite with rounding errors, as long as
+ * it is evaluated as the product rather than expanded. (I - K H) P is formed
+ * in full, and its product with (I - K H)' takes only the columns H touches,
+ * so the update costs O(n^2) for a sparse H. The variances are bounded
+ * afterwards.
+ *
+ * @param cov the covariance
+ * @param index the states the measurement depends on
+ * @param h the non-zero entries of H, h[k] being the column index[k]
+ * @param count number of non-zero entries of H
+ * @param error measured minus predicted measurement
+ * @param stdMeasNoise standard deviation of the measurement noise
+ * @param stateDelta the n elements of K * error are added to it
+ */
+void kalmanCovScalarUpdate(kalmanCovariance_t* cov, const uint8_t* index, const float* h, int count,
+                           float error, float stdMeasNoise, float* stateDelta);
@@ -75,6 +75,18 @@ static inline float shortest_signed_angle_radians(float start, float goal)
 	return signed_diff;
 }
 
+// wrap an angle in degrees to the range [-180, 180), without loops or branches
+static inline float wrap_degrees(float angle)
+{
+	return fmodf_floored(angle + 180.0f, 360.0f) - 180.0f;
+}
+
+// compute shortest signed angle between two given angles (in range [-180, 180))
+static inline float shortest_signed_angle_degrees(float start, float goal)
+{
+	return wrap_degrees(goal - start);
+}
+
 static inline float clamp(float value, float min, float max) {
   if (value < min) return min;
   if (value > max) return max;
@@ -687,6 +699,10 @@ static inline struct vec quat2rpy(struct quat q) {
 	v.z = atan2f(2.0f * (q.w * q.z + q.x * q.y), 1 - 2 * (fsqr(q.y) + fsqr(q.z))); // yaw
 	return v;
 }
+// yaw of a quaternion, same as quat2rpy(q).z but without computing roll and pitch.
+static inline float quat2yaw(struct quat q) {
+	return atan2f(2.0f * (q.w * q.z + q.x * q.y), 1 - 2 * (fsqr(q.y) + fsqr(q.z)));
+}
 // compute the axis of a quaternion's axis-angle decomposition.
 static inline struct vec quat2axis(struct quat q) {
 	// TODO this is not numerically stable for tiny rotations
@@ -853,6 +869,104 @@ static inline void qstoref(struct quat q, float *f) {
 }
 
 
+// -------------------------- batch operations ---------------------------
+//
+// operations on arrays, for the hot loops of the estimators and controllers.
+// they take pointers instead of passing structs by value, load matrices and
+// quaternions into locals once per call, and write each result with plain
+// multiply-adds that the compiler maps to fused FPU instructions. the outputs
+// may alias the inputs unless noted otherwise.
+//
+
+// dst[i] = a[i] + b[i].
+static inline void vadd_batch(struct vec *dst, struct vec const *a, struct vec const *b, int n) {
+	for (int i = 0; i < n; ++i) {
+		dst[i].x = a[i].x + b[i].x;
+		dst[i].y = a[i].y + b[i].y;
+		dst[i].z = a[i].z + b[i].z;
+	}
+}
+// dst[i] += s * a[i].
+static inline void vaxpy_batch(struct vec *dst, float s, struct vec const *a, int n) {
+	for (int i = 0; i < n; ++i) {
+		dst[i].x += s * a[i].x;
+		dst[i].y += s * a[i].y;
+		dst[i].z += s * a[i].z;
+	}
+}
+// dst[i] = m * v[i].
+static inline void mvmul_batch(struct vec *dst, struct mat33 const *m, struct vec const *v, int n) {
+	float const m00 = m->m[0][0], m01 = m->m[0][1], m02 = m->m[0][2];
+	float const m10 = m->m[1][0], m11 = m->m[1][1], m12 = m->m[1][2];
+	float const m20 = m->m[2][0], m21 = m->m[2][1], m22 = m->m[2][2];
+	for (int i = 0; i < n; ++i) {
+		float const x = v[i].x, y = v[i].y, z = v[i].z;
+		dst[i].x = m00 * x + m01 * y + m02 * z;
+		dst[i].y = m10 * x + m11 * y + m12 * z;
+		dst[i].z = m20 * x + m21 * y + m22 * z;
+	}
+}
+// dst[i] += s * (m * v[i]).
+static inline void mvmul_accum_batch(struct vec *dst, struct mat33 const *m, float s, struct vec const *v, int n) {
+	float const m00 = s * m->m[0][0], m01 = s * m->m[0][1], m02 = s * m->m[0][2];
+	float const m10 = s * m->m[1][0], m11 = s * m->m[1][1], m12 = s * m->m[1][2];
+	float const m20 = s * m->m[2][0], m21 = s * m->m[2][1], m22 = s * m->m[2][2];
+	for (int i = 0; i < n; ++i) {
+		float const x = v[i].x, y = v[i].y, z = v[i].z;
+		dst[i].x += m00 * x + m01 * y + m02 * z;
+		dst[i].y += m10 * x + m11 * y + m12 * z;
+		dst[i].z += m20 * x + m21 * y + m22 * z;
+	}
+}
+// rotate the vectors by a quaternion, dst[i] = qvrot(q, v[i]).
+// the rotation matrix costs about as much as one qvrot() and
+// each vector after that a third of it.
+static inline void qvrot_batch(struct vec *dst, struct quat q, struct vec const *v, int n) {
+	struct mat33 const r = quat2rotmat(q);
+	mvmul_batch(dst, &r, v, n);
+}
+// rotate and accumulate, acc += s * qvrot(q, v), without temporary vectors.
+// e.g. integrating a body frame acceleration into a world frame velocity.
+static inline void qvrot_accum(struct vec *acc, struct quat q, float s, struct vec v) {
+	// qvrot(q, v) = v + 2w (qv x v) + 2 qv x (qv x v)
+	float const tx = 2.0f * (q.y * v.z - q.z * v.y);
+	float const ty = 2.0f * (q.z * v.x - q.x * v.z);
+	float const tz = 2.0f * (q.x * v.y - q.y * v.x);
+	acc->x += s * (v.x + q.w * tx + q.y * tz - q.z * ty);
+	acc->y += s * (v.y + q.w * ty + q.z * tx - q.x * tz);
+	acc->z += s * (v.z + q.w * tz + q.x * ty - q.y * tx);
+}
+// rotate and accumulate arrays, acc[i] += s * qvrot(q, v[i]).
+static inline void qvrot_accum_batch(struct vec *acc, struct quat q, float s, struct vec const *v, int n) {
+	struct mat33 const r = quat2rotmat(q);
+	mvmul_accum_batch(acc, &r, s, v, n);
+}
+// multiply two matrices through pointers, ab = a * b. ab must not alias a or b.
+static inline void mmul_into(struct mat33 *ab, struct mat33 const *a, struct mat33 const *b) {
+	for (int i = 0; i < 3; ++i) {
+		float const ai0 = a->m[i][0], ai1 = a->m[i][1], ai2 = a->m[i][2];
+		ab->m[i][0] = ai0 * b->m[0][0] + ai1 * b->m[1][0] + ai2 * b->m[2][0];
+		ab->m[i][1] = ai0 * b->m[0][1] + ai1 * b->m[1][1] + ai2 * b->m[2][1];
+		ab->m[i][2] = ai0 * b->m[0][2] + ai1 * b->m[1][2] + ai2 * b->m[2][2];
+	}
+}
+// product of a chain of matrices, m[0] * m[1] * ... * m[n - 1].
+// the identity if n is zero.
+static inline struct mat33 mmul_chain(struct mat33 const *m, int n) {
+	if (n == 0) {
+		return meye();
+	}
+	struct mat33 prod[2];
+	int cur = 0;
+	prod[0] = m[0];
+	for (int i = 1; i < n; ++i) {
+		mmul_into(&prod[cur ^ 1], &prod[cur], &m[i]);
+		cur ^= 1;
+	}
+	return prod[cur];
+}
+
+
 // ------------------------ convex sets in R^3 ---------------------------
 
 // project v onto the halfspace H = {x : a^T x <= b}, where a is a unit vector.
@@ -0,0 +1,79 @@
+/**
+ * measurement_ring.h - Lock-free single producer, single consumer ring buffer
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Ring of fixed size items. The head is only written by the producer and the
+ * tail only by the consumer, so no lock is needed as long as there is a single
+ * producer and a single consumer. The indexes run freely and the number of
+ * items must be a power of two.
+ */
+typedef struct {
+  uint8_t* buffer;
+  uint16_t itemSize;
+  uint16_t mask;     // number of items - 1
+  uint32_t head;     // next item to write
+  uint32_t tail;     // next item to read
+  uint32_t overflows;
+} measurementRing_t;
+
+#define MEASUREMENT_RING_INIT(BUFFER, TYPE) \
+  { .buffer = (uint8_t*)(BUFFER), .itemSize = sizeof(TYPE), \
+    .mask = sizeof(BUFFER) / sizeof(TYPE) - 1, }
+
+/**
+ * Define a static buffer for MEASUREMENT_RING_INIT(), with a build time check
+ * of its length. Needs BUILD_ASSERT from the Zephyr toolchain headers.
+ */
+#define MEASUREMENT_RING_BUFFER(NAME, TYPE, LENGTH) \
+  static TYPE NAME[LENGTH]; \
+  BUILD_ASSERT((LENGTH) > 0 && ((LENGTH) & ((LENGTH) - 1)) == 0, #NAME " length is not a power of two")
+
+/**
+ * Copy an item into the ring. Called by the producer only.
+ *
+ * @return false, and the item is dropped, if the ring is full
+ */
+static inline bool measurementRingPush(measurementRing_t* ring, const void* item)
+{
+  uint32_t head = ring->head;
+  uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+  if (head - tail > ring->mask) {
+    ring->overflows++;
+    return false;
+  }
+
+  memcpy(&ring->buffer[(head & ring->mask) * ring->itemSize], item, ring->itemSize);
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+/**
+ * Copy the oldest item out of the ring. Called by the consumer only.
+ *
+ * @return false if the ring is empty
+ */
+static inline bool measurementRingPop(measurementRing_t* ring, void* item)
+{
+  uint32_t tail = ring->tail;
+  uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+  if (head == tail) {
+    return false;
+  }
+
+  memcpy(item, &ring->buffer[(tail & ring->mask) * ring->itemSize], ring->itemSize);
+  __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+static inline bool measurementRingIsEmpty(measurementRing_t* ring)
+{
+  return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail;
+}
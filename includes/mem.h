@@ -19,6 +19,8 @@ typedef enum {
   MEM_TYPE_LEDMEM   = 0x17,
   MEM_TYPE_APP      = 0x18,
   MEM_TYPE_DECK_MEM = 0x19,
+  MEM_TYPE_GAIN_SCHEDULE = 0x1A,
+  MEM_TYPE_ESTIMATOR_REPLAY = 0x1B,
 } MemoryType_t;
 
 #define MEMORY_SERIAL_LENGTH 8
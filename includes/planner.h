@@ -69,12 +69,13 @@ struct planner
 	bool reversed;					// true, if trajectory should be evaluated in reverse
 
 	union {
-		const struct piecewise_traj* trajectory; // pointer to trajectory
+		struct piecewise_traj* trajectory; // pointer to trajectory
 		struct piecewise_traj_compressed* compressed_trajectory; // pointer to compressed trajectory
 	};
 
 	struct piecewise_traj planned_trajectory; // trajectory for on-board planning
-	struct poly4d pieces[1]; // the on-board planner requires a single piece, only
+	struct poly4d pieces[PIECEWISE_MIN_SNAP_MAX_PIECES]; // pieces of the on-board planner (go_to uses the first one, only)
+	float piece_start[PIECEWISE_MIN_SNAP_MAX_PIECES + 1]; // start time of each planned piece, see piecewise_prepare()
 };
 
 // initialize the planner
@@ -108,17 +109,33 @@ int plan_takeoff(struct planner *p, struct vec curr_pos, float curr_yaw, float h
 // start a landing trajectory.
 int plan_land(struct planner *p, struct vec curr_pos, float curr_yaw, float hover_height, float hover_yaw, float duration, float t);
 
+// same as above, but with current state provided from outside, so that the
+// landing continues from its velocity and acceleration.
+int plan_land_from(struct planner *p, const struct traj_eval *curr_eval, float hover_height, float hover_yaw, float duration, float t);
+
 // move to a given position, then hover there.
 int plan_go_to(struct planner *p, bool relative, struct vec hover_pos, float hover_yaw, float duration, float t);
 
 // same as above, but with current state provided from outside.
 int plan_go_to_from(struct planner *p, const struct traj_eval *curr_eval, bool relative, struct vec hover_pos, float hover_yaw, float duration, float t);
 
+// fly a minimum snap trajectory through the given waypoints, then hover at the last one.
+// durations[i] is the time to fly to waypoints[i]. at most PIECEWISE_MIN_SNAP_MAX_PIECES waypoints.
+int plan_go_to_waypoints_from(struct planner *p, const struct traj_eval *curr_eval, bool relative,
+	int n_waypoints, struct vec const *waypoints, float const *yaws, float const *durations, float t);
+
 // start trajectory. start_from param is ignored if relative == false.
 int plan_start_trajectory(struct planner *p, struct piecewise_traj* trajectory, bool reversed, bool relative, struct vec start_from);
 
 // start compressed trajectory. start_from param is ignored if relative == false.
 int plan_start_compressed_trajectory(struct planner *p, struct piecewise_traj_compressed* trajectory, bool relative, struct vec start_from);
 
+// time at which the current trajectory ends.
+float plan_end_time(struct planner *p);
+
+// move the time origin of the planner by dt, i.e. a time t before the call
+// corresponds to t - dt after it.
+void plan_shift_time(struct planner *p, float dt);
+
 // Query if the trjectory is finished
 bool plan_is_finished(struct planner *p, float t);
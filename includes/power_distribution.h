@@ -0,0 +1,77 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * power_distribution.h - Interface to the power distribution (motor mixer)
+ */
+#ifndef __POWER_DISTRIBUTION_H__
+#define __POWER_DISTRIBUTION_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stabilizer_types.h"
+
+void powerDistributionInit(void);
+bool powerDistributionTest(void);
+
+/**
+ * Mix the controller output into motor commands, for all control modes. The
+ * commands are PWM ratios scaled to UINT16_MAX, compensated for the battery
+ * voltage, and may be out of range.
+ *
+ * @param control The controller output
+ * @param motorThrustUncapped Motor commands before saturation
+ */
+void powerDistribution(const control_t *control, motors_thrust_uncapped_t* motorThrustUncapped);
+
+/**
+ * Fit the motor commands into the range from the idle thrust to UINT16_MAX.
+ * Attitude is prioritized over thrust: the common part of the commands is
+ * shifted first, and the differential part is only scaled down if it does
+ * not fit into the range on its own.
+ *
+ * @param motorThrustUncapped Motor commands from powerDistribution()
+ * @param motorPwm Saturated motor commands
+ * @return true if the commands had to be changed
+ */
+bool powerDistributionCap(const motors_thrust_uncapped_t* motorThrustUncapped, motors_thrust_pwm_t* motorPwm);
+
+/**
+ * Motor command of the lowest thrust. The cap always applies it, the motors
+ * only idle at it while armed because the stabilizer stops them otherwise.
+ */
+uint32_t powerDistributionGetIdleThrust(void);
+
+/**
+ * Maximum total thrust of all motors at full battery [N]
+ */
+float powerDistributionGetMaxThrust(void);
+
+/**
+ * Motor output of the split rate loop, see rateLoopInit(). Mixes and caps the
+ * rate loop output and writes it to the motors, as long as the stabilizer
+ * keeps calling powerDistribution(), which it only does while the motors may
+ * run. Meanwhile powerDistribution() gives the stabilizer the latest rate loop
+ * command, so both write the same command.
+ */
+void powerDistributionRateLoop(const control_t *control);
+
+#endif //__POWER_DISTRIBUTION_H__
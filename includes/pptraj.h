@@ -38,6 +38,8 @@ Header file for piecewise polynomial trajectories
 
 #pragma once
 
+#include <stdint.h>
+
 #include "math3d.h"
 
 #define PP_DEGREE (7)
@@ -149,10 +151,26 @@ struct piecewise_traj
 	struct vec shift;
 	unsigned char n_pieces;
 	struct poly4d* pieces;
+
+	// optional lookup table, filled by piecewise_prepare().
+	// piece_start[i] is the (unscaled) start time of piece i relative to
+	// t_begin, and piece_start[n_pieces] is the total (unscaled) duration.
+	// NULL if the trajectory has not been prepared.
+	float* piece_start;
+	// index of the most recently evaluated piece.
+	unsigned char cursor;
+#ifdef PPTRAJ_FIXED_POINT
+	// fixed point copy of the pieces, see piecewise_prepare_fixed(). NULL if not prepared.
+	struct poly4d_fixed* fixed_pieces;
+#endif
 };
 
 static inline float piecewise_duration(struct piecewise_traj const *pp)
 {
+	if (pp->piece_start != NULL) {
+		return pp->piece_start[pp->n_pieces] * pp->timescale;
+	}
+
 	float total_dur = 0;
 	for (int i = 0; i < pp->n_pieces; ++i) {
 		total_dur += pp->pieces[i].duration;
@@ -160,6 +178,22 @@ static inline float piecewise_duration(struct piecewise_traj const *pp)
 	return total_dur * pp->timescale;
 }
 
+// compute the start time of each piece into piece_start, which must hold
+// at least n_pieces + 1 floats, and attach it to the trajectory.
+// must be called again whenever the pieces or their durations change.
+void piecewise_prepare(struct piecewise_traj *traj, float* piece_start);
+
+// detach the piece start times attached by piecewise_prepare(). evaluation
+// falls back to walking the pieces, which is always valid, so this must be
+// called before the pieces are replaced by a planner that does not prepare.
+void piecewise_unprepare(struct piecewise_traj *traj);
+
+// find the index of the piece that is active at the given (unscaled) time
+// relative to t_begin. uses the cursor of the last evaluation and falls back
+// to binary search on seeks. times outside the trajectory are clamped to the
+// first or last piece.
+int piecewise_find_piece(struct piecewise_traj *traj, float t_relative);
+
 void piecewise_plan_5th_order(struct piecewise_traj *p, float duration,
 	struct vec p0, float y0, struct vec v0, float dy0, struct vec a0,
 	struct vec p1, float y1, struct vec v1, float dy1, struct vec a1);
@@ -168,11 +202,96 @@ void piecewise_plan_7th_order_no_jerk(struct piecewise_traj *p, float duration,
 	struct vec p0, float y0, struct vec v0, float dy0, struct vec a0,
 	struct vec p1, float y1, struct vec v1, float dy1, struct vec a1);
 
+// maximum number of pieces of piecewise_plan_min_snap()
+#define PIECEWISE_MIN_SNAP_MAX_PIECES (8)
+
+// plan a minimum snap trajectory from the given initial state through
+// n_waypoints waypoints, coming to rest at the last one. durations[i] is the
+// time to fly to waypoints[i]. the result is written to pieces, which must
+// hold n_waypoints pieces. uses a static workspace, so it is not reentrant.
+// returns 0 on success.
+int piecewise_plan_min_snap(struct piecewise_traj *p, struct poly4d *pieces,
+	struct vec p0, float y0, struct vec v0, float dy0, struct vec a0,
+	int n_waypoints, struct vec const *waypoints, float const *yaws, float const *durations);
+
+// exact bounds of the derivatives of a piecewise trajectory at timescale 1,
+// see piecewise_bounds().
+struct piecewise_bounds
+{
+	float max_vel;  // largest norm of the velocity [m/s]
+	float max_acc;  // largest norm of the acceleration [m/s^2]
+	float max_jerk; // largest norm of the jerk [m/s^3]
+	float max_discontinuity; // largest jump of position, velocity or acceleration at a piece join, yaw excluded
+};
+
+// envelope a piecewise trajectory has to stay in. a limit of zero is not checked.
+struct piecewise_limits
+{
+	float max_vel;  // [m/s]
+	float max_acc;  // [m/s^2]
+	float max_jerk; // [m/s^3]
+	float max_discontinuity;
+};
+
+enum piecewise_verify_result
+{
+	PIECEWISE_FEASIBLE       = 0,
+	PIECEWISE_TOO_FAST       = 1,
+	PIECEWISE_TOO_MUCH_ACC   = 2,
+	PIECEWISE_TOO_MUCH_JERK  = 3,
+	PIECEWISE_DISCONTINUOUS  = 4,
+};
+
+// compute the exact bounds of the derivatives of the trajectory, ignoring its
+// timescale. the maxima are found at the roots of the derivatives of the squared
+// norms, which are isolated by bisection between the roots of their own derivatives.
+// uses a static workspace, so it is not reentrant.
+void piecewise_bounds(struct piecewise_traj const *traj, struct piecewise_bounds *bounds);
+
+// check bounds from piecewise_bounds() against the limits, when flown at the given timescale.
+enum piecewise_verify_result piecewise_check_bounds(struct piecewise_bounds const *bounds,
+	float timescale, struct piecewise_limits const *limits);
+
+#ifdef PPTRAJ_FIXED_POINT
+//
+// fixed-point evaluation, enabled by defining PPTRAJ_FIXED_POINT.
+// the coefficients of each piece are converted to 32 bit integers in
+// normalized time s = t / duration, so the horner steps multiply by s <= 1 and
+// cannot overflow. each axis has its own exponent, which puts the position in
+// 31 bit precision. the coefficients are scaled in float, so they carry float
+// precision, and the horner evaluation adds at most (8 - k) units in the last
+// place to the k-th derivative, see poly4d_fixed_eval() and
+// tests/host/test_pptraj_fixed.c.
+//
+
+struct poly4d_fixed
+{
+	int32_t p[4][PP_SIZE]; // coefficients in normalized time, scaled by 2^exponent
+	int8_t exponent[4];
+	int8_t der_shift[4][3]; // right shift of the coefficients of the 1st to 3rd derivative
+	int32_t duration_q;     // duration scaled by 2^time_exponent
+	int8_t time_exponent;
+	float duration;
+};
+
+// convert a piece to fixed point.
+void poly4d_to_fixed(struct poly4d const *p, struct poly4d_fixed *fixed);
+
+// evaluate a fixed point piece at time t in [0, duration].
+struct traj_eval poly4d_fixed_eval(struct poly4d_fixed const *p, float t);
+
+// convert the pieces of a trajectory to fixed point, so that piecewise_eval()
+// and piecewise_eval_reversed() evaluate them. fixed_pieces must hold
+// n_pieces pieces.
+void piecewise_prepare_fixed(struct piecewise_traj *traj, struct poly4d_fixed* fixed_pieces);
+#endif
+
+// evaluate a piecewise trajectory. updates the cursor of the trajectory.
 struct traj_eval piecewise_eval(
-	struct piecewise_traj const *traj, float t);
+	struct piecewise_traj *traj, float t);
 
 struct traj_eval piecewise_eval_reversed(
-	struct piecewise_traj const *traj, float t);
+	struct piecewise_traj *traj, float t);
 
 
 static inline bool piecewise_is_finished(struct piecewise_traj const *traj, float t)
@@ -27,6 +27,7 @@
 #pragma once
 
 #include "pptraj.h"
+#include <stdint.h>
 #include <stdio.h>
 
 enum piecewise_traj_storage_type {
@@ -40,6 +41,23 @@ enum piecewise_traj_storage_type {
 // compressed piecewise polynomial trajectories //
 // ---------------------------------------------//
 
+// a single decoded piece of a compressed trajectory
+struct piecewise_traj_compressed_piece
+{
+	// raw representation of the piece
+	const void* data;
+
+	// start time of the piece, relative to the "global" start time of
+	// the entire trajectory
+	float t_begin_relative;
+
+	// poly4d representation of the piece
+	struct poly4d poly4d;
+
+	// x, y, z, yaw at the end of the piece; the next piece starts here
+	float end[4];
+};
+
 struct piecewise_traj_compressed
 {
 	float t_begin;
@@ -50,17 +68,17 @@ struct piecewise_traj_compressed
 
 	// mutable part of the data structure. We plan to mess around with this part
 	// but keep the rest untouched (i.e. supplied by the user)
-	struct {
-		// raw representation of the current piece
-		const void* data;
+	struct piecewise_traj_compressed_piece current_piece;
 
-		// start time of the current piece, relative to the "global" start time of
-		// the entire trajectory
-		float t_begin_relative;
+	// the piece following current_piece, decoded ahead of time by
+	// piecewise_compressed_decode_next() and piecewise_compressed_publish_next()
+	// so that switching pieces on the control path is a copy instead of a decode
+	struct piecewise_traj_compressed_piece next_piece;
+	bool next_piece_valid;
 
-		// poly4d representation of the current piece
-		struct poly4d poly4d;
-	} current_piece;
+	// number of piece switches that had to decode inline because the next
+	// piece was not prefetched in time
+	uint32_t inline_decodes;
 };
 
 // Returns the total duration of a compressed trajectory. The total duration
@@ -80,6 +98,28 @@ static inline bool piecewise_compressed_is_finished(
 struct traj_eval piecewise_compressed_eval(
 	struct piecewise_traj_compressed *traj, float t);
 
-// Loads the compressed trajectory at the given pointer
+// Loads the compressed trajectory at the given pointer. The data should have
+// been checked with piecewise_compressed_validate() first.
 void piecewise_compressed_load(
 	struct piecewise_traj_compressed *traj, const void* data);
+
+// Checks that the compressed trajectory at the given pointer is well-formed,
+// i.e. that every piece has a known storage type, that the trajectory is
+// terminated and that no piece extends beyond size bytes.
+bool piecewise_compressed_validate(const void* data, uint32_t size);
+
+// Decodes the piece following the given piece, a copy of the current piece of
+// a trajectory, into next. Returns false if the piece is the last one. Does
+// not touch the trajectory, so that the decode can run outside the lock that
+// protects it.
+bool piecewise_compressed_decode_next(
+	struct piecewise_traj_compressed_piece const *piece,
+	struct piecewise_traj_compressed_piece *next);
+
+// Makes next, decoded from a copy of the current piece, the next piece of the
+// trajectory. Returns false and leaves the trajectory untouched if it has moved
+// on from that piece or already has a next piece. Cheap enough for the
+// control path.
+bool piecewise_compressed_publish_next(struct piecewise_traj_compressed *traj,
+	struct piecewise_traj_compressed_piece const *piece,
+	struct piecewise_traj_compressed_piece const *next);
@@ -0,0 +1,61 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * rate_loop.h - Rate loop driven by the IMU data-ready
+ */
+
+#ifndef __RATE_LOOP_H__
+#define __RATE_LOOP_H__
+
+#include <stdbool.h>
+
+#include "stabilizer_types.h"
+#include "imu_types.h"
+
+/**
+ * Called by the rate loop with the new control output, typically the
+ * power distribution.
+ */
+typedef void (*rateLoopOutput_t)(const control_t *control);
+
+/**
+ * Start the rate loop task. The rate loop is split off controllerPid() while
+ * the rateLoop.enable param is set.
+ *
+ * @param output Function that drives the motors with the rate loop output
+ */
+void rateLoopInit(rateLoopOutput_t output);
+bool rateLoopTest(void);
+
+/**
+ * @return true while the rate loop runs on its own and drives the motors
+ */
+bool rateLoopIsEnabled(void);
+
+/**
+ * Hand a new gyro sample to the rate loop. Called by estimatorEnqueueData()
+ * with each gyro sample, may be called from an ISR.
+ *
+ * @param gyro Gyro sample in deg/s
+ */
+void rateLoopImuDataReady(const Axis3f *gyro);
+
+#endif //__RATE_LOOP_H__
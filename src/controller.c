@@ -1,6 +1,8 @@
 #define DEBUG_MODULE "CONTROLLER"
 // #include "debug.h"
 
+#include <errno.h>
+
 #include "cfassert.h"
 #include "controller.h"
 #include "controller_pid.h"
@@ -9,10 +11,38 @@
 // #include "controller_indi.h"
 // #include "controller_brescianini.h"
 
+#include "param.h"
+
 #include "autoconf.h"
 
 #define DEFAULT_CONTROLLER ControllerTypePID
+
+#if defined(CONFIG_CONTROLLER_PID)
+  #define CONTROLLER ControllerTypePID
+#elif defined(CONFIG_CONTROLLER_INDI)
+  #define CONTROLLER ControllerTypeINDI
+#elif defined(CONFIG_CONTROLLER_MELLINGER)
+  #define CONTROLLER ControllerTypeMellinger
+#elif defined(CONFIG_CONTROLLER_BRESCIANINI)
+  #define CONTROLLER ControllerTypeBrescianini
+#else
+  #define CONTROLLER ControllerTypeAutoSelect
+#endif
+
+// A build with a forced controller and no out of tree controller can only run
+// one controller, call it directly instead of through the registry
+#if defined(CONFIG_CONTROLLER_PID) && !defined(CONFIG_CONTROLLER_OOT)
+  #define CONTROLLER_SINGLE_UPDATE controllerPid
+#endif
+
 static ControllerType currentController = ControllerTypeAutoSelect;
+static uint8_t requestedController = ControllerTypeAutoSelect;
+// Controller initialized by controllerRequest(), the stabilizer switches to it
+// in its next controller() call
+static ControllerType readyController = ControllerTypeAutoSelect;
+
+// Last output, handed over to the next controller on a switch
+static control_t lastControl;
 
 static void initController();
 
@@ -20,20 +50,27 @@ typedef struct {
   void (*init)(void);
   bool (*test)(void);
   void (*update)(control_t *control, const setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick);
+  // Optional. Seed the controller from the last output of the previous controller
+  // and the current state, so that the switch does not cause a step.
+  void (*handover)(const control_t *lastControl, const state_t *state);
   const char* name;
 } ControllerFcns;
 
-static ControllerFcns controllerFunctions[] = {
-  {.init = 0, .test = 0, .update = 0, .name = "None"}, // Any
-  {.init = controllerPidInit, .test = controllerPidTest, .update = controllerPid, .name = "PID"},
-  // {.init = controllerMellingerFirmwareInit, .test = controllerMellingerFirmwareTest, .update = controllerMellingerFirmware, .name = "Mellinger"},
-  // {.init = controllerINDIInit, .test = controllerINDITest, .update = controllerINDI, .name = "INDI"},
-  // {.init = controllerBrescianiniInit, .test = controllerBrescianiniTest, .update = controllerBrescianini, .name = "Brescianini"},
+static ControllerFcns controllerFunctions[ControllerType_COUNT] = {
+  [ControllerTypeAutoSelect] = {.init = 0, .test = 0, .update = 0, .name = "None"}, // Any
+  [ControllerTypePID] = {.init = controllerPidInit, .test = controllerPidTest, .update = controllerPid, .handover = controllerPidHandover, .name = "PID"},
+  // [ControllerTypeMellinger] = {.init = controllerMellingerFirmwareInit, .test = controllerMellingerFirmwareTest, .update = controllerMellingerFirmware, .name = "Mellinger"},
+  // [ControllerTypeINDI] = {.init = controllerINDIInit, .test = controllerINDITest, .update = controllerINDI, .name = "INDI"},
+  // [ControllerTypeBrescianini] = {.init = controllerBrescianiniInit, .test = controllerBrescianiniTest, .update = controllerBrescianini, .name = "Brescianini"},
   #ifdef CONFIG_CONTROLLER_OOT
-  {.init = controllerOutOfTreeInit, .test = controllerOutOfTreeTest, .update = controllerOutOfTree, .name = "OutOfTree"},
+  [ControllerTypeOot] = {.init = controllerOutOfTreeInit, .test = controllerOutOfTreeTest, .update = controllerOutOfTree, .name = "OutOfTree"},
   #endif
 };
 
+static bool isAvailable(ControllerType controller) {
+  return controller > ControllerTypeAutoSelect && controller < ControllerType_COUNT &&
+         controllerFunctions[controller].update != 0;
+}
 
 void controllerInit(ControllerType controller) {
   if (controller < 0 || controller >= ControllerType_COUNT) {
@@ -46,18 +83,6 @@ void controllerInit(ControllerType controller) {
     currentController = DEFAULT_CONTROLLER;
   }
 
-  #if defined(CONFIG_CONTROLLER_PID)
-    #define CONTROLLER ControllerTypePID
-  #elif defined(CONFIG_CONTROLLER_INDI)
-    #define CONTROLLER ControllerTypeINDI
-  #elif defined(CONFIG_CONTROLLER_MELLINGER)
-    #define CONTROLLER ControllerTypeMellinger
-  #elif defined(CONFIG_CONTROLLER_BRESCIANINI)
-    #define CONTROLLER ControllerTypeBrescianini
-  #else
-    #define CONTROLLER ControllerTypeAutoSelect
-  #endif
-
   ControllerType forcedController = CONTROLLER;
   if (forcedController != ControllerTypeAutoSelect) {
     printk("Controller type forced\n");
@@ -65,6 +90,8 @@ void controllerInit(ControllerType controller) {
   }
 
   initController();
+  requestedController = currentController;
+  readyController = currentController;
 
   printk("Using %s (%d) controller\n", controllerGetName(), currentController);
 }
@@ -77,14 +104,88 @@ static void initController() {
   controllerFunctions[currentController].init();
 }
 
+int controllerRequest(ControllerType controller) {
+  // Only the stabilizer changes the current controller, and only to the ready
+  // one, so neither of them is running while another one is initialized
+  ControllerType ready = __atomic_load_n(&readyController, __ATOMIC_ACQUIRE);
+  if (controller == currentController) {
+    __atomic_store_n(&readyController, currentController, __ATOMIC_RELEASE);
+    return 0;
+  }
+  if (controller == ready) {
+    return 0;
+  }
+
+  if (CONTROLLER != ControllerTypeAutoSelect || !isAvailable(controller)) {
+    return EINVAL;
+  }
+
+  // The split rate loop only runs the PID controller
+  if (currentController == ControllerTypePID && controllerPidRateLoopEnabled()) {
+    return EBUSY;
+  }
+
+  controllerFunctions[controller].init();
+  __atomic_store_n(&readyController, controller, __ATOMIC_RELEASE);
+
+  return 0;
+}
+
+// Switches to the controller readied by controllerRequest(), seeding it from
+// the last output of the current one
+static void switchToReadyController(const state_t *state) {
+  ControllerType ready = __atomic_load_n(&readyController, __ATOMIC_ACQUIRE);
+  if (ready == currentController) {
+    return;
+  }
+
+  const ControllerFcns* next = &controllerFunctions[ready];
+  if (next->handover) {
+    next->handover(&lastControl, state);
+  }
+  currentController = ready;
+}
+
+static void controllerRequested(void) {
+  if (controllerRequest(requestedController) != 0) {
+    requestedController = currentController;
+  }
+}
+
 bool controllerTest(void) {
   return controllerFunctions[currentController].test();
 }
 
 void controller(control_t *control, const setpoint_t *setpoint, const sensorData_t *sensors, const state_t *state, const uint32_t tick) {
+#ifdef CONTROLLER_SINGLE_UPDATE
+  CONTROLLER_SINGLE_UPDATE(control, setpoint, sensors, state, tick);
+#else
+  switchToReadyController(state);
+
   controllerFunctions[currentController].update(control, setpoint, sensors, state, tick);
+  lastControl = *control;
+#endif
 }
 
 const char* controllerGetName() {
   return controllerFunctions[currentController].name;
 }
+
+/**
+ * Controller selection
+ */
+PARAM_GROUP_START(controller)
+#ifdef CONTROLLER_SINGLE_UPDATE
+/**
+ * @brief Controller in use (1: PID, 2: Mellinger, 3: INDI, 4: Brescianini, 5: Out of tree).
+ * Read only, this build runs a single controller.
+ */
+PARAM_ADD(PARAM_UINT8 | PARAM_RONLY, type, &requestedController)
+#else
+/**
+ * @brief Controller to use, can be changed in flight (1: PID, 2: Mellinger, 3: INDI, 4: Brescianini, 5: Out of tree).
+ * Reads back the active controller if the requested one is not available.
+ */
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT8, type, &requestedController, &controllerRequested)
+#endif
+PARAM_GROUP_STOP(controller)
@@ -0,0 +1,713 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * controller_bench.c - On-target benchmark of the controllers, filters,
+ * estimator covariance updates and math3d kernels
+ *
+ * Runs the controllers on a reproducible synthetic flight trace, one main
+ * loop tick at a time, and measures every call. On target the DWT cycle
+ * counter is read through the timing API, on native_sim the host clock is
+ * used instead.
+ */
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+
+#include "config.h"
+#include "controller_bench.h"
+#include "controller_pid.h"
+#include "attitude_controller.h"
+#include "position_controller.h"
+#include "filter.h"
+#include "filter_bank.h"
+#include "kalman_covariance.h"
+#include "math3d.h"
+#include "system.h"
+
+#include "param.h"
+#include "log.h"
+
+#ifdef CONFIG_ARCH_POSIX
+#include <time.h>
+#else
+#include <zephyr/timing/timing.h>
+#endif
+
+// Length of the trace in main loop ticks
+#define BENCH_TICKS RATE_MAIN_LOOP
+#define BENCH_HOVER_THRUST 36000.0f
+#define BENCH_GRAVITY 9.81f
+// Vectors per call of the math3d cases
+#define BENCH_VECS 16
+#define BENCH_MATS 4
+
+static controllerBenchResult_t results[ControllerBench_COUNT];
+// Consumes the outputs of the math3d cases, so that they are not optimized out
+static volatile float benchSink;
+
+static bool isInit;
+static uint8_t runRequest;
+static uint8_t lastError;
+
+// The cases keep a few kB of state on the stack, more than the system
+// workqueue has, so the benchmark runs in a thread of its own
+K_THREAD_STACK_DEFINE(controllerBenchTaskStack, CONTROLLER_BENCH_TASK_STACKSIZE);
+static struct k_thread controllerBenchTaskThread;
+static K_SEM_DEFINE(benchStart, 0, 1);
+
+#ifdef CONFIG_ARCH_POSIX
+typedef uint64_t benchTime_t;
+
+static void benchTimeInit(void) {}
+
+static void benchTimeStop(void) {}
+
+static benchTime_t benchNow(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint32_t benchElapsed(benchTime_t start, benchTime_t end)
+{
+  return (uint32_t)(end - start);
+}
+#else
+typedef timing_t benchTime_t;
+
+static void benchTimeInit(void)
+{
+  timing_init();
+  timing_start();
+}
+
+static void benchTimeStop(void)
+{
+  timing_stop();
+}
+
+static benchTime_t benchNow(void)
+{
+  return timing_counter_get();
+}
+
+static uint32_t benchElapsed(benchTime_t start, benchTime_t end)
+{
+  return (uint32_t)timing_cycles_get(&start, &end);
+}
+#endif
+
+// xorshift32, reproducible sensor noise
+static float benchNoise(uint32_t* state)
+{
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return (x >> 8) / (float)(1 << 23) - 1.0f;
+}
+
+// A gentle oscillation around hover at 0.5 m, with gyro and accelerometer noise
+static void benchTrace(uint32_t tick, uint32_t* seed, sensorData_t* sensors, state_t* state)
+{
+  float t = tick / (float)RATE_MAIN_LOOP;
+  float w = 2.0f * (float)M_PI * 2.0f;
+
+  memset(state, 0, sizeof(*state));
+  state->attitude.roll = 5.0f * sinf(w * t);
+  state->attitude.pitch = 5.0f * cosf(w * t);
+  state->attitude.yaw = 20.0f * sinf(0.5f * w * t);
+  state->attitudeQuaternion.w = 1.0f;
+  state->position.x = 0.05f * sinf(w * t);
+  state->position.y = 0.05f * cosf(w * t);
+  state->position.z = 0.5f + 0.02f * sinf(0.5f * w * t);
+  state->velocity.x = 0.05f * w * cosf(w * t);
+  state->velocity.y = -0.05f * w * sinf(w * t);
+
+  memset(sensors, 0, sizeof(*sensors));
+  sensors->gyro.x = 5.0f * w * cosf(w * t) + benchNoise(seed);
+  sensors->gyro.y = -5.0f * w * sinf(w * t) + benchNoise(seed);
+  sensors->gyro.z = 10.0f * w * cosf(0.5f * w * t) + benchNoise(seed);
+  sensors->acc.x = 0.01f * benchNoise(seed);
+  sensors->acc.y = 0.01f * benchNoise(seed);
+  sensors->acc.z = 1.0f + 0.01f * benchNoise(seed);
+}
+
+// Kalman filter states: position, body velocity and attitude error
+#define KC_N KC_COV_MAX_STATES
+enum { KC_X, KC_Y, KC_Z, KC_PX, KC_PY, KC_PZ, KC_D0, KC_D1, KC_D2 };
+
+// Dense matrices of the reference implementation, as in the Kalman filter
+static float kcP[KC_N][KC_N];
+static float kcF[KC_N][KC_N];
+static float kcTmp1[KC_N][KC_N];
+static float kcTmp2[KC_N][KC_N];
+static float kcTmp3[KC_N][KC_N];
+static arm_matrix_instance_f32 kcPm = {KC_N, KC_N, (float*)kcP};
+static arm_matrix_instance_f32 kcFm = {KC_N, KC_N, (float*)kcF};
+static arm_matrix_instance_f32 kcTmp1m = {KC_N, KC_N, (float*)kcTmp1};
+static arm_matrix_instance_f32 kcTmp2m = {KC_N, KC_N, (float*)kcTmp2};
+static arm_matrix_instance_f32 kcTmp3m = {KC_N, KC_N, (float*)kcTmp3};
+
+static void benchKcAdd(kalmanSparseEntry_t* f, int* count, int row, int col, float value)
+{
+  f[*count] = (kalmanSparseEntry_t){.row = row, .col = col, .value = value};
+  (*count)++;
+  kcF[row][col] = value;
+}
+
+// Transition matrix with the sparsity of the Kalman filter, 42 of 81 entries
+static int benchKcTransition(const sensorData_t* sensors, const state_t* state, kalmanSparseEntry_t* f)
+{
+  const float dt = 1.0f / RATE_100_HZ;
+  const float gx = radians(sensors->gyro.x) * dt;
+  const float gy = radians(sensors->gyro.y) * dt;
+  const float gz = radians(sensors->gyro.z) * dt;
+  const float roll = radians(state->attitude.roll);
+  const float pitch = radians(state->attitude.pitch);
+  int count = 0;
+
+  memset(kcF, 0, sizeof(kcF));
+  for (int i = 0; i < KC_N; i++) {
+    benchKcAdd(f, &count, i, i, 1.0f);
+  }
+
+  // position from body velocity
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      benchKcAdd(f, &count, KC_X + i, KC_PX + j, (i == j ? 1.0f : 0.1f * (roll - pitch)) * dt);
+    }
+  }
+
+  // position from attitude error
+  benchKcAdd(f, &count, KC_X, KC_D1, state->velocity.z * dt);
+  benchKcAdd(f, &count, KC_X, KC_D2, -state->velocity.y * dt);
+  benchKcAdd(f, &count, KC_Y, KC_D0, -state->velocity.z * dt);
+  benchKcAdd(f, &count, KC_Y, KC_D2, state->velocity.x * dt);
+  benchKcAdd(f, &count, KC_Z, KC_D0, state->velocity.y * dt);
+  benchKcAdd(f, &count, KC_Z, KC_D1, -state->velocity.x * dt);
+
+  // body velocity from body velocity
+  benchKcAdd(f, &count, KC_PX, KC_PY, gz);
+  benchKcAdd(f, &count, KC_PX, KC_PZ, -gy);
+  benchKcAdd(f, &count, KC_PY, KC_PX, -gz);
+  benchKcAdd(f, &count, KC_PY, KC_PZ, gx);
+  benchKcAdd(f, &count, KC_PZ, KC_PX, gy);
+  benchKcAdd(f, &count, KC_PZ, KC_PY, -gx);
+
+  // body velocity from attitude error, gravity
+  benchKcAdd(f, &count, KC_PX, KC_D1, -BENCH_GRAVITY * cosf(pitch) * dt);
+  benchKcAdd(f, &count, KC_PX, KC_D2, 0.1f * dt);
+  benchKcAdd(f, &count, KC_PY, KC_D0, BENCH_GRAVITY * cosf(roll) * dt);
+  benchKcAdd(f, &count, KC_PY, KC_D2, -0.1f * dt);
+  benchKcAdd(f, &count, KC_PZ, KC_D0, BENCH_GRAVITY * sinf(roll) * dt);
+  benchKcAdd(f, &count, KC_PZ, KC_D1, -BENCH_GRAVITY * sinf(pitch) * dt);
+
+  // attitude error from attitude error
+  benchKcAdd(f, &count, KC_D0, KC_D1, gz);
+  benchKcAdd(f, &count, KC_D0, KC_D2, -gy);
+  benchKcAdd(f, &count, KC_D1, KC_D0, -gz);
+  benchKcAdd(f, &count, KC_D1, KC_D2, gx);
+  benchKcAdd(f, &count, KC_D2, KC_D0, gy);
+  benchKcAdd(f, &count, KC_D2, KC_D1, -gx);
+
+  return count;
+}
+
+static void benchKcPredictDense(const float* processNoise)
+{
+  mat_mult(&kcFm, &kcPm, &kcTmp1m);
+  mat_trans(&kcFm, &kcTmp2m);
+  mat_mult(&kcTmp1m, &kcTmp2m, &kcPm);
+  for (int i = 0; i < KC_N; i++) {
+    kcP[i][i] += processNoise[i];
+  }
+}
+
+static void benchKcUpdateDense(const float* h, float error, float stdMeasNoise, float* stateDelta)
+{
+  float k[KC_N];
+  float pht[KC_N];
+  arm_matrix_instance_f32 hm = {1, KC_N, (float*)h};
+  arm_matrix_instance_f32 htm = {KC_N, 1, kcTmp3[0]};
+  arm_matrix_instance_f32 phtm = {KC_N, 1, pht};
+  const float r = stdMeasNoise * stdMeasNoise;
+
+  mat_trans(&hm, &htm);
+  mat_mult(&kcPm, &htm, &phtm);
+  float s = r;
+  for (int i = 0; i < KC_N; i++) {
+    s += h[i] * pht[i];
+  }
+  for (int i = 0; i < KC_N; i++) {
+    k[i] = pht[i] / s;
+    stateDelta[i] += k[i] * error;
+  }
+
+  // Joseph form, (K H - I) P (K H - I)' + K R K'
+  for (int i = 0; i < KC_N; i++) {
+    for (int j = 0; j < KC_N; j++) {
+      kcTmp1[i][j] = k[i] * h[j] - (i == j ? 1.0f : 0.0f);
+    }
+  }
+  mat_trans(&kcTmp1m, &kcTmp2m);
+  mat_mult(&kcTmp1m, &kcPm, &kcTmp3m);
+  mat_mult(&kcTmp3m, &kcTmp2m, &kcPm);
+  for (int i = 0; i < KC_N; i++) {
+    for (int j = 0; j < KC_N; j++) {
+      kcP[i][j] += k[i] * r * k[j];
+    }
+  }
+}
+
+static void benchSetpoint(ControllerBenchCase benchCase, setpoint_t* setpoint)
+{
+  memset(setpoint, 0, sizeof(*setpoint));
+
+  switch (benchCase) {
+    case ControllerBenchPosition:
+    case ControllerBenchPositionOnly:
+      setpoint->mode.x = modeAbs;
+      setpoint->mode.y = modeAbs;
+      setpoint->mode.z = modeAbs;
+      setpoint->mode.yaw = modeAbs;
+      setpoint->position.z = 0.5f;
+      break;
+    case ControllerBenchThrustZero:
+      setpoint->mode.roll = modeAbs;
+      setpoint->mode.pitch = modeAbs;
+      setpoint->mode.yaw = modeAbs;
+      break;
+    default:
+      setpoint->mode.roll = modeAbs;
+      setpoint->mode.pitch = modeAbs;
+      setpoint->mode.yaw = benchCase == ControllerBenchYawVelocity ? modeVelocity : modeAbs;
+      setpoint->attitude.yaw = 10.0f;
+      setpoint->attitudeRate.yaw = 30.0f;
+      setpoint->thrust = BENCH_HOVER_THRUST;
+      break;
+  }
+}
+
+static void benchRecord(controllerBenchResult_t* result, uint64_t* total, uint32_t elapsed)
+{
+  result->calls++;
+  *total += elapsed;
+  if (elapsed > result->maxCycles) {
+    result->maxCycles = elapsed;
+  }
+}
+
+static void benchCase(ControllerBenchCase benchCase)
+{
+  controllerBenchResult_t* result = &results[benchCase];
+  uint64_t total = 0;
+  uint32_t seed = 2463534242u;
+  sensorData_t sensors;
+  state_t state;
+  setpoint_t setpoint;
+  control_t control;
+  lpf2pData lpf[3];
+  filterBank3_t bank;
+  attitude_t attitudeDesired = {0};
+  attitude_t rateDesired;
+  float thrust;
+  kalmanCovariance_t cov;
+  kalmanSparseEntry_t f[KC_N * KC_N];
+  int fCount = 0;
+  float kcStateDelta[KC_N] = {0};
+  const float kcVariances[KC_N] = {1.0f, 1.0f, 1.0f, 0.01f, 0.01f, 0.01f, 0.01f, 0.01f, 0.01f};
+  const float kcProcessNoise[KC_N] = {1e-6f, 1e-6f, 1e-6f, 1e-4f, 1e-4f, 1e-4f, 1e-5f, 1e-5f, 1e-5f};
+  // A range measurement, which depends on the height and the tilt
+  const uint8_t kcIndex[3] = {KC_Z, KC_D0, KC_D1};
+  const float kcH[3] = {1.0f, 0.02f, -0.02f};
+  float kcHDense[KC_N] = {0};
+  struct vec vecs[BENCH_VECS];
+  struct vec vecsOut[BENCH_VECS];
+  struct mat33 mats[BENCH_MATS];
+  struct mat33 matOut = meye();
+
+  memset(result, 0, sizeof(*result));
+  kalmanCovInit(&cov, KC_N, kcVariances);
+  memset(kcP, 0, sizeof(kcP));
+  for (int i = 0; i < KC_N; i++) {
+    kcP[i][i] = kcVariances[i];
+  }
+  for (int i = 0; i < 3; i++) {
+    kcHDense[kcIndex[i]] = kcH[i];
+  }
+  for (int i = 0; i < BENCH_VECS; i++) {
+    vecs[i] = mkvec(benchNoise(&seed), benchNoise(&seed), benchNoise(&seed));
+    vecsOut[i] = vzero();
+  }
+  memset(&control, 0, sizeof(control));
+  for (int i = 0; i < 3; i++) {
+    lpf2pInit(&lpf[i], RATE_MAIN_LOOP, 80);
+  }
+  filterBank3Init(&bank);
+  filterBank3AddLowPass(&bank, RATE_MAIN_LOOP, 80);
+  if (benchCase == ControllerBenchBank2) {
+    filterBank3AddNotch(&bank, RATE_MAIN_LOOP, 250, 3);
+  }
+  benchSetpoint(benchCase, &setpoint);
+
+  for (uint32_t tick = 1; tick <= BENCH_TICKS; tick++) {
+    benchTrace(tick, &seed, &sensors, &state);
+
+    benchTime_t start = benchNow();
+    switch (benchCase) {
+      case ControllerBenchAttitude:
+        if (!RATE_DO_EXECUTE(ATTITUDE_RATE, tick)) {
+          continue;
+        }
+        start = benchNow();
+        attitudeControllerCorrectAttitudePID(state.attitude.roll, state.attitude.pitch, state.attitude.yaw,
+                                    attitudeDesired.roll, attitudeDesired.pitch, attitudeDesired.yaw,
+                                    &rateDesired.roll, &rateDesired.pitch, &rateDesired.yaw);
+        attitudeControllerCorrectRatePID(sensors.gyro.x, -sensors.gyro.y, sensors.gyro.z,
+                                 rateDesired.roll, rateDesired.pitch, rateDesired.yaw);
+        attitudeControllerGetActuatorOutput(&control.roll, &control.pitch, &control.yaw);
+        break;
+      case ControllerBenchPositionOnly:
+        if (!RATE_DO_EXECUTE(POSITION_RATE, tick)) {
+          continue;
+        }
+        start = benchNow();
+        positionController(&thrust, &attitudeDesired, &setpoint, &state);
+        break;
+      case ControllerBenchRate:
+        if (!RATE_DO_EXECUTE(ATTITUDE_RATE, tick)) {
+          continue;
+        }
+        start = benchNow();
+        attitudeControllerCorrectRatePID(sensors.gyro.x, -sensors.gyro.y, sensors.gyro.z,
+                                 30.0f, -30.0f, 10.0f);
+        attitudeControllerGetActuatorOutput(&control.roll, &control.pitch, &control.yaw);
+        break;
+      case ControllerBenchLpf2p:
+        for (int i = 0; i < 3; i++) {
+          sensors.gyro.axis[i] = lpf2pApply(&lpf[i], sensors.gyro.axis[i]);
+        }
+        break;
+      case ControllerBenchBank1:
+      case ControllerBenchBank2:
+        filterBank3Apply(&bank, &sensors.gyro);
+        break;
+      case ControllerBenchKcPredict:
+      case ControllerBenchKcPredictDense:
+        if (!RATE_DO_EXECUTE(RATE_100_HZ, tick)) {
+          continue;
+        }
+        fCount = benchKcTransition(&sensors, &state, f);
+        start = benchNow();
+        if (benchCase == ControllerBenchKcPredict) {
+          kalmanCovPredict(&cov, f, fCount, kcProcessNoise);
+        } else {
+          benchKcPredictDense(kcProcessNoise);
+        }
+        break;
+      case ControllerBenchKcUpdate:
+      case ControllerBenchKcUpdateDense:
+        if (!RATE_DO_EXECUTE(RATE_100_HZ, tick)) {
+          continue;
+        }
+        start = benchNow();
+        if (benchCase == ControllerBenchKcUpdate) {
+          kalmanCovScalarUpdate(&cov, kcIndex, kcH, 3, 0.01f * benchNoise(&seed), 0.01f, kcStateDelta);
+        } else {
+          benchKcUpdateDense(kcHDense, 0.01f * benchNoise(&seed), 0.01f, kcStateDelta);
+        }
+        break;
+      case ControllerBenchQvrot:
+      case ControllerBenchQvrotBatch:
+      case ControllerBenchQvrotAccum:
+      case ControllerBenchQvrotAccumBatch: {
+        struct quat q = rpy2quat(mkvec(radians(state.attitude.roll), radians(state.attitude.pitch), radians(state.attitude.yaw)));
+        start = benchNow();
+        if (benchCase == ControllerBenchQvrot) {
+          for (int i = 0; i < BENCH_VECS; i++) {
+            vecsOut[i] = qvrot(q, vecs[i]);
+          }
+        } else if (benchCase == ControllerBenchQvrotBatch) {
+          qvrot_batch(vecsOut, q, vecs, BENCH_VECS);
+        } else if (benchCase == ControllerBenchQvrotAccum) {
+          for (int i = 0; i < BENCH_VECS; i++) {
+            vecsOut[i] = vadd(vecsOut[i], vscl(0.001f, qvrot(q, vecs[i])));
+          }
+        } else {
+          qvrot_accum_batch(vecsOut, q, 0.001f, vecs, BENCH_VECS);
+        }
+        break;
+      }
+      case ControllerBenchMmul:
+      case ControllerBenchMmulChain:
+        for (int i = 0; i < BENCH_MATS; i++) {
+          mats[i] = quat2rotmat(rpy2quat(mkvec(0.01f * i, radians(state.attitude.pitch), radians(state.attitude.yaw))));
+        }
+        start = benchNow();
+        if (benchCase == ControllerBenchMmul) {
+          matOut = mmul(mmul(mmul(mats[0], mats[1]), mats[2]), mats[3]);
+        } else {
+          matOut = mmul_chain(mats, BENCH_MATS);
+        }
+        break;
+      default:
+        controllerPid(&control, &setpoint, &sensors, &state, tick);
+        break;
+    }
+    benchTime_t end = benchNow();
+
+    benchRecord(result, &total, benchElapsed(start, end));
+  }
+
+  for (int i = 0; i < BENCH_VECS; i++) {
+    benchSink = vecsOut[i].x + vecsOut[i].y + vecsOut[i].z;
+  }
+  benchSink = matOut.m[0][0] + matOut.m[1][1] + matOut.m[2][2];
+
+  if (result->calls > 0) {
+    result->avgCycles = total / result->calls;
+  }
+
+  attitudeControllerResetAllPID();
+  positionControllerResetAllPID();
+}
+
+int controllerBenchRun(void)
+{
+  if (systemIsArmed()) {
+    return EBUSY;
+  }
+
+  // Keep the stabilizer and the rate loop off the PID state while it is benched
+  if (!controllerPidAcquire(K_MSEC(100))) {
+    return EBUSY;
+  }
+
+  benchTimeInit();
+
+  for (int i = 0; i < ControllerBench_COUNT; i++) {
+    benchCase(i);
+  }
+
+  benchTimeStop();
+  controllerPidRelease();
+
+  return 0;
+}
+
+const controllerBenchResult_t* controllerBenchGetResult(ControllerBenchCase benchCase)
+{
+  return &results[benchCase];
+}
+
+static void controllerBenchTask(void *p1, void *p2, void *p3)
+{
+  while (1) {
+    k_sem_take(&benchStart, K_FOREVER);
+    lastError = controllerBenchRun();
+  }
+}
+
+void controllerBenchInit(void)
+{
+  if (isInit) {
+    return;
+  }
+
+  k_thread_create(&controllerBenchTaskThread, controllerBenchTaskStack,
+                  K_THREAD_STACK_SIZEOF(controllerBenchTaskStack),
+                  controllerBenchTask,
+                  NULL, NULL, NULL,
+                  CONTROLLER_BENCH_TASK_PRI, 0, K_NO_WAIT);
+  k_thread_name_set(&controllerBenchTaskThread, CONTROLLER_BENCH_TASK_NAME);
+
+  isInit = true;
+}
+
+static void benchRequested(void)
+{
+  if (runRequest && isInit) {
+    k_sem_give(&benchStart);
+  }
+  runRequest = 0;
+}
+
+/**
+ * On-target benchmark of the controllers and filters
+ */
+PARAM_GROUP_START(controllerBench)
+/**
+ * @brief Set to non-zero to run the benchmark while disarmed, see the controllerBench log group
+ */
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT8, run, &runRequest, &benchRequested)
+PARAM_GROUP_STOP(controllerBench)
+
+/**
+ * Results of the last controller benchmark, in CPU cycles per call on target
+ * and nanoseconds per call on native_sim
+ */
+LOG_GROUP_START(controllerBench)
+/**
+ * @brief Error of the last run, EBUSY if it was requested while armed
+ */
+LOG_ADD(LOG_UINT8, error, &lastError)
+/**
+ * @brief controllerPid() with a yaw rate setpoint, average
+ */
+LOG_ADD(LOG_UINT32, yawVelAvg, &results[ControllerBenchYawVelocity].avgCycles)
+/**
+ * @brief controllerPid() with a yaw rate setpoint, worst case
+ */
+LOG_ADD(LOG_UINT32, yawVelMax, &results[ControllerBenchYawVelocity].maxCycles)
+/**
+ * @brief controllerPid() with an absolute yaw setpoint, average
+ */
+LOG_ADD(LOG_UINT32, yawAbsAvg, &results[ControllerBenchYawAbs].avgCycles)
+/**
+ * @brief controllerPid() with an absolute yaw setpoint, worst case
+ */
+LOG_ADD(LOG_UINT32, yawAbsMax, &results[ControllerBenchYawAbs].maxCycles)
+/**
+ * @brief controllerPid() with a position setpoint, average
+ */
+LOG_ADD(LOG_UINT32, posAvg, &results[ControllerBenchPosition].avgCycles)
+/**
+ * @brief controllerPid() with a position setpoint, worst case
+ */
+LOG_ADD(LOG_UINT32, posMax, &results[ControllerBenchPosition].maxCycles)
+/**
+ * @brief controllerPid() in the thrust zero reset path, average
+ */
+LOG_ADD(LOG_UINT32, zeroAvg, &results[ControllerBenchThrustZero].avgCycles)
+/**
+ * @brief controllerPid() in the thrust zero reset path, worst case
+ */
+LOG_ADD(LOG_UINT32, zeroMax, &results[ControllerBenchThrustZero].maxCycles)
+/**
+ * @brief Attitude and rate PIDs, average
+ */
+LOG_ADD(LOG_UINT32, attAvg, &results[ControllerBenchAttitude].avgCycles)
+/**
+ * @brief Attitude and rate PIDs, worst case
+ */
+LOG_ADD(LOG_UINT32, attMax, &results[ControllerBenchAttitude].maxCycles)
+/**
+ * @brief positionController(), average
+ */
+LOG_ADD(LOG_UINT32, pidPosAvg, &results[ControllerBenchPositionOnly].avgCycles)
+/**
+ * @brief positionController(), worst case
+ */
+LOG_ADD(LOG_UINT32, pidPosMax, &results[ControllerBenchPositionOnly].maxCycles)
+/**
+ * @brief Rate PIDs alone, average
+ */
+LOG_ADD(LOG_UINT32, rateAvg, &results[ControllerBenchRate].avgCycles)
+/**
+ * @brief Rate PIDs alone, worst case
+ */
+LOG_ADD(LOG_UINT32, rateMax, &results[ControllerBenchRate].maxCycles)
+/**
+ * @brief Three lpf2pApply() calls, average
+ */
+LOG_ADD(LOG_UINT32, lpfAvg, &results[ControllerBenchLpf2p].avgCycles)
+/**
+ * @brief Three lpf2pApply() calls, worst case
+ */
+LOG_ADD(LOG_UINT32, lpfMax, &results[ControllerBenchLpf2p].maxCycles)
+/**
+ * @brief filterBank3Apply() with one low pass stage, average
+ */
+LOG_ADD(LOG_UINT32, bank1Avg, &results[ControllerBenchBank1].avgCycles)
+/**
+ * @brief filterBank3Apply() with one low pass stage, worst case
+ */
+LOG_ADD(LOG_UINT32, bank1Max, &results[ControllerBenchBank1].maxCycles)
+/**
+ * @brief filterBank3Apply() with a low pass and a notch stage, average
+ */
+LOG_ADD(LOG_UINT32, bank2Avg, &results[ControllerBenchBank2].avgCycles)
+/**
+ * @brief filterBank3Apply() with a low pass and a notch stage, worst case
+ */
+LOG_ADD(LOG_UINT32, bank2Max, &results[ControllerBenchBank2].maxCycles)
+/**
+ * @brief Sparse covariance prediction, average
+ */
+LOG_ADD(LOG_UINT32, kcPredAvg, &results[ControllerBenchKcPredict].avgCycles)
+/**
+ * @brief Sparse covariance prediction, worst case
+ */
+LOG_ADD(LOG_UINT32, kcPredMax, &results[ControllerBenchKcPredict].maxCycles)
+/**
+ * @brief Dense covariance prediction, average
+ */
+LOG_ADD(LOG_UINT32, kcDPredAvg, &results[ControllerBenchKcPredictDense].avgCycles)
+/**
+ * @brief Dense covariance prediction, worst case
+ */
+LOG_ADD(LOG_UINT32, kcDPredMax, &results[ControllerBenchKcPredictDense].maxCycles)
+/**
+ * @brief Sparse scalar measurement update, average
+ */
+LOG_ADD(LOG_UINT32, kcUpdAvg, &results[ControllerBenchKcUpdate].avgCycles)
+/**
+ * @brief Sparse scalar measurement update, worst case
+ */
+LOG_ADD(LOG_UINT32, kcUpdMax, &results[ControllerBenchKcUpdate].maxCycles)
+/**
+ * @brief Dense scalar measurement update, average
+ */
+LOG_ADD(LOG_UINT32, kcDUpdAvg, &results[ControllerBenchKcUpdateDense].avgCycles)
+/**
+ * @brief Dense scalar measurement update, worst case
+ */
+LOG_ADD(LOG_UINT32, kcDUpdMax, &results[ControllerBenchKcUpdateDense].maxCycles)
+/**
+ * @brief qvrot() of 16 vectors by value, average
+ */
+LOG_ADD(LOG_UINT32, qvrotAvg, &results[ControllerBenchQvrot].avgCycles)
+/**
+ * @brief qvrot_batch() of 16 vectors, average
+ */
+LOG_ADD(LOG_UINT32, qvrotBAvg, &results[ControllerBenchQvrotBatch].avgCycles)
+/**
+ * @brief Rotate and accumulate 16 vectors by value, average
+ */
+LOG_ADD(LOG_UINT32, qvaccAvg, &results[ControllerBenchQvrotAccum].avgCycles)
+/**
+ * @brief qvrot_accum_batch() of 16 vectors, average
+ */
+LOG_ADD(LOG_UINT32, qvaccBAvg, &results[ControllerBenchQvrotAccumBatch].avgCycles)
+/**
+ * @brief Chain of 4 mmul() by value, average
+ */
+LOG_ADD(LOG_UINT32, mmulAvg, &results[ControllerBenchMmul].avgCycles)
+/**
+ * @brief mmul_chain() of 4 matrices, average
+ */
+LOG_ADD(LOG_UINT32, mchainAvg, &results[ControllerBenchMmulChain].avgCycles)
+LOG_GROUP_STOP(controllerBench)
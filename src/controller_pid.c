@@ -1,4 +1,6 @@
 
+#include <zephyr/kernel.h>
+
 #include "stabilizer_types.h"
 
 #include "attitude_controller.h"
@@ -6,10 +8,18 @@
 #include "controller_pid.h"
 
 #include "param.h"
+#include "param_logic.h"
 #include "math3d.h"
+#include "imu.h"
+#include "pm.h"
+#include "gain_schedule.h"
 
 #define ATTITUDE_UPDATE_DT    (float)(1.0f/ATTITUDE_RATE)
 
+// The rate PIDs share their update period with the attitude PIDs, so the split
+// rate loop has to run at the attitude rate.
+BUILD_ASSERT(IMU_UPDATE_FREQ == ATTITUDE_RATE, "rate loop period differs from the rate PID period");
+
 static attitude_t attitudeDesired;
 static attitude_t rateDesired;
 static float actuatorThrust;
@@ -23,10 +33,35 @@ static float r_pitch;
 static float r_yaw;
 static float accelz;
 
+// Scales of the PID gains at the current thrust and battery voltage
+static gainScale_t gainScale = {1.0f, 1.0f, 1.0f};
+// Roll and pitch limits of the position controller, the scaled commands are
+// kept within them
+static paramVarId_t rollLimitId;
+static paramVarId_t pitchLimitId;
+
+// Split rate loop, see controllerPidEnableRateLoop(). The outer loop publishes
+// the desired rates and thrust, which the rate loop picks up with each gyro sample.
+static bool rateLoopEnabled;
+static struct k_spinlock rateLoopLock;
+static attitude_t rateLoopDesired;
+static float rateLoopThrust;
+static gainScale_t rateLoopScale;
+// Set while controllerPidAcquire() holds the controller, the rate loop idles
+static bool rateLoopHeld;
+
+// Held by the stabilizer around each update, and by controllerPidAcquire()
+// for an offline run such as the controller benchmark
+static K_MUTEX_DEFINE(ownerLock);
+
 void controllerPidInit(void)
 {
   attitudeControllerInit(ATTITUDE_UPDATE_DT);
   positionControllerInit();
+  gainScheduleInit();
+
+  rollLimitId = paramGetVarId("posCtlPid", "rLimit");
+  pitchLimitId = paramGetVarId("posCtlPid", "pLimit");
 }
 
 bool controllerPidTest(void)
@@ -38,24 +73,51 @@ bool controllerPidTest(void)
   return pass;
 }
 
-static float capAngle(float angle) {
-  float result = angle;
+void controllerPidHandover(const control_t *lastControl, const state_t *state)
+{
+  attitudeControllerResetAllPID();
+  positionControllerResetAllPID();
 
-  while (result > 180.0f) {
-    result -= 360.0f;
+  attitudeDesired = state->attitude;
+  if (lastControl->controlMode == controlModeLegacy) {
+    actuatorThrust = lastControl->thrust;
   }
+}
+
+static int16_t scaleOutput(int16_t output, float scale) {
+  return (int16_t)clamp(output * scale, INT16_MIN, INT16_MAX);
+}
 
-  while (result < -180.0f) {
-    result += 360.0f;
+// Scaling the output of a rate PID scales its P, I and D terms alike, and
+// is applied after the PID has limited its output
+static void scaleRateOutput(control_t *control, const gainScale_t *scale) {
+  control->roll = scaleOutput(control->roll, scale->rateRollPitch);
+  control->pitch = scaleOutput(control->pitch, scale->rateRollPitch);
+  control->yaw = scaleOutput(control->yaw, scale->rateYaw);
+}
+
+static float capAngle(float angle) {
+  return wrap_degrees(angle);
+}
+
+// Yaw of the last absolute quaternion setpoint. Setpoints arrive slower than
+// the attitude rate, so the yaw is only extracted when the quaternion changes.
+static float quatYaw(const quaternion_t *q) {
+  static quaternion_t lastQuat;
+  static float lastYaw;
+
+  if (q->x != lastQuat.x || q->y != lastQuat.y || q->z != lastQuat.z || q->w != lastQuat.w) {
+    lastQuat = *q;
+    lastYaw = degrees(quat2yaw(mkquat(q->x, q->y, q->z, q->w)));
   }
 
-  return result;
+  return lastYaw;
 }
 
-void controllerPid(control_t *control, const setpoint_t *setpoint,
-                                         const sensorData_t *sensors,
-                                         const state_t *state,
-                                         const uint32_t tick)
+static void controllerPidUpdate(control_t *control, const setpoint_t *setpoint,
+                                const sensorData_t *sensors,
+                                const state_t *state,
+                                const uint32_t tick)
 {
   control->controlMode = controlModeLegacy;
 
@@ -67,7 +129,7 @@ void controllerPid(control_t *control, const setpoint_t *setpoint,
       float yawMaxDelta = attitudeControllerGetYawMaxDelta();
       if (yawMaxDelta != 0.0f)
       {
-      float delta = capAngle(attitudeDesired.yaw-state->attitude.yaw);
+      float delta = shortest_signed_angle_degrees(state->attitude.yaw, attitudeDesired.yaw);
       // keep the yaw setpoint within +/- yawMaxDelta from the current yaw
         if (delta > yawMaxDelta)
         {
@@ -81,9 +143,7 @@ void controllerPid(control_t *control, const setpoint_t *setpoint,
     } else if (setpoint->mode.yaw == modeAbs) {
       attitudeDesired.yaw = setpoint->attitude.yaw;
     } else if (setpoint->mode.quat == modeAbs) {
-      struct quat setpoint_quat = mkquat(setpoint->attitudeQuaternion.x, setpoint->attitudeQuaternion.y, setpoint->attitudeQuaternion.z, setpoint->attitudeQuaternion.w);
-      struct vec rpy = quat2rpy(setpoint_quat);
-      attitudeDesired.yaw = degrees(rpy.z);
+      attitudeDesired.yaw = quatYaw(&setpoint->attitudeQuaternion);
     }
 
     attitudeDesired.yaw = capAngle(attitudeDesired.yaw);
@@ -91,6 +151,16 @@ void controllerPid(control_t *control, const setpoint_t *setpoint,
 
   if (RATE_DO_EXECUTE(POSITION_RATE, tick)) {
     positionController(&actuatorThrust, &attitudeDesired, setpoint, state);
+    gainScheduleLookup(actuatorThrust, pmGetBatteryVoltage(), &gainScale);
+    // The position controller has already limited the commands, keep the
+    // scaled ones within the same limits. Without them the commands are left
+    // unscaled.
+    if (PARAM_VARID_IS_VALID(rollLimitId) && PARAM_VARID_IS_VALID(pitchLimitId)) {
+      float rLimit = paramGetFloat(rollLimitId);
+      float pLimit = paramGetFloat(pitchLimitId);
+      attitudeDesired.roll = clamp(attitudeDesired.roll * gainScale.positionXy, -rLimit, rLimit);
+      attitudeDesired.pitch = clamp(attitudeDesired.pitch * gainScale.positionXy, -pLimit, pLimit);
+    }
   }
 
   if (RATE_DO_EXECUTE(ATTITUDE_RATE, tick)) {
@@ -98,6 +168,8 @@ void controllerPid(control_t *control, const setpoint_t *setpoint,
     if (setpoint->mode.z == modeDisable) {
       actuatorThrust = setpoint->thrust;
     }
+    // Rate scales of the thrust of this update
+    gainScheduleLookup(actuatorThrust, pmGetBatteryVoltage(), &gainScale);
     if (setpoint->mode.x == modeDisable || setpoint->mode.y == modeDisable) {
       attitudeDesired.roll = setpoint->attitude.roll;
       attitudeDesired.pitch = setpoint->attitude.pitch;
@@ -119,15 +191,29 @@ void controllerPid(control_t *control, const setpoint_t *setpoint,
       attitudeControllerResetPitchAttitudePID();
     }
 
-    // TODO: Investigate possibility to subtract gyro drift.
-    attitudeControllerCorrectRatePID(sensors->gyro.x, -sensors->gyro.y, sensors->gyro.z,
-                             rateDesired.roll, rateDesired.pitch, rateDesired.yaw);
-
-    attitudeControllerGetActuatorOutput(&control->roll,
-                                        &control->pitch,
-                                        &control->yaw);
-
-    control->yaw = -control->yaw;
+    if (rateLoopEnabled) {
+      // The rate loop runs on its own and drives the motors, the stabilizer
+      // only passes on the thrust
+      k_spinlock_key_t key = k_spin_lock(&rateLoopLock);
+      rateLoopDesired = rateDesired;
+      rateLoopThrust = actuatorThrust;
+      rateLoopScale = gainScale;
+      k_spin_unlock(&rateLoopLock, key);
+      control->roll = 0;
+      control->pitch = 0;
+      control->yaw = 0;
+    } else {
+      // TODO: Investigate possibility to subtract gyro drift.
+      attitudeControllerCorrectRatePID(sensors->gyro.x, -sensors->gyro.y, sensors->gyro.z,
+                               rateDesired.roll, rateDesired.pitch, rateDesired.yaw);
+
+      attitudeControllerGetActuatorOutput(&control->roll,
+                                          &control->pitch,
+                                          &control->yaw);
+
+      control->yaw = -control->yaw;
+      scaleRateOutput(control, &gainScale);
+    }
 
     cmd_thrust = control->thrust;
     cmd_roll = control->roll;
@@ -153,7 +239,15 @@ void controllerPid(control_t *control, const setpoint_t *setpoint,
     cmd_pitch = control->pitch;
     cmd_yaw = control->yaw;
 
-    attitudeControllerResetAllPID();
+    if (rateLoopEnabled) {
+      // The rate loop preempts this task, keep it out while its PIDs are reset
+      k_spinlock_key_t key = k_spin_lock(&rateLoopLock);
+      rateLoopThrust = 0;
+      attitudeControllerResetAllPID();
+      k_spin_unlock(&rateLoopLock, key);
+    } else {
+      attitudeControllerResetAllPID();
+    }
     positionControllerResetAllPID();
 
     // Reset the calculated YAW angle for rate control
@@ -161,6 +255,92 @@ void controllerPid(control_t *control, const setpoint_t *setpoint,
   }
 }
 
+void controllerPid(control_t *control, const setpoint_t *setpoint,
+                                         const sensorData_t *sensors,
+                                         const state_t *state,
+                                         const uint32_t tick)
+{
+  // Recursive, so the thread holding controllerPidAcquire() runs the controller
+  if (k_mutex_lock(&ownerLock, K_NO_WAIT) != 0) {
+    control->controlMode = controlModeLegacy;
+    control->thrust = 0;
+    control->roll = 0;
+    control->pitch = 0;
+    control->yaw = 0;
+    return;
+  }
+
+  controllerPidUpdate(control, setpoint, sensors, state, tick);
+  k_mutex_unlock(&ownerLock);
+}
+
+bool controllerPidAcquire(k_timeout_t timeout)
+{
+  if (k_mutex_lock(&ownerLock, timeout) != 0) {
+    return false;
+  }
+
+  k_spinlock_key_t key = k_spin_lock(&rateLoopLock);
+  rateLoopHeld = true;
+  k_spin_unlock(&rateLoopLock, key);
+
+  return true;
+}
+
+void controllerPidRelease(void)
+{
+  k_spinlock_key_t key = k_spin_lock(&rateLoopLock);
+  rateLoopHeld = false;
+  rateLoopThrust = 0;
+  attitudeControllerResetAllPID();
+  k_spin_unlock(&rateLoopLock, key);
+  positionControllerResetAllPID();
+
+  k_mutex_unlock(&ownerLock);
+}
+
+void controllerPidEnableRateLoop(bool enable)
+{
+  k_spinlock_key_t key = k_spin_lock(&rateLoopLock);
+  rateLoopEnabled = enable;
+  rateLoopThrust = 0;
+  k_spin_unlock(&rateLoopLock, key);
+}
+
+bool controllerPidRateLoopEnabled(void)
+{
+  return rateLoopEnabled;
+}
+
+void controllerPidRateLoop(control_t *control, const Axis3f *gyro)
+{
+  k_spinlock_key_t key = k_spin_lock(&rateLoopLock);
+  attitude_t desired = rateLoopDesired;
+  // A zero thrust leaves the rate PIDs alone
+  float thrust = rateLoopHeld ? 0 : rateLoopThrust;
+  gainScale_t scale = rateLoopScale;
+  k_spin_unlock(&rateLoopLock, key);
+
+  control->controlMode = controlModeLegacy;
+  control->thrust = thrust;
+
+  if (thrust == 0) {
+    control->roll = 0;
+    control->pitch = 0;
+    control->yaw = 0;
+  } else {
+    attitudeControllerCorrectRatePID(gyro->x, -gyro->y, gyro->z,
+                             desired.roll, desired.pitch, desired.yaw);
+
+    attitudeControllerGetActuatorOutput(&control->roll,
+                                        &control->pitch,
+                                        &control->yaw);
+
+    control->yaw = -control->yaw;
+    scaleRateOutput(control, &scale);
+  }
+}
+
 /**
  * Logging variables for the command and reference signals for the
  * altitude PID controller
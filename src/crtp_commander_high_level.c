@@ -47,16 +47,19 @@ such as: take-off, landing, polynomial trajectories.
 
 /* ZEPHYR RTOS includes */
 #include <zephyr\kernel.h>
+#include <zephyr/timing/timing.h>
 
 #include "crtp.h"
 #include "crtp_commander_high_level.h"
 #include "config.h"
 #include "planner.h"
 #include "param.h"
+#include "log.h"
 #include "mem.h"
 #include "commander.h"
 #include "stabilizer_types.h"
 #include "stabilizer.h"
+#include "crc32.h"
 
 // Local types
 enum TrajectoryLocation_e {
@@ -82,12 +85,21 @@ struct trajectoryDescription
 // 4k allows us to store 31 poly4d pieces
 // other (compressed) formats might be added in the future
 #define TRAJECTORY_MEMORY_SIZE 4096
+#define TRAJECTORY_MAX_PIECES (TRAJECTORY_MEMORY_SIZE / sizeof(struct poly4d))
+
+// Trajectories are uploaded into the inactive memory bank while a trajectory
+// may be flying from the active one. Defining a trajectory makes the uploaded
+// bank the active one.
+#define TRAJECTORY_MEMORY_BANKS 2
 
 #define ALL_GROUPS 0
 
 // Global variables
-uint8_t trajectories_memory[TRAJECTORY_MEMORY_SIZE];
+static uint8_t trajectories_memory[TRAJECTORY_MEMORY_BANKS][TRAJECTORY_MEMORY_SIZE];
+static uint8_t activeBank;
 static struct trajectoryDescription trajectory_descriptions[NUM_TRAJECTORY_DEFINITIONS];
+// derivative bounds of each uncompressed trajectory, computed when it is defined
+static struct piecewise_bounds trajectory_bounds[NUM_TRAJECTORY_DEFINITIONS];
 
 // Static structs are zero-initialized, so nullSetpoint corresponds to
 // modeDisable for all stab_mode_t members and zero for all physical values.
@@ -101,11 +113,79 @@ static struct vec pos; // last known setpoint (position [m])
 static struct vec vel; // last known setpoint (velocity [m/s])
 static float yaw; // last known setpoint yaw (yaw [rad])
 static struct piecewise_traj trajectory;
+// start time of each piece of each uncompressed trajectory, see
+// piecewise_prepare(). Computed when the trajectory is defined, so that
+// starting it does not depend on its length. Each definition has two tables,
+// so that it can be defined again while the planner still flies the old one.
+static float trajectory_piece_start[NUM_TRAJECTORY_DEFINITIONS][2][TRAJECTORY_MAX_PIECES + 1];
+static uint8_t trajectory_piece_start_index[NUM_TRAJECTORY_DEFINITIONS];
+#ifdef PPTRAJ_FIXED_POINT
+// fixed point copy of each memory bank, see piecewise_prepare_fixed(). The
+// pieces of a trajectory are converted when it is defined, if its offset is a
+// multiple of sizeof(struct poly4d). Other trajectories are evaluated in float.
+static struct poly4d_fixed trajectory_fixed[TRAJECTORY_MEMORY_BANKS][TRAJECTORY_MAX_PIECES];
+#endif
 static struct piecewise_traj_compressed  compressed_trajectory;
+// worst-case time spent decoding a compressed trajectory piece ahead of time
+static uint32_t compressedDecodeMaxUs;
+
+// waypoints queued for the on-board minimum snap planner, see COMMAND_GO_TO_WAYPOINTS
+static struct vec waypoints[PIECEWISE_MIN_SNAP_MAX_PIECES];
+static float waypointYaws[PIECEWISE_MIN_SNAP_MAX_PIECES];
+static float waypointDurations[PIECEWISE_MIN_SNAP_MAX_PIECES];
+static uint8_t waypointCount;
+// time spent in the last on-board minimum snap solve
+static uint32_t planSolveUs;
 
 // makes sure that we don't evaluate the trajectory while it is being changed
 struct k_mutex lockTraj;
 
+// The planner works with float times in seconds. To keep their resolution
+// independent of the uptime, they are relative to plannerEpochUs, which is
+// moved to the present whenever a new plan is started, see rebasePlannerClock().
+static int64_t plannerEpochUs;
+// offset of the swarm-wide clock to the local clock (us). Set from the radio
+// link thread, so it is guarded by a spinlock rather than lockTraj.
+static struct k_spinlock swarmTimeLock;
+static int64_t swarmTimeOffsetUs;
+// the offset split into 32 bit halves for logging
+static uint32_t swarmTimeOffsetLowUs;
+static int32_t swarmTimeOffsetHighUs;
+
+// state of the upload to the inactive trajectory memory bank
+static struct k_mutex lockUpload;
+static bool uploadInProgress;
+static uint32_t uploadStart; // lowest address written since the last bank flip
+static uint32_t uploadEnd;   // one past the highest address written since the last bank flip
+static uint32_t uploadStartTime;
+
+// upload statistics
+static uint32_t uploadBytes;     // total number of bytes written to trajectory memory
+static uint32_t uploadRate;      // throughput of the last completed upload (bytes/s)
+static uint32_t uploadCrcErrors; // number of uploads rejected because of a CRC mismatch
+
+
+// envelope uploaded trajectories are verified against, zero disables a check.
+// All checks are off until a limit is set, so every upload the planner took
+// before is still accepted.
+static struct piecewise_limits trajectoryLimits;
+// time spent verifying the last defined trajectory
+static uint32_t verifyUs;
+// result of the last trajectory verification, one of piecewise_verify_result
+static uint8_t verifyResult;
+
+// on-target benchmark of the trajectory evaluation, see runBenchmark()
+#define BENCHMARK_EVALS 1000
+static uint8_t benchmarkRequest; // id + 1 of the trajectory to benchmark, 0 if none
+static uint32_t benchmarkAvgNs;
+static uint32_t benchmarkMaxNs;
+static uint32_t benchmarkMismatches;
+#ifdef PPTRAJ_FIXED_POINT
+static uint32_t benchmarkFixedAvgNs;
+static uint32_t benchmarkFixedMaxNs;
+#endif
+static float benchmark_piece_start[TRAJECTORY_MAX_PIECES + 1];
+static struct piecewise_traj_compressed benchmark_compressed;
 
 // safe default settings for takeoff and landing velocity
 static float defaultTakeoffVelocity = 0.5f;
@@ -122,6 +202,10 @@ static const MemoryHandlerDef_t memDef = {
   .write = handleMemWrite,
 };
 
+// The task wakes up at least this often to decode the next piece of a compressed
+// trajectory before the control loop needs it
+#define PREFETCH_PERIOD_MS (1000 / RATE_HL_COMMANDER)
+
 K_THREAD_STACK_DEFINE(crtpCommanderHighLevelTaskStack, CMD_HIGH_LEVEL_TASK_STACKSIZE);
 struct k_thread crtpCommanderHighLevelTaskThread;
 
@@ -142,6 +226,12 @@ enum TrajectoryCommand_e {
   COMMAND_LAND_2                  = 8,
   COMMAND_TAKEOFF_WITH_VELOCITY   = 9,
   COMMAND_LAND_WITH_VELOCITY      = 10,
+  COMMAND_DEFINE_TRAJECTORY_CRC   = 11,
+  COMMAND_ADD_WAYPOINT            = 12,
+  COMMAND_GO_TO_WAYPOINTS         = 13,
+  COMMAND_SET_SWARM_TIME          = 14,
+  COMMAND_QUEUE                   = 15,
+  COMMAND_SCHEDULE                = 16,
 };
 
 struct data_set_group_mask {
@@ -220,6 +310,29 @@ struct data_go_to {
   float duration; // sec
 } __attribute__((packed));
 
+// appends a waypoint to the list flown by COMMAND_GO_TO_WAYPOINTS
+struct data_add_waypoint {
+  uint8_t groupMask; // mask for which CFs this should apply to
+  uint8_t clear;     // set to true, to discard previously added waypoints first
+  float x; // m
+  float y; // m
+  float z; // m
+  float yaw; // rad
+  float duration; // sec (time it should take to fly from the previous waypoint to this one)
+} __attribute__((packed));
+
+// "fly a minimum snap trajectory through the added waypoints, then hover at the last one"
+struct data_go_to_waypoints {
+  uint8_t groupMask; // mask for which CFs this should apply to
+  uint8_t relative;  // set to true, if positions/yaws are relative to current setpoint
+} __attribute__((packed));
+
+// sets the swarm-wide clock, which is shared by all CFs of a swarm
+struct data_set_swarm_time {
+  uint8_t groupMask;    // mask for which CFs this should apply to
+  uint64_t swarmTimeUs; // us (current swarm time)
+} __attribute__((packed));
+
 // starts executing a specified trajectory
 struct data_start_trajectory {
   uint8_t groupMask; // mask for which CFs this should apply to
@@ -235,8 +348,58 @@ struct data_define_trajectory {
   struct trajectoryDescription description;
 } __attribute__((packed));
 
+// same as data_define_trajectory, but the uploaded memory only becomes active
+// if its CRC matches (EIO otherwise). Rejected with EINVAL if nothing was
+// uploaded since the last define.
+struct data_define_trajectory_crc {
+  uint8_t trajectoryId;
+  struct trajectoryDescription description;
+  uint32_t crc32; // CRC32 of the memory range written since the last define
+} __attribute__((packed));
+
+// appends a go_to, start_trajectory or land command to the queue. A queued
+// command starts exactly when the trajectory before it ends, from its final
+// state, without a round trip to the ground.
+struct data_queue {
+  uint8_t command; // one of COMMAND_GO_TO, COMMAND_START_TRAJECTORY, COMMAND_LAND_2
+  union {
+    struct data_go_to goTo;
+    struct data_start_trajectory startTrajectory;
+    struct data_land_2 land;
+  };
+} __attribute__((packed));
+
+// starts a go_to, start_trajectory or land command at a given time of the
+// swarm-wide clock, so that all CFs of a group start it at the same instant
+// no matter when they received it
+struct data_schedule {
+  uint32_t startTimeUs; // lower 32 bits of the swarm time (us) at which the command starts
+  struct data_queue command;
+} __attribute__((packed));
+
+// commands waiting for the current trajectory to end, see COMMAND_QUEUE
+#define QUEUE_LENGTH 8
+static struct data_queue queue[QUEUE_LENGTH];
+static uint8_t queueHead;
+static uint8_t queueLength;
+// number of queued commands that could not be started
+static uint32_t queueErrors;
+
+// commands waiting for their start time, see COMMAND_SCHEDULE
+#define SCHEDULE_LENGTH 4
+struct scheduledCommand {
+  bool valid;
+  int64_t startTimeUs; // swarm time (us)
+  struct data_queue command;
+};
+static struct scheduledCommand schedule[SCHEDULE_LENGTH];
+
 // Private functions
 static void crtpCommanderHighLevelTask(void * prm);
+static void prefetchCompressedTrajectory(void);
+static void runBenchmark(void);
+static bool chainQueuedCommand(float t);
+static void startScheduledCommands(void);
 
 static int set_group_mask(const struct data_set_group_mask* data);
 static int takeoff(const struct data_takeoff* data);
@@ -247,10 +410,75 @@ static int takeoff_with_velocity(const struct data_takeoff_with_velocity* data);
 static int land_with_velocity(const struct data_land_with_velocity* data);
 static int stop(const struct data_stop* data);
 static int go_to(const struct data_go_to* data);
+static int add_waypoint(const struct data_add_waypoint* data);
+static int go_to_waypoints(const struct data_go_to_waypoints* data);
+static int set_swarm_time(const struct data_set_swarm_time* data);
+static int queue_command(const struct data_queue* data);
+static int schedule_command(const struct data_schedule* data);
 static int start_trajectory(const struct data_start_trajectory* data);
 static int define_trajectory(const struct data_define_trajectory* data);
+static int define_trajectory_crc(const struct data_define_trajectory_crc* data);
 
 // Helper functions
+static int64_t localTimeUs(void)
+{
+  return k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+static int64_t getSwarmTimeOffset(void)
+{
+  k_spinlock_key_t key = k_spin_lock(&swarmTimeLock);
+  int64_t offset = swarmTimeOffsetUs;
+  k_spin_unlock(&swarmTimeLock, key);
+  return offset;
+}
+
+static void setSwarmTimeOffset(int64_t offset)
+{
+  k_spinlock_key_t key = k_spin_lock(&swarmTimeLock);
+  swarmTimeOffsetUs = offset;
+  swarmTimeOffsetLowUs = (uint32_t)offset;
+  swarmTimeOffsetHighUs = (int32_t)(offset >> 32);
+  k_spin_unlock(&swarmTimeLock, key);
+}
+
+// current planner time (s)
+static float plannerTime(void)
+{
+  return (localTimeUs() - plannerEpochUs) / 1e6f;
+}
+
+// Moves the planner epoch to the present and shifts the active trajectory
+// accordingly. Must be called with lockTraj held. Returns the current planner
+// time, which is zero.
+static float rebasePlannerClock(void)
+{
+  int64_t now = localTimeUs();
+  plan_shift_time(&planner, (now - plannerEpochUs) / 1e6f);
+  plannerEpochUs = now;
+  return 0.0f;
+}
+
+// Commands that are not queued take over the planner right away. Must be
+// called with lockTraj held. Returns the current planner time.
+static float beginImmediatePlan(void)
+{
+  // only plan_go_to_waypoints_from() prepares the planned trajectory, the
+  // other planners overwrite its pieces and must not see the stale table
+  piecewise_unprepare(&planner.planned_trajectory);
+  return rebasePlannerClock();
+}
+
+// Discards the queue once an immediate command has been accepted. The planners
+// check a command before they change the plan, so a rejected one leaves the
+// plan and the queue as they were. Must be called with lockTraj held.
+static void acceptImmediatePlan(int result)
+{
+  if (result == 0) {
+    queueLength = 0;
+  }
+}
+
 static struct vec state2vec(struct vec3_s v)
 {
   return mkvec(v.x, v.y, v.z);
@@ -277,6 +505,9 @@ void crtpCommanderHighLevelInit(void)
                                  CMD_HIGH_LEVEL_TASK_PRI, 0, K_NO_WAIT);
 
   k_mutex_init(&lockTraj);
+  k_mutex_init(&lockUpload);
+  timing_init();
+  plannerEpochUs = localTimeUs();
 
 
   pos = vzero();
@@ -302,7 +533,11 @@ void crtpCommanderHighLevelTellState(const state_t *state)
 
 int crtpCommanderHighLevelDisable()
 {
+  k_mutex_lock(&lockTraj, K_FOREVER);
+  queueLength = 0;
+  memset(schedule, 0, sizeof(schedule));
   plan_disable(&planner);
+  k_mutex_unlock(&lockTraj);
   return 0;
 }
 
@@ -313,7 +548,11 @@ bool crtpCommanderHighLevelGetSetpoint(setpoint_t* setpoint, const state_t *stat
   }
 
   k_mutex_lock(&lockTraj, K_FOREVER);
-  float t = k_uptime_get() / 1e6; /* LOOK INTO THIS CODE WHAT TO REPLACE IN PLACE 1E6*/
+  startScheduledCommands();
+  float t = plannerTime();
+  if (chainQueuedCommand(t)) {
+    t = plannerTime();
+  }
   struct traj_eval ev = plan_current_goal(&planner, t);
   k_mutex_unlock(&lockTraj);
 
@@ -403,12 +642,30 @@ static int handleCommand(const enum TrajectoryCommand_e command, const uint8_t*
     case COMMAND_GO_TO:
       ret = go_to((const struct data_go_to*)data);
       break;
+    case COMMAND_ADD_WAYPOINT:
+      ret = add_waypoint((const struct data_add_waypoint*)data);
+      break;
+    case COMMAND_GO_TO_WAYPOINTS:
+      ret = go_to_waypoints((const struct data_go_to_waypoints*)data);
+      break;
+    case COMMAND_SET_SWARM_TIME:
+      ret = set_swarm_time((const struct data_set_swarm_time*)data);
+      break;
+    case COMMAND_QUEUE:
+      ret = queue_command((const struct data_queue*)data);
+      break;
+    case COMMAND_SCHEDULE:
+      ret = schedule_command((const struct data_schedule*)data);
+      break;
     case COMMAND_START_TRAJECTORY:
       ret = start_trajectory((const struct data_start_trajectory*)data);
       break;
     case COMMAND_DEFINE_TRAJECTORY:
       ret = define_trajectory((const struct data_define_trajectory*)data);
       break;
+    case COMMAND_DEFINE_TRAJECTORY_CRC:
+      ret = define_trajectory_crc((const struct data_define_trajectory_crc*)data);
+      break;
     default:
       ret = ENOEXEC;
       break;
@@ -423,15 +680,190 @@ void crtpCommanderHighLevelTask(void * prm)
   crtpInitTaskQueue(CRTP_PORT_SETPOINT_HL);
 
   while(1) {
-    crtpReceivePacketBlock(CRTP_PORT_SETPOINT_HL, &p);
+    if (crtpReceivePacketWait(CRTP_PORT_SETPOINT_HL, &p, PREFETCH_PERIOD_MS) == 0) {
+      int ret = handleCommand(p.data[0], &p.data[1]);
 
-    int ret = handleCommand(p.data[0], &p.data[1]);
+      //answer
+      p.data[3] = ret;
+      p.size = 4;
+      crtpSendPacketBlock(&p);
+    }
+
+    prefetchCompressedTrajectory();
+    runBenchmark();
+  }
+}
+
+// Decodes the next piece of the compressed trajectory being flown. The lock is
+// only held to copy the current piece and to publish the decoded one, so the
+// setpoint path never waits for a decode, and the task runs below the
+// stabilizer, so the decode does not delay the control loop either.
+static void prefetchCompressedTrajectory(void)
+{
+  static struct piecewise_traj_compressed_piece current;
+  static struct piecewise_traj_compressed_piece next;
+  bool needed = false;
+
+  k_mutex_lock(&lockTraj, K_FOREVER);
+  if (planner.type == TRAJECTORY_TYPE_PIECEWISE_COMPRESSED
+      && !plan_is_stopped(&planner) && !plan_is_disabled(&planner)
+      && !compressed_trajectory.next_piece_valid) {
+    current = compressed_trajectory.current_piece;
+    needed = true;
+  }
+  k_mutex_unlock(&lockTraj);
+
+  if (!needed) {
+    return;
+  }
+
+  uint32_t start = k_cycle_get_32();
+  if (!piecewise_compressed_decode_next(&current, &next)) {
+    return;
+  }
+  uint32_t us = k_cyc_to_us_ceil32(k_cycle_get_32() - start);
+
+  k_mutex_lock(&lockTraj, K_FOREVER);
+  bool published = piecewise_compressed_publish_next(&compressed_trajectory, &current, &next);
+  k_mutex_unlock(&lockTraj);
+
+  if (published && us > compressedDecodeMaxUs) {
+    compressedDecodeMaxUs = us;
+  }
+}
+
+// xorshift32, reproducible random numbers for the benchmark
+static uint32_t benchmarkRandom(uint32_t* state)
+{
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+static bool evalsMatch(const struct traj_eval* a, const struct traj_eval* b)
+{
+  return vdist2(a->pos, b->pos) < 1e-6f && fabsf(a->yaw - b->yaw) < 1e-3f;
+}
 
-    //answer
-    p.data[3] = ret;
-    p.size = 4;
-    crtpSendPacketBlock(&p);
+// Times BENCHMARK_EVALS evaluations at random times, of benchmark_compressed
+// if compressed is true and of traj otherwise. Returns the average time and
+// sets maxNs to the worst-case time per evaluation (ns).
+static uint32_t timeEvaluations(struct piecewise_traj* traj, bool compressed, float duration, uint32_t* maxNs)
+{
+  uint32_t seed = 0x12345678;
+  uint64_t totalNs = 0;
+  *maxNs = 0;
+  for (int i = 0; i < BENCHMARK_EVALS; ++i) {
+    float t = duration * (benchmarkRandom(&seed) >> 8) / (float)(1 << 24);
+
+    timing_t start = timing_counter_get();
+    if (compressed) {
+      piecewise_compressed_eval(&benchmark_compressed, t);
+    } else {
+      piecewise_eval(traj, t);
+    }
+    timing_t end = timing_counter_get();
+    uint32_t ns = timing_cycles_to_ns(timing_cycles_get(&start, &end));
+    totalNs += ns;
+    *maxNs = MAX(*maxNs, ns);
+  }
+  return totalNs / BENCHMARK_EVALS;
+}
+
+// Counts the random times at which the forward, reversed or time-scaled
+// evaluation of traj does not match the forward evaluation of reference.
+static uint32_t countMismatches(struct piecewise_traj* traj, struct piecewise_traj* reference, float duration)
+{
+  uint32_t seed = 0x12345678;
+  uint32_t mismatches = 0;
+  for (int i = 0; i < BENCHMARK_EVALS; ++i) {
+    float t = duration * (benchmarkRandom(&seed) >> 8) / (float)(1 << 24);
+    struct traj_eval ev = piecewise_eval(reference, t);
+    struct traj_eval evForward = piecewise_eval(traj, t);
+    struct traj_eval evReversed = piecewise_eval_reversed(traj, duration - t);
+    traj->timescale = 2.0f;
+    struct traj_eval evScaled = piecewise_eval(traj, 2.0f * t);
+    traj->timescale = 1.0f;
+    if (!evalsMatch(&ev, &evForward) || !evalsMatch(&ev, &evReversed) || !evalsMatch(&ev, &evScaled)) {
+      mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+// Evaluates a defined trajectory at BENCHMARK_EVALS random times and logs the
+// average and worst-case time per evaluation. Uncompressed trajectories are
+// also evaluated reversed and time-scaled, and each result is checked against
+// the forward evaluation at the corresponding time. With PPTRAJ_FIXED_POINT,
+// the fixed point copy of an uncompressed trajectory is timed and checked the
+// same way. Only runs while the planner is stopped, as it keeps the CPU busy
+// for a while.
+static void runBenchmark(void)
+{
+  if (benchmarkRequest == 0) {
+    return;
+  }
+  uint8_t trajectoryId = benchmarkRequest - 1;
+  benchmarkRequest = 0;
+
+  benchmarkAvgNs = 0;
+  benchmarkMaxNs = 0;
+  benchmarkMismatches = 0;
+#ifdef PPTRAJ_FIXED_POINT
+  benchmarkFixedAvgNs = 0;
+  benchmarkFixedMaxNs = 0;
+#endif
+  if (trajectoryId >= NUM_TRAJECTORY_DEFINITIONS || !plan_is_stopped(&planner)) {
+    return;
   }
+
+  const struct trajectoryDescription* trajDesc = &trajectory_descriptions[trajectoryId];
+  if (trajDesc->trajectoryLocation != TRAJECTORY_LOCATION_MEM) {
+    return;
+  }
+  uint32_t offset = trajDesc->trajectoryIdentifier.mem.offset;
+  uint8_t n_pieces = trajDesc->trajectoryIdentifier.mem.n_pieces;
+  const uint8_t* data = &trajectories_memory[activeBank][offset];
+  bool compressed = trajDesc->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D_COMPRESSED;
+
+  struct piecewise_traj traj = {
+    .timescale = 1.0f,
+    .n_pieces = n_pieces,
+    .pieces = (struct poly4d*)data,
+  };
+  float duration;
+  if (compressed) {
+    if (offset >= TRAJECTORY_MEMORY_SIZE || !piecewise_compressed_validate(data, TRAJECTORY_MEMORY_SIZE - offset)) {
+      return;
+    }
+    piecewise_compressed_load(&benchmark_compressed, data);
+    duration = piecewise_compressed_duration(&benchmark_compressed);
+  } else {
+    if (n_pieces == 0 || offset + n_pieces * sizeof(struct poly4d) > TRAJECTORY_MEMORY_SIZE) {
+      return;
+    }
+    piecewise_prepare(&traj, benchmark_piece_start);
+    duration = piecewise_duration(&traj);
+  }
+
+  timing_start();
+  benchmarkAvgNs = timeEvaluations(&traj, compressed, duration, &benchmarkMaxNs);
+  if (!compressed) {
+    benchmarkMismatches = countMismatches(&traj, &traj, duration);
+  }
+#ifdef PPTRAJ_FIXED_POINT
+  // the fixed point copy was converted when the trajectory was defined
+  if (!compressed && offset % sizeof(struct poly4d) == 0) {
+    struct piecewise_traj fixedTraj = traj;
+    fixedTraj.fixed_pieces = &trajectory_fixed[activeBank][offset / sizeof(struct poly4d)];
+    benchmarkFixedAvgNs = timeEvaluations(&fixedTraj, false, duration, &benchmarkFixedMaxNs);
+    benchmarkMismatches += countMismatches(&fixedTraj, &traj, duration);
+  }
+#endif
+  timing_stop();
 }
 
 int set_group_mask(const struct data_set_group_mask* data)
@@ -446,8 +878,9 @@ int takeoff(const struct data_takeoff* data)
   int result = 0;
   if (isInGroup(data->groupMask)) {
     k_mutex_lock(&lockTraj, K_FOREVER);
-    float t = k_uptime_get() / 1e6;
+    float t = beginImmediatePlan();
     result = plan_takeoff(&planner, pos, yaw, data->height, 0.0f, data->duration, t);
+    acceptImmediatePlan(result);
     k_mutex_unlock(&lockTraj);
   }
   return result;
@@ -458,7 +891,7 @@ int takeoff2(const struct data_takeoff_2* data)
   int result = 0;
   if (isInGroup(data->groupMask)) {
     k_mutex_lock(&lockTraj, K_FOREVER);
-    float t = k_uptime_get() / 1e6;
+    float t = beginImmediatePlan();
 
     float hover_yaw = data->yaw;
     if (data->useCurrentYaw) {
@@ -466,6 +899,7 @@ int takeoff2(const struct data_takeoff_2* data)
     }
 
     result = plan_takeoff(&planner, pos, yaw, data->height, hover_yaw, data->duration, t);
+    acceptImmediatePlan(result);
     k_mutex_unlock(&lockTraj);
   }
   return result;
@@ -476,7 +910,7 @@ int takeoff_with_velocity(const struct data_takeoff_with_velocity* data)
   int result = 0;
   if (isInGroup(data->groupMask)) {
     k_mutex_lock(&lockTraj, K_FOREVER);
-    float t = k_uptime_get() / 1e6;
+    float t = beginImmediatePlan();
 
     float hover_yaw = data->yaw;
     if (data->useCurrentYaw) {
@@ -491,6 +925,7 @@ int takeoff_with_velocity(const struct data_takeoff_with_velocity* data)
     float velocity = data->velocity > 0 ? data->velocity : defaultTakeoffVelocity;
     float duration = fabsf(height - pos.z) / velocity;
     result = plan_takeoff(&planner, pos, yaw, height, hover_yaw, duration, t);
+    acceptImmediatePlan(result);
     k_mutex_unlock(&lockTraj);
   }
   return result;
@@ -501,8 +936,9 @@ int land(const struct data_land* data)
   int result = 0;
   if (isInGroup(data->groupMask)) {
     k_mutex_lock(&lockTraj, K_FOREVER);
-    float t = k_uptime_get() / 1e6;
+    float t = beginImmediatePlan();
     result = plan_land(&planner, pos, yaw, data->height, 0.0f, data->duration, t);
+    acceptImmediatePlan(result);
     k_mutex_unlock(&lockTraj);
   }
   return result;
@@ -513,7 +949,7 @@ int land2(const struct data_land_2* data)
   int result = 0;
   if (isInGroup(data->groupMask)) {
     k_mutex_lock(&lockTraj, K_FOREVER);
-    float t = k_uptime_get() / 1e6;
+    float t = beginImmediatePlan();
 
     float hover_yaw = data->yaw;
     if (data->useCurrentYaw) {
@@ -521,6 +957,7 @@ int land2(const struct data_land_2* data)
     }
 
     result = plan_land(&planner, pos, yaw, data->height, hover_yaw, data->duration, t);
+    acceptImmediatePlan(result);
     k_mutex_unlock(&lockTraj);
   }
   return result;
@@ -531,7 +968,7 @@ int land_with_velocity(const struct data_land_with_velocity* data)
   int result = 0;
   if (isInGroup(data->groupMask)) {
     k_mutex_lock(&lockTraj, K_FOREVER);
-    float t = k_uptime_get() / 1e6;
+    float t = beginImmediatePlan();
 
     float hover_yaw = data->yaw;
     if (data->useCurrentYaw) {
@@ -546,6 +983,7 @@ int land_with_velocity(const struct data_land_with_velocity* data)
     float velocity = data->velocity > 0 ? data->velocity : defaultLandingVelocity;
     float duration = fabsf(height - pos.z) / velocity;
     result = plan_land(&planner, pos, yaw, height, hover_yaw, duration, t);
+    acceptImmediatePlan(result);
     k_mutex_unlock(&lockTraj);
   }
   return result;
@@ -556,6 +994,8 @@ int stop(const struct data_stop* data)
   int result = 0;
   if (isInGroup(data->groupMask)) {
     k_mutex_lock(&lockTraj, K_FOREVER);
+    queueLength = 0;
+    memset(schedule, 0, sizeof(schedule));
     plan_stop(&planner);
     k_mutex_unlock(&lockTraj);
   }
@@ -574,7 +1014,7 @@ int go_to(const struct data_go_to* data)
   if (isInGroup(data->groupMask)) {
     struct vec hover_pos = mkvec(data->x, data->y, data->z);
     k_mutex_lock(&lockTraj, K_FOREVER);
-    float t = k_uptime_get() / 1e6;
+    float t = beginImmediatePlan();
     if (plan_is_disabled(&planner) || plan_is_stopped(&planner)) {
       ev.pos = pos;
       ev.vel = vel;
@@ -584,47 +1024,524 @@ int go_to(const struct data_go_to* data)
     else {
       result = plan_go_to(&planner, data->relative, hover_pos, data->yaw, data->duration, t);
     }
+    acceptImmediatePlan(result);
     k_mutex_unlock(&lockTraj);
   }
   return result;
 }
 
+int add_waypoint(const struct data_add_waypoint* data)
+{
+  int result = 0;
+  if (isInGroup(data->groupMask)) {
+    if (data->clear) {
+      waypointCount = 0;
+    }
+    if (waypointCount >= PIECEWISE_MIN_SNAP_MAX_PIECES || !(data->duration > 0.0f)) {
+      return ENOEXEC;
+    }
+    waypoints[waypointCount] = mkvec(data->x, data->y, data->z);
+    waypointYaws[waypointCount] = data->yaw;
+    waypointDurations[waypointCount] = data->duration;
+    ++waypointCount;
+  }
+  return result;
+}
+
+int go_to_waypoints(const struct data_go_to_waypoints* data)
+{
+  static struct traj_eval ev = {
+    // pos, vel, yaw will be filled before using
+    .acc = {0.0f, 0.0f, 0.0f},
+    .omega = {0.0f, 0.0f, 0.0f},
+  };
+
+  int result = 0;
+  if (isInGroup(data->groupMask)) {
+    if (waypointCount == 0) {
+      return ENOEXEC;
+    }
+    k_mutex_lock(&lockTraj, K_FOREVER);
+    float t = beginImmediatePlan();
+    struct traj_eval curr;
+    if (plan_is_disabled(&planner) || plan_is_stopped(&planner)) {
+      ev.pos = pos;
+      ev.vel = vel;
+      ev.yaw = yaw;
+      curr = ev;
+    }
+    else {
+      curr = plan_current_goal(&planner, t);
+    }
+    uint32_t start = k_cycle_get_32();
+    result = plan_go_to_waypoints_from(&planner, &curr, data->relative,
+      waypointCount, waypoints, waypointYaws, waypointDurations, t);
+    planSolveUs = k_cyc_to_us_ceil32(k_cycle_get_32() - start);
+    acceptImmediatePlan(result);
+    k_mutex_unlock(&lockTraj);
+    if (result != 0) {
+      result = ENOEXEC;
+    }
+  }
+  return result;
+}
+
+int set_swarm_time(const struct data_set_swarm_time* data)
+{
+  if (isInGroup(data->groupMask)) {
+    setSwarmTimeOffset((int64_t)data->swarmTimeUs - localTimeUs());
+  }
+  return 0;
+}
+
+// Maps the result of a trajectory verification to the error code of a command
+static int verifyResultToError(enum piecewise_verify_result result)
+{
+  verifyResult = result;
+  switch (result) {
+    case PIECEWISE_FEASIBLE:
+      return 0;
+    case PIECEWISE_DISCONTINUOUS:
+      return EDOM;
+    default:
+      return ERANGE;
+  }
+}
+
+// Checks if a trajectory can be started with the given timescale and
+// direction. The trajectory was verified and prepared when it was defined, so
+// this does not depend on its length. Must be called with lockTraj held.
+static int checkStartTrajectory(const struct data_start_trajectory* data)
+{
+  if (data->trajectoryId >= NUM_TRAJECTORY_DEFINITIONS) {
+    return ENOEXEC;
+  }
+
+  const struct trajectoryDescription* trajDesc = &trajectory_descriptions[data->trajectoryId];
+  if (trajDesc->trajectoryLocation != TRAJECTORY_LOCATION_MEM) {
+    return 0;
+  }
+  if (trajDesc->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D) {
+    // the bounds were computed at define time, only the timescale is new
+    return verifyResultToError(piecewise_check_bounds(&trajectory_bounds[data->trajectoryId], data->timescale, &trajectoryLimits));
+  }
+  if (trajDesc->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D_COMPRESSED
+      && (data->timescale != 1 || data->reversed)) {
+    return ENOEXEC;
+  }
+  return 0;
+}
+
+// Starts a trajectory at time t. If the trajectory is relative, it is shifted
+// to start_from. Must be called with lockTraj held.
+static int startTrajectoryAt(const struct data_start_trajectory* data, float t, struct vec start_from)
+{
+  int result = checkStartTrajectory(data);
+  if (result != 0) {
+    return result;
+  }
+
+  struct trajectoryDescription* trajDesc = &trajectory_descriptions[data->trajectoryId];
+  uint32_t offset = trajDesc->trajectoryIdentifier.mem.offset;
+  if (   trajDesc->trajectoryLocation == TRAJECTORY_LOCATION_MEM
+      && trajDesc->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D) {
+    trajectory.t_begin = t;
+    trajectory.timescale = data->timescale;
+    trajectory.n_pieces = trajDesc->trajectoryIdentifier.mem.n_pieces;
+    trajectory.pieces = (struct poly4d*)&trajectories_memory[activeBank][offset];
+    trajectory.piece_start = trajectory_piece_start[data->trajectoryId][trajectory_piece_start_index[data->trajectoryId]];
+    trajectory.cursor = 0;
+#ifdef PPTRAJ_FIXED_POINT
+    trajectory.fixed_pieces = (offset % sizeof(struct poly4d) == 0)
+      ? &trajectory_fixed[activeBank][offset / sizeof(struct poly4d)] : NULL;
+#endif
+    result = plan_start_trajectory(&planner, &trajectory, data->reversed, data->relative, start_from);
+  } else if (trajDesc->trajectoryLocation == TRAJECTORY_LOCATION_MEM
+      && trajDesc->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D_COMPRESSED) {
+    piecewise_compressed_load(
+      &compressed_trajectory,
+      &trajectories_memory[activeBank][offset]
+    );
+    compressed_trajectory.t_begin = t;
+    result = plan_start_compressed_trajectory(&planner, &compressed_trajectory, data->relative, start_from);
+  }
+  return result;
+}
+
 int start_trajectory(const struct data_start_trajectory* data)
 {
   int result = 0;
   if (isInGroup(data->groupMask)) {
-    if (data->trajectoryId < NUM_TRAJECTORY_DEFINITIONS) {
-      struct trajectoryDescription* trajDesc = &trajectory_descriptions[data->trajectoryId];
-      if (   trajDesc->trajectoryLocation == TRAJECTORY_LOCATION_MEM
-          && trajDesc->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D) {
+    k_mutex_lock(&lockTraj, K_FOREVER);
+    float t = beginImmediatePlan();
+    result = startTrajectoryAt(data, t, pos);
+    acceptImmediatePlan(result);
+    k_mutex_unlock(&lockTraj);
+  }
+  return result;
+}
+
+// Starts a queued or scheduled command at time t, continuing from ev, the
+// final state of the trajectory before it. Must be called with lockTraj held.
+static int startQueuedCommand(const struct data_queue* data, const struct traj_eval* ev, float t)
+{
+  int result = ENOEXEC;
+  piecewise_unprepare(&planner.planned_trajectory);
+  switch (data->command) {
+    case COMMAND_GO_TO:
+      result = plan_go_to_from(&planner, ev, data->goTo.relative,
+        mkvec(data->goTo.x, data->goTo.y, data->goTo.z), data->goTo.yaw, data->goTo.duration, t);
+      break;
+    case COMMAND_START_TRAJECTORY:
+      result = startTrajectoryAt(&data->startTrajectory, t, ev->pos);
+      break;
+    case COMMAND_LAND_2:
+      result = plan_land_from(&planner, ev, data->land.height,
+        data->land.useCurrentYaw ? ev->yaw : data->land.yaw, data->land.duration, t);
+      break;
+    default:
+      break;
+  }
+
+  if (result != 0) {
+    queueErrors++;
+  }
+  return result;
+}
+
+// Starts the next queued command if the current trajectory has ended at time
+// t. The command starts exactly at the end of the trajectory and from its
+// final state, so that position, velocity and acceleration stay continuous.
+// Must be called with lockTraj held. Returns true if a command was started,
+// which rebases the planner clock.
+static bool chainQueuedCommand(float t)
+{
+  if (queueLength == 0 || planner.state != TRAJECTORY_STATE_FLYING || !plan_is_finished(&planner, t)) {
+    return false;
+  }
+
+  rebasePlannerClock();
+  float t_end = plan_end_time(&planner);
+  // evaluate just before the end, where velocity and acceleration are not zeroed yet
+  struct traj_eval ev = plan_current_goal(&planner, t_end - 1e-5f);
+
+  const struct data_queue* data = &queue[queueHead];
+  queueHead = (queueHead + 1) % QUEUE_LENGTH;
+  queueLength--;
+  if (startQueuedCommand(data, &ev, t_end) != 0) {
+    // the rest of the queue was meant to continue from this command
+    queueLength = 0;
+  }
+  return true;
+}
+
+// Gets the group mask of a command that can be queued or scheduled. Returns
+// false if the command cannot be queued.
+static bool queuedCommandGroupMask(const struct data_queue* data, uint8_t* groupMask)
+{
+  switch (data->command) {
+    case COMMAND_GO_TO:
+      *groupMask = data->goTo.groupMask;
+      return true;
+    case COMMAND_START_TRAJECTORY:
+      *groupMask = data->startTrajectory.groupMask;
+      return true;
+    case COMMAND_LAND_2:
+      *groupMask = data->land.groupMask;
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Checks a command before it is queued or scheduled, so that starting it
+// later only has to plan. Must be called with lockTraj held.
+static int checkQueuedCommand(const struct data_queue* data)
+{
+  if (data->command == COMMAND_START_TRAJECTORY) {
+    return checkStartTrajectory(&data->startTrajectory);
+  }
+  return 0;
+}
+
+int queue_command(const struct data_queue* data)
+{
+  uint8_t groupMask;
+  if (!queuedCommandGroupMask(data, &groupMask)) {
+    return ENOEXEC;
+  }
+
+  int result = 0;
+  if (isInGroup(groupMask)) {
+    k_mutex_lock(&lockTraj, K_FOREVER);
+    if (planner.state != TRAJECTORY_STATE_FLYING) {
+      // there is no trajectory to continue from
+      result = ENOEXEC;
+    } else {
+      // reject a command now rather than when the trajectory before it ends
+      result = checkQueuedCommand(data);
+    }
+
+    if (result == 0) {
+      if (queueLength == 0 && plan_is_finished(&planner, plannerTime())) {
+        // the current trajectory has already ended, start right away
+        float t = rebasePlannerClock();
+        struct traj_eval ev = plan_current_goal(&planner, t);
+        result = startQueuedCommand(data, &ev, t);
+      } else if (queueLength >= QUEUE_LENGTH) {
+        result = ENOMEM;
+      } else {
+        queue[(queueHead + queueLength) % QUEUE_LENGTH] = *data;
+        queueLength++;
+      }
+    }
+    k_mutex_unlock(&lockTraj);
+  }
+  return result;
+}
+
+int schedule_command(const struct data_schedule* data)
+{
+  uint8_t groupMask;
+  if (!queuedCommandGroupMask(&data->command, &groupMask)) {
+    return ENOEXEC;
+  }
+
+  int result = 0;
+  if (isInGroup(groupMask)) {
+    k_mutex_lock(&lockTraj, K_FOREVER);
+    // the start time is the next occurrence of its lower 32 bits, up to about 35 minutes ahead
+    int64_t now = localTimeUs() + getSwarmTimeOffset();
+    int32_t delay = (int32_t)(data->startTimeUs - (uint32_t)now);
+    result = checkQueuedCommand(&data->command);
+    if (result == 0) {
+      result = (delay < 0) ? ETIME : ENOMEM;
+    }
+    for (int i = 0; result == ENOMEM && i < SCHEDULE_LENGTH; ++i) {
+      if (!schedule[i].valid) {
+        schedule[i].valid = true;
+        schedule[i].startTimeUs = now + delay;
+        schedule[i].command = data->command;
+        result = 0;
+        break;
+      }
+    }
+    k_mutex_unlock(&lockTraj);
+  }
+  return result;
+}
+
+// Starts the scheduled commands whose start time has come. A command starts
+// exactly at its start time, which may be up to one setpoint period in the
+// past, so that all CFs follow the same trajectory at the same time. Must be
+// called with lockTraj held.
+static void startScheduledCommands(void)
+{
+  static struct traj_eval ev = {
+    // pos, vel, yaw will be filled before using
+    .acc = {0.0f, 0.0f, 0.0f},
+    .omega = {0.0f, 0.0f, 0.0f},
+  };
+
+  int64_t offset = getSwarmTimeOffset();
+  for (int i = 0; i < SCHEDULE_LENGTH; ++i) {
+    if (!schedule[i].valid) {
+      continue;
+    }
+    int64_t start = schedule[i].startTimeUs - offset;
+    if (start > localTimeUs()) {
+      continue;
+    }
+
+    schedule[i].valid = false;
+    beginImmediatePlan();
+    float t = (start - plannerEpochUs) / 1e6f;
+    struct traj_eval curr;
+    if (plan_is_disabled(&planner) || plan_is_stopped(&planner)) {
+      ev.pos = pos;
+      ev.vel = vel;
+      ev.yaw = yaw;
+      curr = ev;
+    }
+    else {
+      curr = plan_current_goal(&planner, t);
+    }
+    acceptImmediatePlan(startQueuedCommand(&schedule[i].command, &curr, t));
+  }
+}
+
+bool crtpCommanderHighLevelHandleTimeSync(const CRTPPacket* p)
+{
+  if (p->port != CRTP_PORT_SETPOINT_HL || p->size < 1 + sizeof(struct data_set_swarm_time)
+      || p->data[0] != COMMAND_SET_SWARM_TIME) {
+    return false;
+  }
+
+  // the local time is taken here, as close to the reception as possible
+  int64_t now = localTimeUs();
+  const struct data_set_swarm_time* data = (const struct data_set_swarm_time*)&p->data[1];
+  if (isInGroup(data->groupMask)) {
+    setSwarmTimeOffset((int64_t)data->swarmTimeUs - now);
+  }
+  return true;
+}
+
+// Returns true if the planner is following a trajectory stored in the given memory bank
+static bool isTrajectoryBankInUse(const uint8_t* bank)
+{
+  const uint8_t* data = NULL;
+
+  if (!plan_is_stopped(&planner) && !plan_is_disabled(&planner)) {
+    if (planner.type == TRAJECTORY_TYPE_PIECEWISE && planner.trajectory == &trajectory) {
+      data = (const uint8_t*)trajectory.pieces;
+    } else if (planner.type == TRAJECTORY_TYPE_PIECEWISE_COMPRESSED) {
+      data = compressed_trajectory.data;
+    }
+  }
+
+  return data >= bank && data < bank + TRAJECTORY_MEMORY_SIZE;
+}
+
+// Verifies a trajectory in the given bank and does the work that starting it
+// would otherwise depend on its length for: an uncompressed trajectory gets
+// its derivative bounds, checked against the envelope at timescale 1, its
+// piece start times and, if enabled, its fixed point copy. A compressed
+// trajectory is validated.
+static int prepareTrajectory(uint8_t bank, const struct trajectoryDescription* description, struct piecewise_bounds* bounds, float* pieceStart)
+{
+  if (description->trajectoryLocation != TRAJECTORY_LOCATION_MEM) {
+    return 0;
+  }
+
+  uint32_t offset = description->trajectoryIdentifier.mem.offset;
+  if (description->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D) {
+    uint8_t n_pieces = description->trajectoryIdentifier.mem.n_pieces;
+    if (n_pieces == 0 || offset + n_pieces * sizeof(struct poly4d) > TRAJECTORY_MEMORY_SIZE) {
+      return ENOEXEC;
+    }
+
+    struct piecewise_traj traj = {
+      .pieces = (struct poly4d*)&trajectories_memory[bank][offset],
+      .n_pieces = n_pieces,
+      .timescale = 1.0f,
+    };
+    uint32_t start = k_cycle_get_32();
+    piecewise_bounds(&traj, bounds);
+    verifyUs = k_cyc_to_us_ceil32(k_cycle_get_32() - start);
+
+    int result = verifyResultToError(piecewise_check_bounds(bounds, 1.0f, &trajectoryLimits));
+    if (result != 0) {
+      return result;
+    }
+
+    piecewise_prepare(&traj, pieceStart);
+#ifdef PPTRAJ_FIXED_POINT
+    // Converting the active bank again writes the same values over the pieces
+    // a running trajectory may be using.
+    if (offset % sizeof(struct poly4d) == 0) {
+      piecewise_prepare_fixed(&traj, &trajectory_fixed[bank][offset / sizeof(struct poly4d)]);
+    }
+#endif
+  } else if (description->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D_COMPRESSED) {
+    if (offset >= TRAJECTORY_MEMORY_SIZE
+        || !piecewise_compressed_validate(&trajectories_memory[bank][offset], TRAJECTORY_MEMORY_SIZE - offset)) {
+      return ENOEXEC;
+    }
+  }
+
+  return 0;
+}
+
+// Makes a prepared trajectory the definition of trajectoryId. The piece start
+// times go to the table of the definition the planner is not flying. Must be
+// called with lockTraj held.
+static void publishTrajectory(uint8_t trajectoryId, const struct trajectoryDescription* description,
+  const struct piecewise_bounds* bounds, const float* pieceStart)
+{
+  uint8_t index = (trajectory.piece_start == trajectory_piece_start[trajectoryId][0]) ? 1 : 0;
+  if (description->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D) {
+    memcpy(trajectory_piece_start[trajectoryId][index], pieceStart,
+      (description->trajectoryIdentifier.mem.n_pieces + 1) * sizeof(float));
+  }
+  trajectory_piece_start_index[trajectoryId] = index;
+  trajectory_bounds[trajectoryId] = *bounds;
+  trajectory_descriptions[trajectoryId] = *description;
+}
+
+// Undefines the trajectories, other than trajectoryId, that overlap the
+// uploaded range. They were prepared from the pieces the upload replaced.
+// Must be called with lockTraj held.
+static void undefineOverwrittenTrajectories(uint8_t trajectoryId)
+{
+  for (int i = 0; i < NUM_TRAJECTORY_DEFINITIONS; ++i) {
+    struct trajectoryDescription* description = &trajectory_descriptions[i];
+    if (i == trajectoryId || description->trajectoryLocation != TRAJECTORY_LOCATION_MEM) {
+      continue;
+    }
+    uint32_t begin = description->trajectoryIdentifier.mem.offset;
+    // the length of a compressed trajectory is only known by decoding it
+    uint32_t end = TRAJECTORY_MEMORY_SIZE;
+    if (description->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D) {
+      end = begin + description->trajectoryIdentifier.mem.n_pieces * sizeof(struct poly4d);
+    }
+    if (begin < uploadEnd && uploadStart < end) {
+      description->trajectoryLocation = TRAJECTORY_LOCATION_INVALID;
+    }
+  }
+}
+
+// Defines a trajectory. If an upload is in progress, the trajectory is verified
+// in the uploaded bank, which only becomes the active one if the trajectory is
+// feasible and, if expectedCrc is not NULL, the CRC of the uploaded range
+// matches. Trajectories that the upload overwrote are undefined by the flip. A
+// failed define leaves the banks and the previous definitions as they were.
+static int commitUpload(const uint32_t* expectedCrc, uint8_t trajectoryId, const struct trajectoryDescription* description)
+{
+  // serialized by lockUpload
+  static float pieceStart[TRAJECTORY_MAX_PIECES + 1];
+  struct piecewise_bounds bounds = {0};
+  int result = 0;
+
+  k_mutex_lock(&lockUpload, K_FOREVER);
+  if (!uploadInProgress) {
+    if (expectedCrc) {
+      // nothing was written that the CRC could be checked against
+      result = EINVAL;
+    } else {
+      result = prepareTrajectory(activeBank, description, &bounds, pieceStart);
+      if (result == 0) {
         k_mutex_lock(&lockTraj, K_FOREVER);
-        float t = k_uptime_get() / 1e6;
-        trajectory.t_begin = t;
-        trajectory.timescale = data->timescale;
-        trajectory.n_pieces = trajDesc->trajectoryIdentifier.mem.n_pieces;
-        trajectory.pieces = (struct poly4d*)&trajectories_memory[trajDesc->trajectoryIdentifier.mem.offset];
-        result = plan_start_trajectory(&planner, &trajectory, data->reversed, data->relative, pos);
+        publishTrajectory(trajectoryId, description, &bounds, pieceStart);
         k_mutex_unlock(&lockTraj);
-      } else if (trajDesc->trajectoryLocation == TRAJECTORY_LOCATION_MEM
-          && trajDesc->trajectoryType == CRTP_CHL_TRAJECTORY_TYPE_POLY4D_COMPRESSED) {
-
-        if (data->timescale != 1 || data->reversed) {
-          result = ENOEXEC;
-        } else {
-          k_mutex_lock(&lockTraj, K_FOREVER);
-          float t = k_uptime_get() / 1e6;
-          piecewise_compressed_load(
-            &compressed_trajectory,
-            &trajectories_memory[trajDesc->trajectoryIdentifier.mem.offset]
-          );
-          compressed_trajectory.t_begin = t;
-          result = plan_start_compressed_trajectory(&planner, &compressed_trajectory, data->relative, pos);
-          k_mutex_unlock(&lockTraj);
-        }
+      }
+    }
+  } else {
+    const uint8_t* upload = trajectories_memory[activeBank ^ 1];
+    if (expectedCrc && crc32CalculateBuffer(&upload[uploadStart], uploadEnd - uploadStart) != *expectedCrc) {
+      uploadCrcErrors++;
+      result = EIO;
+    } else {
+      result = prepareTrajectory(activeBank ^ 1, description, &bounds, pieceStart);
+    }
 
+    if (result == 0) {
+      // A running trajectory keeps its pointers into the previous bank, which
+      // is not written again as long as the planner is using it.
+      k_mutex_lock(&lockTraj, K_FOREVER);
+      activeBank ^= 1;
+      undefineOverwrittenTrajectories(trajectoryId);
+      publishTrajectory(trajectoryId, description, &bounds, pieceStart);
+      k_mutex_unlock(&lockTraj);
+
+      uploadInProgress = false;
+      uint32_t duration = k_uptime_get_32() - uploadStartTime;
+      if (duration > 0) {
+        uploadRate = (uploadEnd - uploadStart) * 1000 / duration;
       }
     }
   }
+  k_mutex_unlock(&lockUpload);
+
   return result;
 }
 
@@ -633,8 +1550,16 @@ int define_trajectory(const struct data_define_trajectory* data)
   if (data->trajectoryId >= NUM_TRAJECTORY_DEFINITIONS) {
     return ENOEXEC;
   }
-  trajectory_descriptions[data->trajectoryId] = data->description;
-  return 0;
+  return commitUpload(NULL, data->trajectoryId, &data->description);
+}
+
+int define_trajectory_crc(const struct data_define_trajectory_crc* data)
+{
+  if (data->trajectoryId >= NUM_TRAJECTORY_DEFINITIONS) {
+    return ENOEXEC;
+  }
+  uint32_t crc32 = data->crc32;
+  return commitUpload(&crc32, data->trajectoryId, &data->description);
 }
 
 static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* buffer) {
@@ -760,6 +1685,121 @@ int crtpCommanderHighLevelGoTo(const float x, const float y, const float z, cons
   return handleCommand(COMMAND_GO_TO, (const uint8_t*)&data);
 }
 
+int crtpCommanderHighLevelAddWaypoint(const float x, const float y, const float z, const float yaw, const float duration_s, const bool clear)
+{
+  struct data_add_waypoint data =
+  {
+    .groupMask = ALL_GROUPS,
+    .clear = clear,
+    .x = x,
+    .y = y,
+    .z = z,
+    .yaw = yaw,
+    .duration = duration_s,
+  };
+
+  return handleCommand(COMMAND_ADD_WAYPOINT, (const uint8_t*)&data);
+}
+
+int crtpCommanderHighLevelGoToWaypoints(const bool relative)
+{
+  struct data_go_to_waypoints data =
+  {
+    .groupMask = ALL_GROUPS,
+    .relative = relative,
+  };
+
+  return handleCommand(COMMAND_GO_TO_WAYPOINTS, (const uint8_t*)&data);
+}
+
+int crtpCommanderHighLevelQueueGoTo(const float x, const float y, const float z, const float yaw, const float duration_s, const bool relative)
+{
+  struct data_queue data =
+  {
+    .command = COMMAND_GO_TO,
+    .goTo = {
+      .x = x,
+      .y = y,
+      .z = z,
+      .yaw = yaw,
+      .duration = duration_s,
+      .relative = relative,
+      .groupMask = ALL_GROUPS,
+    },
+  };
+
+  return handleCommand(COMMAND_QUEUE, (const uint8_t*)&data);
+}
+
+int crtpCommanderHighLevelQueueStartTrajectory(const uint8_t trajectoryId, const float timeScale, const bool relative, const bool reversed)
+{
+  struct data_queue data =
+  {
+    .command = COMMAND_START_TRAJECTORY,
+    .startTrajectory = {
+      .trajectoryId = trajectoryId,
+      .timescale = timeScale,
+      .relative = relative,
+      .reversed = reversed,
+      .groupMask = ALL_GROUPS,
+    },
+  };
+
+  return handleCommand(COMMAND_QUEUE, (const uint8_t*)&data);
+}
+
+int crtpCommanderHighLevelQueueLand(const float absoluteHeight_m, const float duration_s)
+{
+  struct data_queue data =
+  {
+    .command = COMMAND_LAND_2,
+    .land = {
+      .height = absoluteHeight_m,
+      .duration = duration_s,
+      .useCurrentYaw = true,
+      .groupMask = ALL_GROUPS,
+    },
+  };
+
+  return handleCommand(COMMAND_QUEUE, (const uint8_t*)&data);
+}
+
+int crtpCommanderHighLevelScheduleStartTrajectory(const uint64_t startTimeUs, const uint8_t trajectoryId, const float timeScale, const bool relative, const bool reversed)
+{
+  struct data_schedule data =
+  {
+    .startTimeUs = (uint32_t)startTimeUs,
+    .command = {
+      .command = COMMAND_START_TRAJECTORY,
+      .startTrajectory = {
+        .trajectoryId = trajectoryId,
+        .timescale = timeScale,
+        .relative = relative,
+        .reversed = reversed,
+        .groupMask = ALL_GROUPS,
+      },
+    },
+  };
+
+  return handleCommand(COMMAND_SCHEDULE, (const uint8_t*)&data);
+}
+
+int crtpCommanderHighLevelSetSwarmTime(const uint64_t swarmTimeUs)
+{
+  struct data_set_swarm_time data =
+  {
+    .groupMask = ALL_GROUPS,
+    .swarmTimeUs = swarmTimeUs,
+  };
+
+  return handleCommand(COMMAND_SET_SWARM_TIME, (const uint8_t*)&data);
+}
+
+uint64_t crtpCommanderHighLevelGetSwarmTime()
+{
+  return localTimeUs() + getSwarmTimeOffset();
+}
+
 bool crtpCommanderHighLevelIsTrajectoryDefined(uint8_t trajectoryId)
 {
   return (
@@ -798,16 +1838,44 @@ int crtpCommanderHighLevelDefineTrajectory(const uint8_t trajectoryId, const crt
 
 uint32_t crtpCommanderHighLevelTrajectoryMemSize()
 {
-  return sizeof(trajectories_memory);
+  return TRAJECTORY_MEMORY_SIZE;
 }
 
 bool crtpCommanderHighLevelWriteTrajectory(const uint32_t offset, const uint32_t length, const uint8_t* data)
 {
   bool result = false;
 
-  if ((offset + length) <= sizeof(trajectories_memory)) {
-    memcpy(&(trajectories_memory[offset]), data, length);
-    result = true;
+  if ((offset + length) <= TRAJECTORY_MEMORY_SIZE) {
+    k_mutex_lock(&lockUpload, K_FOREVER);
+    uint8_t* upload = trajectories_memory[activeBank ^ 1];
+
+    if (!uploadInProgress) {
+      k_mutex_lock(&lockTraj, K_FOREVER);
+      bool inUse = isTrajectoryBankInUse(upload);
+      k_mutex_unlock(&lockTraj);
+
+      if (!inUse) {
+        // Start from a copy of the active bank, so that trajectories that are
+        // not uploaded again are still valid after the banks are flipped.
+        memcpy(upload, trajectories_memory[activeBank], TRAJECTORY_MEMORY_SIZE);
+#ifdef PPTRAJ_FIXED_POINT
+        memcpy(trajectory_fixed[activeBank ^ 1], trajectory_fixed[activeBank], sizeof(trajectory_fixed[0]));
+#endif
+        uploadInProgress = true;
+        uploadStart = offset;
+        uploadEnd = offset + length;
+        uploadStartTime = k_uptime_get_32();
+      }
+    }
+
+    if (uploadInProgress) {
+      memcpy(&upload[offset], data, length);
+      uploadStart = MIN(uploadStart, offset);
+      uploadEnd = MAX(uploadEnd, offset + length);
+      uploadBytes += length;
+      result = true;
+    }
+    k_mutex_unlock(&lockUpload);
   }
 
   return result;
@@ -817,7 +1885,12 @@ bool crtpCommanderHighLevelReadTrajectory(const uint32_t offset, const uint32_t
 {
   bool result = false;
 
-  if (offset + length <= sizeof(trajectories_memory) && memcpy(destination, &(trajectories_memory[offset]), length)) {
+  if (offset + length <= TRAJECTORY_MEMORY_SIZE) {
+    k_mutex_lock(&lockUpload, K_FOREVER);
+    // read back what is being uploaded, if anything
+    uint8_t bank = uploadInProgress ? activeBank ^ 1 : activeBank;
+    memcpy(destination, &(trajectories_memory[bank][offset]), length);
+    k_mutex_unlock(&lockUpload);
     result = true;
   }
 
@@ -825,8 +1898,10 @@ bool crtpCommanderHighLevelReadTrajectory(const uint32_t offset, const uint32_t
 }
 
 bool crtpCommanderHighLevelIsTrajectoryFinished() {
-  float t = k_uptime_get() / 1e6;
-  return plan_is_finished(&planner, t);
+  k_mutex_lock(&lockTraj, K_FOREVER);
+  bool finished = plan_is_finished(&planner, plannerTime());
+  k_mutex_unlock(&lockTraj);
+  return finished;
 }
 
 /**
@@ -845,4 +1920,123 @@ PARAM_ADD_CORE(PARAM_FLOAT, vtoff, &defaultTakeoffVelocity)
  */
 PARAM_ADD_CORE(PARAM_FLOAT, vland, &defaultLandingVelocity)
 
+/**
+ * @brief Largest velocity of an uploaded trajectory, 0 disables the check (default: 0)
+ */
+PARAM_ADD(PARAM_FLOAT, maxVel, &trajectoryLimits.max_vel)
+
+/**
+ * @brief Largest acceleration of an uploaded trajectory, 0 disables the check (default: 0)
+ */
+PARAM_ADD(PARAM_FLOAT, maxAcc, &trajectoryLimits.max_acc)
+
+/**
+ * @brief Largest jerk of an uploaded trajectory, 0 disables the check (default: 0)
+ */
+PARAM_ADD(PARAM_FLOAT, maxJerk, &trajectoryLimits.max_jerk)
+
+/**
+ * @brief Largest jump of position, velocity or acceleration at the piece joins of an uploaded trajectory, yaw excluded, 0 disables the check (default: 0)
+ */
+PARAM_ADD(PARAM_FLOAT, maxJump, &trajectoryLimits.max_discontinuity)
+
+/**
+ * @brief Set to the id + 1 of a defined trajectory to benchmark its evaluation while the planner is stopped, see the bench* log variables
+ */
+PARAM_ADD(PARAM_UINT8, bench, &benchmarkRequest)
+
 PARAM_GROUP_STOP(hlCommander)
+
+/**
+ * Timing of the high-level commander
+ */
+LOG_GROUP_START(hlCommander)
+
+/**
+ * @brief Worst-case time to decode a compressed trajectory piece ahead of time (us)
+ */
+LOG_ADD(LOG_UINT32, decodeMax, &compressedDecodeMaxUs)
+
+/**
+ * @brief Number of compressed pieces decoded on the control path because they were not decoded ahead of time
+ */
+LOG_ADD(LOG_UINT32, decodeInline, &compressed_trajectory.inline_decodes)
+
+/**
+ * @brief Total number of bytes written to trajectory memory
+ */
+LOG_ADD(LOG_UINT32, uploadBytes, &uploadBytes)
+
+/**
+ * @brief Throughput of the last completed trajectory upload (bytes/s)
+ */
+LOG_ADD(LOG_UINT32, uploadRate, &uploadRate)
+
+/**
+ * @brief Number of trajectory uploads rejected because of a CRC mismatch
+ */
+LOG_ADD(LOG_UINT32, uploadCrcErr, &uploadCrcErrors)
+
+/**
+ * @brief Time spent in the last on-board minimum snap solve of COMMAND_GO_TO_WAYPOINTS (us)
+ */
+LOG_ADD(LOG_UINT32, planSolve, &planSolveUs)
+
+/**
+ * @brief Offset of the swarm-wide clock to the local clock (us, lower 32 bits)
+ */
+LOG_ADD(LOG_UINT32, swarmOffset, &swarmTimeOffsetLowUs)
+
+/**
+ * @brief Offset of the swarm-wide clock to the local clock (us, upper 32 bits)
+ */
+LOG_ADD(LOG_INT32, swarmOffsetHi, &swarmTimeOffsetHighUs)
+
+/**
+ * @brief Number of commands waiting in the queue
+ */
+LOG_ADD(LOG_UINT8, queueLen, &queueLength)
+
+/**
+ * @brief Number of queued commands that could not be started
+ */
+LOG_ADD(LOG_UINT32, queueErr, &queueErrors)
+
+/**
+ * @brief Average time of a trajectory evaluation in the last benchmark (ns)
+ */
+LOG_ADD(LOG_UINT32, benchAvg, &benchmarkAvgNs)
+
+/**
+ * @brief Worst-case time of a trajectory evaluation in the last benchmark (ns)
+ */
+LOG_ADD(LOG_UINT32, benchMax, &benchmarkMaxNs)
+
+/**
+ * @brief Number of reversed, time-scaled or fixed point evaluations in the last benchmark that did not match the forward float evaluation
+ */
+LOG_ADD(LOG_UINT32, benchErr, &benchmarkMismatches)
+
+#ifdef PPTRAJ_FIXED_POINT
+/**
+ * @brief Average time of a fixed point trajectory evaluation in the last benchmark (ns)
+ */
+LOG_ADD(LOG_UINT32, benchFixAvg, &benchmarkFixedAvgNs)
+
+/**
+ * @brief Worst-case time of a fixed point trajectory evaluation in the last benchmark (ns)
+ */
+LOG_ADD(LOG_UINT32, benchFixMax, &benchmarkFixedMaxNs)
+#endif
+
+/**
+ * @brief Time spent verifying the last defined trajectory (us)
+ */
+LOG_ADD(LOG_UINT32, verifyTime, &verifyUs)
+
+/**
+ * @brief Result of the last trajectory verification (0: feasible, 1: too fast, 2: too much acceleration, 3: too much jerk, 4: discontinuous)
+ */
+LOG_ADD(LOG_UINT8, verifyResult, &verifyResult)
+
+LOG_GROUP_STOP(hlCommander)
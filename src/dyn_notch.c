@@ -0,0 +1,388 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dyn_notch.c - Gyro notch filters tuned to the motor noise by an on-board FFT
+ *
+ * The roll and pitch gyro samples are collected in a double buffer. Each full
+ * buffer is handed to a low priority task, which windows it, runs a real FFT
+ * per axis, and looks for the strongest peaks of the summed power spectrum.
+ * The notch frequencies follow the peaks through a low pass, and the new
+ * coefficients are copied into the filters by dynNotchApply() between two
+ * samples, so a filter never runs with half updated coefficients. The notches
+ * are direct form 1 biquads, whose state stays valid when the coefficients
+ * change.
+ */
+#include <string.h>
+
+#include <zephyr/kernel.h>
+
+#include "config.h"
+#include "dyn_notch.h"
+#include "filter.h"
+#include "cf_math.h"
+
+#include "param.h"
+#include "log.h"
+
+#define ANALYZED_AXES 2
+#define SPECTRUM_BINS (DYN_NOTCH_FFT_SIZE / 2)
+
+// A peak must be this much stronger than the average power in the band
+#define PEAK_THRESHOLD 4.0f
+
+// Lowest quality factor of the notches, a wider notch would take the whole band
+#define MIN_Q 0.1f
+
+static bool isInit;
+static float sampleFreq;
+
+static uint8_t enabled;
+static float minFreq = 80.0f;
+static float maxFreq = 400.0f;
+static float notchQ = 3.0f;
+static float smoothing = 0.3f;
+
+// Double buffer of gyro samples, filled by dynNotchApply(). The buffers are
+// handed between dynNotchApply() and the analyzer task by index, through the
+// queues of full and of analyzed buffers.
+static float samples[2][ANALYZED_AXES][DYN_NOTCH_FFT_SIZE];
+static uint8_t fillBuffer;
+static uint16_t fillIndex;
+K_MSGQ_DEFINE(fullBuffers, sizeof(uint8_t), 2, 1);
+K_MSGQ_DEFINE(freeBuffers, sizeof(uint8_t), 2, 1);
+// Buffers refilled because the analyzer still held the other one
+static uint32_t overruns;
+
+// Analyzer task workspace
+static arm_rfft_fast_instance_f32 fft;
+static float window[DYN_NOTCH_FFT_SIZE];
+static float fftInput[DYN_NOTCH_FFT_SIZE];
+static float fftOutput[DYN_NOTCH_FFT_SIZE];
+static float binPower[SPECTRUM_BINS];
+static float power[SPECTRUM_BINS];
+static float centerFreq[DYN_NOTCH_COUNT];
+static uint32_t analyzeTimeUs;
+
+// Notch filters, used by dynNotchApply() only
+static struct SecondOrderLowPass notch[DYN_NOTCH_COUNT][3];
+static bool notchActive[DYN_NOTCH_COUNT];
+
+// Coefficients published by the analyzer task
+static struct k_spinlock coeffsLock;
+static struct SecondOrderLowPass pendingCoeffs[DYN_NOTCH_COUNT];
+static bool pendingActive[DYN_NOTCH_COUNT];
+static bool pendingUpdate;
+
+K_THREAD_STACK_DEFINE(dynNotchTaskStack, DYN_NOTCH_TASK_STACKSIZE);
+static struct k_thread dynNotchTaskThread;
+
+// Notch coefficients in the layout of update_second_order_low_pass(), b[0] is also b2
+static void notchCoeffs(struct SecondOrderLowPass* filter, float centerFreq, float q)
+{
+  float w0 = 2.0f * PI * centerFreq / sampleFreq;
+  float alpha = sinf(w0) / (2.0f * q);
+  float cosw0 = cosf(w0);
+  float a0 = 1.0f + alpha;
+
+  filter->b[0] = 1.0f / a0;
+  filter->b[1] = -2.0f * cosw0 / a0;
+  filter->a[0] = -2.0f * cosw0 / a0;
+  filter->a[1] = (1.0f - alpha) / a0;
+}
+
+// Frequency of a local maximum of the power, refined by a parabola through the neighbouring bins
+static float peakFreq(int bin)
+{
+  float left = power[bin - 1];
+  float center = power[bin];
+  float right = power[bin + 1];
+  float denominator = left - 2.0f * center + right;
+  float offset = denominator != 0.0f ? 0.5f * (left - right) / denominator : 0.0f;
+  return (bin + offset) * sampleFreq / DYN_NOTCH_FFT_SIZE;
+}
+
+static void computePower(float (*buffer)[DYN_NOTCH_FFT_SIZE])
+{
+  memset(power, 0, sizeof(power));
+
+  for (int axis = 0; axis < ANALYZED_AXES; axis++) {
+    arm_mult_f32(buffer[axis], window, fftInput, DYN_NOTCH_FFT_SIZE);
+    arm_rfft_fast_f32(&fft, fftInput, fftOutput, 0);
+    // fftOutput[0] and [1] hold the real DC and Nyquist bins, the rest is complex
+    arm_cmplx_mag_squared_f32(&fftOutput[2], &binPower[1], SPECTRUM_BINS - 1);
+    for (int i = 1; i < SPECTRUM_BINS; i++) {
+      power[i] += binPower[i];
+    }
+  }
+}
+
+// Strongest local maxima in the band, at most DYN_NOTCH_COUNT, sorted by frequency
+static int findPeaks(float peaks[DYN_NOTCH_COUNT])
+{
+  int firstBin = MAX(2, (int)(minFreq * DYN_NOTCH_FFT_SIZE / sampleFreq));
+  int lastBin = MIN(SPECTRUM_BINS - 2, (int)(maxFreq * DYN_NOTCH_FFT_SIZE / sampleFreq));
+  if (lastBin <= firstBin) {
+    return 0;
+  }
+
+  float average = 0;
+  for (int i = firstBin; i <= lastBin; i++) {
+    average += power[i];
+  }
+  average /= lastBin - firstBin + 1;
+
+  int bins[DYN_NOTCH_COUNT];
+  int count = 0;
+  for (int i = firstBin; i <= lastBin; i++) {
+    if (power[i] < PEAK_THRESHOLD * average || power[i] < power[i - 1] || power[i] <= power[i + 1]) {
+      continue;
+    }
+
+    // Insert by power, dropping the weakest peak when full
+    int slot = count < DYN_NOTCH_COUNT ? count++ : DYN_NOTCH_COUNT;
+    while (slot > 0 && power[bins[slot - 1]] < power[i]) {
+      if (slot < DYN_NOTCH_COUNT) {
+        bins[slot] = bins[slot - 1];
+      }
+      slot--;
+    }
+    if (slot < DYN_NOTCH_COUNT) {
+      bins[slot] = i;
+    }
+  }
+
+  for (int i = 0; i < count; i++) {
+    peaks[i] = peakFreq(bins[i]);
+  }
+
+  // Sorted by frequency, so that each notch keeps following the same peak
+  for (int i = 1; i < count; i++) {
+    for (int j = i; j > 0 && peaks[j - 1] > peaks[j]; j--) {
+      float tmp = peaks[j];
+      peaks[j] = peaks[j - 1];
+      peaks[j - 1] = tmp;
+    }
+  }
+
+  return count;
+}
+
+static void retune(const float peaks[DYN_NOTCH_COUNT], int count)
+{
+  struct SecondOrderLowPass coeffs[DYN_NOTCH_COUNT] = {0};
+  bool active[DYN_NOTCH_COUNT];
+
+  for (int i = 0; i < DYN_NOTCH_COUNT; i++) {
+    if (!enabled) {
+      centerFreq[i] = 0.0f;
+    } else if (i < count) {
+      if (centerFreq[i] == 0.0f) {
+        centerFreq[i] = peaks[i];
+      } else {
+        centerFreq[i] += smoothing * (peaks[i] - centerFreq[i]);
+      }
+    }
+    // A notch without a peak in this spectrum keeps its frequency
+
+    active[i] = centerFreq[i] != 0.0f;
+    if (active[i]) {
+      notchCoeffs(&coeffs[i], centerFreq[i], notchQ);
+    }
+  }
+
+  k_spinlock_key_t key = k_spin_lock(&coeffsLock);
+  memcpy(pendingCoeffs, coeffs, sizeof(coeffs));
+  memcpy(pendingActive, active, sizeof(active));
+  pendingUpdate = true;
+  k_spin_unlock(&coeffsLock, key);
+}
+
+static void dynNotchTask(void *p1, void *p2, void *p3)
+{
+  float peaks[DYN_NOTCH_COUNT];
+  bool tuned = false;
+
+  while (1) {
+    uint8_t buffer;
+    k_msgq_get(&fullBuffers, &buffer, K_FOREVER);
+
+    if (!enabled) {
+      // Nothing to analyze, the notches are only switched off once
+      k_msgq_put(&freeBuffers, &buffer, K_NO_WAIT);
+      if (tuned) {
+        retune(peaks, 0);
+        tuned = false;
+      }
+      continue;
+    }
+
+    uint32_t start = k_cycle_get_32();
+    computePower(samples[buffer]);
+    k_msgq_put(&freeBuffers, &buffer, K_NO_WAIT);
+    retune(peaks, findPeaks(peaks));
+    tuned = true;
+    analyzeTimeUs = k_cyc_to_us_ceil32(k_cycle_get_32() - start);
+  }
+}
+
+static void clampQ(void)
+{
+  if (!(notchQ >= MIN_Q)) {
+    notchQ = MIN_Q;
+  }
+}
+
+// A notch can not be placed above the Nyquist frequency
+static void clampMaxFreq(void)
+{
+  if (isInit && !(maxFreq <= 0.5f * sampleFreq)) {
+    maxFreq = 0.5f * sampleFreq;
+  }
+}
+
+void dynNotchInit(float freq)
+{
+  if (isInit) {
+    return;
+  }
+
+  sampleFreq = freq;
+  clampQ();
+  arm_rfft_fast_init_f32(&fft, DYN_NOTCH_FFT_SIZE);
+  for (int i = 0; i < DYN_NOTCH_FFT_SIZE; i++) {
+    window[i] = 0.5f - 0.5f * cosf(2.0f * PI * i / (DYN_NOTCH_FFT_SIZE - 1));
+  }
+
+  // dynNotchApply() fills buffer 0 first
+  fillBuffer = 0;
+  uint8_t free = 1;
+  k_msgq_put(&freeBuffers, &free, K_NO_WAIT);
+
+  k_thread_create(&dynNotchTaskThread, dynNotchTaskStack,
+                  K_THREAD_STACK_SIZEOF(dynNotchTaskStack),
+                  dynNotchTask,
+                  NULL, NULL, NULL,
+                  DYN_NOTCH_TASK_PRI, 0, K_NO_WAIT);
+  k_thread_name_set(&dynNotchTaskThread, DYN_NOTCH_TASK_NAME);
+
+  isInit = true;
+  clampMaxFreq();
+}
+
+bool dynNotchTest(void)
+{
+  return isInit;
+}
+
+void dynNotchApply(Axis3f* gyro)
+{
+  if (!isInit) {
+    return;
+  }
+
+  samples[fillBuffer][0][fillIndex] = gyro->x;
+  samples[fillBuffer][1][fillIndex] = gyro->y;
+  if (++fillIndex == DYN_NOTCH_FFT_SIZE) {
+    fillIndex = 0;
+    uint8_t next;
+    if (k_msgq_get(&freeBuffers, &next, K_NO_WAIT) == 0) {
+      k_msgq_put(&fullBuffers, &fillBuffer, K_NO_WAIT);
+      fillBuffer = next;
+    } else {
+      // The analyzer is still on the other buffer, drop this one
+      overruns++;
+    }
+  }
+
+  if (pendingUpdate) {
+    k_spinlock_key_t key = k_spin_lock(&coeffsLock);
+    for (int i = 0; i < DYN_NOTCH_COUNT; i++) {
+      for (int axis = 0; axis < 3; axis++) {
+        memcpy(notch[i][axis].a, pendingCoeffs[i].a, sizeof(pendingCoeffs[i].a));
+        memcpy(notch[i][axis].b, pendingCoeffs[i].b, sizeof(pendingCoeffs[i].b));
+        // A notch that starts from a stale state would ring
+        if (pendingActive[i] && !notchActive[i]) {
+          notch[i][axis].i[0] = notch[i][axis].i[1] = gyro->axis[axis];
+          notch[i][axis].o[0] = notch[i][axis].o[1] = gyro->axis[axis];
+        }
+      }
+      notchActive[i] = pendingActive[i];
+    }
+    pendingUpdate = false;
+    k_spin_unlock(&coeffsLock, key);
+  }
+
+  for (int i = 0; i < DYN_NOTCH_COUNT; i++) {
+    if (notchActive[i]) {
+      for (int axis = 0; axis < 3; axis++) {
+        gyro->axis[axis] = update_second_order_low_pass(&notch[i][axis], gyro->axis[axis]);
+      }
+    }
+  }
+}
+
+/**
+ * Notch filters on the gyro, tuned to the peaks of the gyro spectrum
+ */
+PARAM_GROUP_START(dynNotch)
+/**
+ * @brief Non-zero to track the noise peaks and filter them
+ */
+PARAM_ADD(PARAM_UINT8, enable, &enabled)
+/**
+ * @brief Lowest frequency of a tracked peak [Hz]
+ */
+PARAM_ADD(PARAM_FLOAT, minHz, &minFreq)
+/**
+ * @brief Highest frequency of a tracked peak, at most half the gyro rate [Hz]
+ */
+PARAM_ADD_WITH_CALLBACK(PARAM_FLOAT, maxHz, &maxFreq, &clampMaxFreq)
+/**
+ * @brief Quality factor of the notches, the center frequency over the bandwidth (at least 0.1)
+ */
+PARAM_ADD_WITH_CALLBACK(PARAM_FLOAT, q, &notchQ, &clampQ)
+/**
+ * @brief Weight of a new peak in the notch frequency (0 - 1)
+ */
+PARAM_ADD(PARAM_FLOAT, smoothing, &smoothing)
+PARAM_GROUP_STOP(dynNotch)
+
+/**
+ * Tracked noise peaks
+ */
+LOG_GROUP_START(dynNotch)
+/**
+ * @brief Center frequency of the first notch, 0 until a peak is found [Hz]
+ */
+LOG_ADD(LOG_FLOAT, f1, &centerFreq[0])
+/**
+ * @brief Center frequency of the second notch, 0 until a peak is found [Hz]
+ */
+LOG_ADD(LOG_FLOAT, f2, &centerFreq[1])
+/**
+ * @brief Time of one spectrum analysis [us]
+ */
+LOG_ADD(LOG_UINT32, time, &analyzeTimeUs)
+/**
+ * @brief Sample buffers dropped because the analysis of the previous one had not finished
+ */
+LOG_ADD(LOG_UINT32, overrun, &overruns)
+LOG_GROUP_STOP(dynNotch)
@@ -0,0 +1,140 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * estimator_history.c - State history for fusing delayed measurements
+ */
+#include <string.h>
+
+#include "estimator_history.h"
+
+static uint8_t* snapshot(estimatorHistory_t *history, uint32_t step)
+{
+  return &history->snapshots[(step % ESTIMATOR_HISTORY_LENGTH) * history->stateSize];
+}
+
+static estimatorHistoryInput_t* input(estimatorHistory_t *history, uint32_t step)
+{
+  return &history->inputs[step % ESTIMATOR_HISTORY_LENGTH];
+}
+
+void estimatorHistoryInit(estimatorHistory_t *history, const estimatorHistoryOps_t *ops,
+                          void *state, void *snapshots, size_t stateSize, uint8_t maxReplay)
+{
+  memset(history, 0, sizeof(*history));
+  history->ops = *ops;
+  history->state = state;
+  history->snapshots = snapshots;
+  history->stateSize = stateSize;
+  history->maxReplay = maxReplay < ESTIMATOR_HISTORY_LENGTH ? maxReplay : ESTIMATOR_HISTORY_LENGTH - 1;
+}
+
+void estimatorHistoryPredict(estimatorHistory_t *history, const estimatorHistoryInput_t *in)
+{
+  history->ops.predict(history->state, in);
+
+  uint32_t step = history->head++;
+  *input(history, step) = *in;
+  memcpy(snapshot(history, step), history->state, history->stateSize);
+}
+
+// Remember a measurement fused after a step, for the replays that pass the step
+static void record(estimatorHistory_t *history, uint32_t step, const measurement_t *measurement)
+{
+  estimatorHistoryFused_t *entry = &history->fused[history->fusedCount % ESTIMATOR_HISTORY_FUSED_LENGTH];
+  if (history->fusedCount >= ESTIMATOR_HISTORY_FUSED_LENGTH && (int32_t)(entry->step + 1 - history->fusedFrom) > 0) {
+    // The oldest one is forgotten, a replay must start after its step
+    history->fusedFrom = entry->step + 1;
+  }
+
+  entry->step = step;
+  entry->measurement = *measurement;
+  history->fusedCount++;
+}
+
+// Fuse again the measurements that followed a replayed step, in their order
+static void reapply(estimatorHistory_t *history, uint32_t step)
+{
+  uint32_t count = history->fusedCount < ESTIMATOR_HISTORY_FUSED_LENGTH ? history->fusedCount : ESTIMATOR_HISTORY_FUSED_LENGTH;
+  for (uint32_t i = history->fusedCount - count; i != history->fusedCount; i++) {
+    const estimatorHistoryFused_t *entry = &history->fused[i % ESTIMATOR_HISTORY_FUSED_LENGTH];
+    if (entry->step == step) {
+      history->ops.update(history->state, &entry->measurement);
+    }
+  }
+}
+
+// Fuse a measurement at the present, after the last prediction
+static void fusePresent(estimatorHistory_t *history, const measurement_t *measurement)
+{
+  uint32_t step = history->head - 1;
+  history->ops.update(history->state, measurement);
+  memcpy(snapshot(history, step), history->state, history->stateSize);
+  record(history, step, measurement);
+}
+
+bool estimatorHistoryFuse(estimatorHistory_t *history, const measurement_t *measurement, uint32_t timestamp)
+{
+  if (history->head == 0) {
+    history->ops.update(history->state, measurement);
+    return false;
+  }
+
+  // Latest step at or before the measurement, searched backwards from the
+  // present over at most maxReplay steps
+  uint32_t limit = history->head - 1 < history->maxReplay ? history->head - 1 : history->maxReplay;
+  uint32_t back = 0;
+  while (back <= limit &&
+         (int32_t)(input(history, history->head - 1 - back)->timestamp - timestamp) > 0) {
+    back++;
+  }
+
+  // The replay needs every measurement fused after the step
+  uint32_t step = history->head - 1 - back;
+  if (back != 0 && back <= limit && (int32_t)(step + 1 - history->fusedFrom) < 0) {
+    back = limit + 1;
+  }
+
+  if (back == 0 || back > limit) {
+    // Newer than the last prediction, or too old to replay: fuse at the present
+    if (back != 0) {
+      history->fusedLate++;
+    }
+    fusePresent(history, measurement);
+    return false;
+  }
+
+  // Fuse into the snapshot at the time of the measurement and replay the
+  // predictions and measurements that followed it, refreshing their snapshots
+  memcpy(history->state, snapshot(history, step), history->stateSize);
+  history->ops.update(history->state, measurement);
+  memcpy(snapshot(history, step), history->state, history->stateSize);
+  record(history, step, measurement);
+
+  for (step++; step < history->head; step++) {
+    history->ops.predict(history->state, input(history, step));
+    reapply(history, step);
+    memcpy(snapshot(history, step), history->state, history->stateSize);
+  }
+
+  history->replays++;
+  history->replayedSteps += back;
+  return true;
+}
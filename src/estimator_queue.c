@@ -0,0 +1,622 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * estimator_queue.c - Measurement queues of the state estimators
+ *
+ * One ring per measurement type, each sized for the rate of its sensor and
+ * holding items of its own size rather than measurement_t. Only the external
+ * position and pose have several sources, their producers are serialized by a
+ * spinlock of the type. The other types have a single producer, which pushes
+ * without the lock unless it shares admission state with the consumer. The
+ * consumer side takes no lock.
+ *
+ * Before a measurement is queued it passes an admission layer, which can
+ * limit each type to a budget of measurements per second. Over budget, the
+ * measurements of types that can be combined are merged until the budget
+ * allows another one, or until they have waited for the burst window, and the
+ * others are dropped. With budgets set, the work of the estimator is bounded
+ * by their sum, whichever decks are attached. All budgets default to no limit.
+ */
+#include <string.h>
+
+#include <zephyr/kernel.h>
+
+#include "estimator.h"
+#include "measurement_ring.h"
+#include "rate_loop.h"
+
+#include "param.h"
+#include "log.h"
+
+MEASUREMENT_RING_BUFFER(tdoaBuffer, tdoaMeasurement_t, 8);
+MEASUREMENT_RING_BUFFER(positionBuffer, positionMeasurement_t, 4);
+MEASUREMENT_RING_BUFFER(poseBuffer, poseMeasurement_t, 4);
+MEASUREMENT_RING_BUFFER(distanceBuffer, distanceMeasurement_t, 8);
+MEASUREMENT_RING_BUFFER(tofBuffer, tofMeasurement_t, 4);
+MEASUREMENT_RING_BUFFER(heightBuffer, heightMeasurement_t, 4);
+MEASUREMENT_RING_BUFFER(flowBuffer, flowMeasurement_t, 4);
+MEASUREMENT_RING_BUFFER(yawErrorBuffer, yawErrorMeasurement_t, 4);
+MEASUREMENT_RING_BUFFER(sweepAngleBuffer, sweepAngleMeasurement_t, 16);
+MEASUREMENT_RING_BUFFER(gyroscopeBuffer, gyroscopeMeasurement_t, 16);
+MEASUREMENT_RING_BUFFER(accelerationBuffer, accelerationMeasurement_t, 16);
+MEASUREMENT_RING_BUFFER(barometerBuffer, barometerMeasurement_t, 4);
+
+static measurementRing_t rings[MeasurementType_COUNT] = {
+  [MeasurementTypeTDOA] = MEASUREMENT_RING_INIT(tdoaBuffer, tdoaMeasurement_t),
+  [MeasurementTypePosition] = MEASUREMENT_RING_INIT(positionBuffer, positionMeasurement_t),
+  [MeasurementTypePose] = MEASUREMENT_RING_INIT(poseBuffer, poseMeasurement_t),
+  [MeasurementTypeDistance] = MEASUREMENT_RING_INIT(distanceBuffer, distanceMeasurement_t),
+  [MeasurementTypeTOF] = MEASUREMENT_RING_INIT(tofBuffer, tofMeasurement_t),
+  [MeasurementTypeAbsoluteHeight] = MEASUREMENT_RING_INIT(heightBuffer, heightMeasurement_t),
+  [MeasurementTypeFlow] = MEASUREMENT_RING_INIT(flowBuffer, flowMeasurement_t),
+  [MeasurementTypeYawError] = MEASUREMENT_RING_INIT(yawErrorBuffer, yawErrorMeasurement_t),
+  [MeasurementTypeSweepAngle] = MEASUREMENT_RING_INIT(sweepAngleBuffer, sweepAngleMeasurement_t),
+  [MeasurementTypeGyroscope] = MEASUREMENT_RING_INIT(gyroscopeBuffer, gyroscopeMeasurement_t),
+  [MeasurementTypeAcceleration] = MEASUREMENT_RING_INIT(accelerationBuffer, accelerationMeasurement_t),
+  [MeasurementTypeBarometer] = MEASUREMENT_RING_INIT(barometerBuffer, barometerMeasurement_t),
+};
+
+// Order in which estimatorDequeue() drains the types: the IMU first, since the
+// prediction uses it, then the absolute measurements before the relative ones.
+static const MeasurementType priorityOrder[MeasurementType_COUNT] = {
+  MeasurementTypeGyroscope,
+  MeasurementTypeAcceleration,
+  MeasurementTypePose,
+  MeasurementTypePosition,
+  MeasurementTypeSweepAngle,
+  MeasurementTypeTDOA,
+  MeasurementTypeDistance,
+  MeasurementTypeYawError,
+  MeasurementTypeAbsoluteHeight,
+  MeasurementTypeTOF,
+  MeasurementTypeFlow,
+  MeasurementTypeBarometer,
+};
+
+// Burst a type may send above its budget, and the longest a merged
+// measurement waits for the budget
+#define ADMISSION_BURST_MS 50
+#define ADMISSION_TOKEN 1000
+
+typedef struct {
+  uint32_t lastRefill;   // ms
+  uint32_t tokens;       // thousandths of a measurement
+  uint32_t pendingSince; // ms, arrival of the first merged measurement
+  uint16_t pendingCount;
+  uint8_t pending[sizeof(((measurement_t*)0)->data)] __attribute__((aligned(4)));
+  estimatorAdmissionStats_t stats;
+} admission_t;
+
+static admission_t admissions[MeasurementType_COUNT];
+
+// Measurements per second of each type, 0 for no limit. The IMU is never
+// decimated, the prediction depends on every sample.
+static uint16_t budgets[MeasurementType_COUNT];
+
+// Serializes the producers of each type that takes it, live and replayed, and
+// guards the admission state the type shares with the consumer
+static struct k_spinlock producerLocks[MeasurementType_COUNT];
+static volatile bool replayActive;
+// Set by a producer that pushes without the lock, for the duration of its push
+static volatile uint8_t pushing[MeasurementType_COUNT];
+
+// Queue handovers to and from a replay. The consumer drops the items that
+// were queued before the last handover, up to flushHeads, the next time it
+// dequeues.
+static uint32_t flushHeads[MeasurementType_COUNT];
+static uint32_t flushGeneration;
+static uint32_t drainedGeneration; // consumer only
+
+// Types queued by more than one task, such as the external position sent by
+// several localization services
+static bool isMultiProducer(const MeasurementType type)
+{
+  return type == MeasurementTypePosition || type == MeasurementTypePose;
+}
+
+static bool isMergeable(const MeasurementType type)
+{
+  switch (type) {
+    case MeasurementTypeTOF:
+    case MeasurementTypeAbsoluteHeight:
+    case MeasurementTypeFlow:
+    case MeasurementTypeYawError:
+    case MeasurementTypeBarometer:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Running mean of timestamps, wrap safe
+static uint32_t meanTimestamp(uint32_t mean, uint32_t timestamp, float w)
+{
+  return mean + (int32_t)((int32_t)(timestamp - mean) * w);
+}
+
+// Fold a measurement into the pending one. Readings are averaged together with
+// their timestamps. Flow pixel counts are accumulated together with their
+// integration time, which ends at the newest timestamp.
+static void merge(const MeasurementType type, void *pending, const void *data, uint16_t count)
+{
+  const float w = 1.0f / (count + 1);
+
+  switch (type) {
+    case MeasurementTypeTOF: {
+      tofMeasurement_t *a = pending;
+      const tofMeasurement_t *b = data;
+      a->timestamp = meanTimestamp(a->timestamp, b->timestamp, w);
+      a->distance += (b->distance - a->distance) * w;
+      break;
+    }
+    case MeasurementTypeAbsoluteHeight: {
+      heightMeasurement_t *a = pending;
+      const heightMeasurement_t *b = data;
+      a->timestamp = meanTimestamp(a->timestamp, b->timestamp, w);
+      a->height += (b->height - a->height) * w;
+      break;
+    }
+    case MeasurementTypeFlow: {
+      flowMeasurement_t *a = pending;
+      const flowMeasurement_t *b = data;
+      a->timestamp = b->timestamp;
+      a->dpixelx += b->dpixelx;
+      a->dpixely += b->dpixely;
+      a->dt += b->dt;
+      break;
+    }
+    case MeasurementTypeYawError: {
+      yawErrorMeasurement_t *a = pending;
+      const yawErrorMeasurement_t *b = data;
+      a->timestamp = meanTimestamp(a->timestamp, b->timestamp, w);
+      a->yawError += (b->yawError - a->yawError) * w;
+      break;
+    }
+    case MeasurementTypeBarometer: {
+      barometerMeasurement_t *a = pending;
+      const barometerMeasurement_t *b = data;
+      a->baro.pressure += (b->baro.pressure - a->baro.pressure) * w;
+      a->baro.temperature += (b->baro.temperature - a->baro.temperature) * w;
+      a->baro.asl += (b->baro.asl - a->baro.asl) * w;
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+static bool takeToken(admission_t *admission, const uint16_t budget, const uint32_t now)
+{
+  uint32_t elapsed = now - admission->lastRefill;
+  admission->lastRefill = now;
+  if (elapsed > ADMISSION_BURST_MS) {
+    elapsed = ADMISSION_BURST_MS;
+  }
+
+  const uint32_t capacity = MAX((uint32_t)budget * ADMISSION_BURST_MS, (uint32_t)ADMISSION_TOKEN);
+  admission->tokens = MIN(admission->tokens + elapsed * budget, capacity);
+
+  if (admission->tokens < ADMISSION_TOKEN) {
+    return false;
+  }
+  admission->tokens -= ADMISSION_TOKEN;
+  return true;
+}
+
+static bool push(const MeasurementType type, const void *data, admission_t *admission)
+{
+  if (!measurementRingPush(&rings[type], data)) {
+    admission->stats.dropped++;
+    return false;
+  }
+  admission->stats.admitted++;
+  return true;
+}
+
+// Queue a pending merged measurement that has waited for the burst window,
+// spending a token if there is one. Called with the producer lock held.
+static void flushPending(const MeasurementType type, admission_t *admission, const uint32_t now)
+{
+  takeToken(admission, budgets[type], now);
+  admission->pendingCount = 0;
+  push(type, admission->pending, admission);
+}
+
+// Called with the producer lock of the type held, or by the single producer
+// of a type that shares no admission state with the consumer
+static bool admit(const MeasurementType type, const void *data, const uint16_t budget)
+{
+  admission_t *admission = &admissions[type];
+
+  if (budget == 0) {
+    return push(type, data, admission);
+  }
+
+  const uint32_t now = k_uptime_get_32();
+  const size_t size = rings[type].itemSize;
+
+  if (!isMergeable(type)) {
+    if (!takeToken(admission, budget, now)) {
+      admission->stats.dropped++;
+      return false;
+    }
+    return push(type, data, admission);
+  }
+
+  if (admission->pendingCount > 0 && now - admission->pendingSince >= ADMISSION_BURST_MS) {
+    // Waited long enough, queue it before starting a new one
+    flushPending(type, admission, now);
+  }
+
+  if (admission->pendingCount == 0) {
+    memcpy(admission->pending, data, size);
+    admission->pendingSince = now;
+  } else {
+    merge(type, admission->pending, data, admission->pendingCount);
+    admission->stats.merged++;
+  }
+  admission->pendingCount++;
+
+  if (takeToken(admission, budget, now)) {
+    admission->pendingCount = 0;
+    return push(type, admission->pending, admission);
+  }
+  return true;
+}
+
+void estimatorEnqueue(const measurement_t *measurement)
+{
+  estimatorEnqueueData(measurement->type, &measurement->data);
+}
+
+bool estimatorEnqueueData(const MeasurementType type, const void *data)
+{
+  if (type >= MeasurementType_COUNT) {
+    return false;
+  }
+
+  if (type == MeasurementTypeGyroscope) {
+    // The sensors queue each gyro sample as soon as it is read
+    rateLoopImuDataReady(&((const gyroscopeMeasurement_t*)data)->gyro);
+  }
+
+  // The consumer only touches the admission state of a type with a merged
+  // measurement pending, and only its single producer starts one
+  const uint16_t budget = budgets[type];
+  const bool shared = isMergeable(type) && (budget != 0 || admissions[type].pendingCount != 0);
+
+  bool queued = false;
+  if (!isMultiProducer(type) && !shared) {
+    // Flagged before the replay check, see estimatorQueueSetReplay()
+    __atomic_store_n(&pushing[type], 1, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&replayActive, __ATOMIC_SEQ_CST)) {
+      queued = admit(type, data, budget);
+    }
+    __atomic_store_n(&pushing[type], 0, __ATOMIC_RELEASE);
+    return queued;
+  }
+
+  k_spinlock_key_t key = k_spin_lock(&producerLocks[type]);
+  if (!replayActive) {
+    queued = admit(type, data, budget);
+  }
+  k_spin_unlock(&producerLocks[type], key);
+
+  return queued;
+}
+
+bool estimatorEnqueueReplay(const MeasurementType type, const void *data)
+{
+  if (type >= MeasurementType_COUNT) {
+    return false;
+  }
+
+  bool queued = false;
+  k_spinlock_key_t key = k_spin_lock(&producerLocks[type]);
+  if (replayActive) {
+    queued = measurementRingPush(&rings[type], data);
+  }
+  k_spin_unlock(&producerLocks[type], key);
+
+  return queued;
+}
+
+void estimatorQueueSetReplay(bool active)
+{
+  __atomic_store_n(&replayActive, active, __ATOMIC_SEQ_CST);
+
+  // A producer that checked the flag before it changed has pushed by the time
+  // its lock is free, or its flag is cleared for one without the lock.
+  // Everything up to the head now belongs to the other side.
+  for (int i = 0; i < MeasurementType_COUNT; i++) {
+    while (__atomic_load_n(&pushing[i], __ATOMIC_SEQ_CST)) {
+      // The producer may be of a lower priority
+      k_msleep(1);
+    }
+    k_spinlock_key_t key = k_spin_lock(&producerLocks[i]);
+    flushHeads[i] = rings[i].head;
+    admissions[i].pendingCount = 0;
+    k_spin_unlock(&producerLocks[i], key);
+  }
+
+  __atomic_add_fetch(&flushGeneration, 1, __ATOMIC_RELEASE);
+}
+
+// Queue the merged measurements of sensors that stopped sending, from the
+// consumer side
+static void flushStalePending(const MeasurementType type)
+{
+  admission_t *admission = &admissions[type];
+  if (admission->pendingCount == 0) {
+    return;
+  }
+
+  k_spinlock_key_t key = k_spin_lock(&producerLocks[type]);
+  const uint32_t now = k_uptime_get_32();
+  if (admission->pendingCount > 0 && now - admission->pendingSince >= ADMISSION_BURST_MS && !replayActive) {
+    flushPending(type, admission, now);
+  }
+  k_spin_unlock(&producerLocks[type], key);
+}
+
+// Drop the items queued before the last handover, from the consumer side
+static void drainFlushed(void)
+{
+  uint32_t generation = __atomic_load_n(&flushGeneration, __ATOMIC_ACQUIRE);
+  if (generation == drainedGeneration) {
+    return;
+  }
+
+  uint8_t item[sizeof(((measurement_t*)0)->data)];
+  for (int i = 0; i < MeasurementType_COUNT; i++) {
+    while ((int32_t)(flushHeads[i] - rings[i].tail) > 0 && measurementRingPop(&rings[i], item)) {
+    }
+  }
+  drainedGeneration = generation;
+}
+
+bool estimatorDequeueType(const MeasurementType type, void *data)
+{
+  if (type >= MeasurementType_COUNT) {
+    return false;
+  }
+
+  drainFlushed();
+  if (isMergeable(type)) {
+    flushStalePending(type);
+  }
+  return measurementRingPop(&rings[type], data);
+}
+
+bool estimatorDequeue(measurement_t *measurement)
+{
+  drainFlushed();
+  for (int i = 0; i < MeasurementType_COUNT; i++) {
+    if (isMergeable(i)) {
+      flushStalePending(i);
+    }
+  }
+
+  for (int i = 0; i < MeasurementType_COUNT; i++) {
+    MeasurementType type = priorityOrder[i];
+    if (measurementRingPop(&rings[type], &measurement->data)) {
+      measurement->type = type;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+uint32_t estimatorGetQueueOverflows(const MeasurementType type)
+{
+  if (type >= MeasurementType_COUNT) {
+    return 0;
+  }
+
+  return rings[type].overflows;
+}
+
+const estimatorAdmissionStats_t* estimatorGetAdmissionStats(const MeasurementType type)
+{
+  if (type >= MeasurementType_COUNT) {
+    return 0;
+  }
+
+  return &admissions[type].stats;
+}
+
+void estimatorSetAdmissionBudget(const MeasurementType type, const uint16_t perSecond)
+{
+  if (type < MeasurementType_COUNT && type != MeasurementTypeGyroscope && type != MeasurementTypeAcceleration) {
+    budgets[type] = perSecond;
+  }
+}
+
+/**
+ * Measurements dropped because the queue of their type was full
+ */
+LOG_GROUP_START(estQueue)
+/**
+ * @brief Dropped TDOA measurements
+ */
+LOG_ADD(LOG_UINT32, tdoa, &rings[MeasurementTypeTDOA].overflows)
+/**
+ * @brief Dropped position measurements
+ */
+LOG_ADD(LOG_UINT32, position, &rings[MeasurementTypePosition].overflows)
+/**
+ * @brief Dropped pose measurements
+ */
+LOG_ADD(LOG_UINT32, pose, &rings[MeasurementTypePose].overflows)
+/**
+ * @brief Dropped distance measurements
+ */
+LOG_ADD(LOG_UINT32, distance, &rings[MeasurementTypeDistance].overflows)
+/**
+ * @brief Dropped TOF measurements
+ */
+LOG_ADD(LOG_UINT32, tof, &rings[MeasurementTypeTOF].overflows)
+/**
+ * @brief Dropped absolute height measurements
+ */
+LOG_ADD(LOG_UINT32, height, &rings[MeasurementTypeAbsoluteHeight].overflows)
+/**
+ * @brief Dropped flow measurements
+ */
+LOG_ADD(LOG_UINT32, flow, &rings[MeasurementTypeFlow].overflows)
+/**
+ * @brief Dropped yaw error measurements
+ */
+LOG_ADD(LOG_UINT32, yawError, &rings[MeasurementTypeYawError].overflows)
+/**
+ * @brief Dropped sweep angle measurements
+ */
+LOG_ADD(LOG_UINT32, sweep, &rings[MeasurementTypeSweepAngle].overflows)
+/**
+ * @brief Dropped gyroscope measurements
+ */
+LOG_ADD(LOG_UINT32, gyro, &rings[MeasurementTypeGyroscope].overflows)
+/**
+ * @brief Dropped accelerometer measurements
+ */
+LOG_ADD(LOG_UINT32, acc, &rings[MeasurementTypeAcceleration].overflows)
+/**
+ * @brief Dropped barometer measurements
+ */
+LOG_ADD(LOG_UINT32, baro, &rings[MeasurementTypeBarometer].overflows)
+LOG_GROUP_STOP(estQueue)
+
+/**
+ * Admission of measurements into the estimator queues. A measurement is
+ * admitted when it is queued, merged when it is folded into a measurement
+ * queued later, and dropped when it exceeds the budget of its type or the
+ * queue is full.
+ */
+LOG_GROUP_START(estAdmit)
+/**
+ * @brief Admitted TDOA measurements
+ */
+LOG_ADD(LOG_UINT32, tdoaAdm, &admissions[MeasurementTypeTDOA].stats.admitted)
+/**
+ * @brief Dropped TDOA measurements
+ */
+LOG_ADD(LOG_UINT32, tdoaDrop, &admissions[MeasurementTypeTDOA].stats.dropped)
+/**
+ * @brief Admitted distance measurements
+ */
+LOG_ADD(LOG_UINT32, distAdm, &admissions[MeasurementTypeDistance].stats.admitted)
+/**
+ * @brief Dropped distance measurements
+ */
+LOG_ADD(LOG_UINT32, distDrop, &admissions[MeasurementTypeDistance].stats.dropped)
+/**
+ * @brief Admitted TOF measurements
+ */
+LOG_ADD(LOG_UINT32, tofAdm, &admissions[MeasurementTypeTOF].stats.admitted)
+/**
+ * @brief Merged TOF measurements
+ */
+LOG_ADD(LOG_UINT32, tofMerge, &admissions[MeasurementTypeTOF].stats.merged)
+/**
+ * @brief Dropped TOF measurements
+ */
+LOG_ADD(LOG_UINT32, tofDrop, &admissions[MeasurementTypeTOF].stats.dropped)
+/**
+ * @brief Admitted flow measurements
+ */
+LOG_ADD(LOG_UINT32, flowAdm, &admissions[MeasurementTypeFlow].stats.admitted)
+/**
+ * @brief Merged flow measurements
+ */
+LOG_ADD(LOG_UINT32, flowMerge, &admissions[MeasurementTypeFlow].stats.merged)
+/**
+ * @brief Dropped flow measurements
+ */
+LOG_ADD(LOG_UINT32, flowDrop, &admissions[MeasurementTypeFlow].stats.dropped)
+/**
+ * @brief Admitted sweep angle measurements
+ */
+LOG_ADD(LOG_UINT32, sweepAdm, &admissions[MeasurementTypeSweepAngle].stats.admitted)
+/**
+ * @brief Dropped sweep angle measurements
+ */
+LOG_ADD(LOG_UINT32, sweepDrop, &admissions[MeasurementTypeSweepAngle].stats.dropped)
+/**
+ * @brief Admitted barometer measurements
+ */
+LOG_ADD(LOG_UINT32, baroAdm, &admissions[MeasurementTypeBarometer].stats.admitted)
+/**
+ * @brief Merged barometer measurements
+ */
+LOG_ADD(LOG_UINT32, baroMerge, &admissions[MeasurementTypeBarometer].stats.merged)
+/**
+ * @brief Dropped barometer measurements
+ */
+LOG_ADD(LOG_UINT32, baroDrop, &admissions[MeasurementTypeBarometer].stats.dropped)
+LOG_GROUP_STOP(estAdmit)
+
+/**
+ * Budgets of the measurement types, in measurements per second. Zero admits
+ * every measurement. The gyroscope and accelerometer have no budget.
+ */
+PARAM_GROUP_START(estAdmit)
+/**
+ * @brief Budget of TDOA measurements (default: 0)
+ */
+PARAM_ADD(PARAM_UINT16, tdoa, &budgets[MeasurementTypeTDOA])
+/**
+ * @brief Budget of external position measurements (default: 0)
+ */
+PARAM_ADD(PARAM_UINT16, position, &budgets[MeasurementTypePosition])
+/**
+ * @brief Budget of external pose measurements (default: 0)
+ */
+PARAM_ADD(PARAM_UINT16, pose, &budgets[MeasurementTypePose])
+/**
+ * @brief Budget of distance measurements (default: 0)
+ */
+PARAM_ADD(PARAM_UINT16, distance, &budgets[MeasurementTypeDistance])
+/**
+ * @brief Budget of TOF measurements, merged by averaging (default: 0)
+ */
+PARAM_ADD(PARAM_UINT16, tof, &budgets[MeasurementTypeTOF])
+/**
+ * @brief Budget of absolute height measurements, merged by averaging (default: 0)
+ */
+PARAM_ADD(PARAM_UINT16, height, &budgets[MeasurementTypeAbsoluteHeight])
+/**
+ * @brief Budget of flow measurements, merged by accumulating pixels (default: 0)
+ */
+PARAM_ADD(PARAM_UINT16, flow, &budgets[MeasurementTypeFlow])
+/**
+ * @brief Budget of yaw error measurements, merged by averaging (default: 0)
+ */
+PARAM_ADD(PARAM_UINT16, yawError, &budgets[MeasurementTypeYawError])
+/**
+ * @brief Budget of lighthouse sweep angle measurements (default: 0)
+ */
+PARAM_ADD(PARAM_UINT16, sweep, &budgets[MeasurementTypeSweepAngle])
+/**
+ * @brief Budget of barometer measurements, merged by averaging (default: 0)
+ */
+PARAM_ADD(PARAM_UINT16, baro, &budgets[MeasurementTypeBarometer])
+PARAM_GROUP_STOP(estAdmit)
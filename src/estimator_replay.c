@@ -0,0 +1,334 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * estimator_replay.c - Run the state estimator on recorded measurements
+ *
+ * A trace of measurements, estimator ticks and ground truth positions is
+ * uploaded through the memory subsystem. The replay feeds it to the
+ * estimator as fast as it runs, times every stateEstimator() call and
+ * compares the estimate with the ground truth. Built for native_sim, the same
+ * replay runs on the host at many times real time.
+ *
+ * The replay owns the estimator for its whole run. The stabilizer runs the
+ * live estimator through estimatorReplayLiveUpdate(), which skips it meanwhile.
+ */
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/timing/timing.h>
+
+#include "config.h"
+#include "estimator_replay.h"
+#include "estimator.h"
+#include "system.h"
+#include "mem.h"
+
+#include "param.h"
+#include "log.h"
+
+static bool isInit;
+static volatile bool isActive;
+
+static uint8_t input[ESTIMATOR_REPLAY_INPUT_SIZE];
+static replayStateRecord_t output[ESTIMATOR_REPLAY_OUTPUT_RECORDS];
+
+static uint8_t runRequest;
+static uint8_t replayEstimator; // StateEstimatorType to replay, 0 for the active one
+
+// The estimators run with the stack of the estimator task in mind, far more
+// than the system workqueue has, so the replay runs in a thread of its own
+K_THREAD_STACK_DEFINE(estimatorReplayTaskStack, ESTIMATOR_REPLAY_TASK_STACKSIZE);
+static struct k_thread estimatorReplayTaskThread;
+static K_SEM_DEFINE(replayStart, 0, 1);
+
+// Held by the stabilizer around each live estimator update, and by a replay
+// for its whole run
+static K_MUTEX_DEFINE(estimatorOwner);
+
+// Results of the last replay
+static uint8_t lastError;
+static uint32_t ticks;
+static uint32_t avgCycles;
+static uint32_t maxCycles;
+static float positionErrorRms; // m
+static uint32_t skippedRecords;
+
+static uint32_t handleMemGetSize(void) { return sizeof(input) + sizeof(output); }
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* buffer);
+static bool handleMemWrite(const uint32_t memAddr, const uint8_t writeLen, const uint8_t* buffer);
+static const MemoryHandlerDef_t memDef = {
+  .type = MEM_TYPE_ESTIMATOR_REPLAY,
+  .getSize = handleMemGetSize,
+  .read = handleMemRead,
+  .write = handleMemWrite,
+};
+
+// Measurement types whose data can be replayed. Sweep angles point to the
+// calibration of the lighthouse deck and can not be recorded as plain data.
+static bool isReplayable(MeasurementType type, uint16_t length)
+{
+  const measurement_t* m = 0;
+  switch (type) {
+    case MeasurementTypeTDOA: return length == sizeof(m->data.tdoa);
+    case MeasurementTypePosition: return length == sizeof(m->data.position);
+    case MeasurementTypePose: return length == sizeof(m->data.pose);
+    case MeasurementTypeDistance: return length == sizeof(m->data.distance);
+    case MeasurementTypeTOF: return length == sizeof(m->data.tof);
+    case MeasurementTypeAbsoluteHeight: return length == sizeof(m->data.height);
+    case MeasurementTypeFlow: return length == sizeof(m->data.flow);
+    case MeasurementTypeYawError: return length == sizeof(m->data.yawError);
+    case MeasurementTypeGyroscope: return length == sizeof(m->data.gyroscope);
+    case MeasurementTypeAcceleration: return length == sizeof(m->data.acceleration);
+    case MeasurementTypeBarometer: return length == sizeof(m->data.barometer);
+    default: return false;
+  }
+}
+
+static int replay(void)
+{
+  state_t state;
+  uint8_t data[sizeof(((measurement_t*)0)->data)] __attribute__((aligned(4)));
+  uint64_t totalCycles = 0;
+  float squaredError = 0;
+  uint32_t groundTruths = 0;
+  uint32_t offset = 0;
+
+  memset(&state, 0, sizeof(state));
+  memset(output, 0, sizeof(output));
+  ticks = 0;
+  maxCycles = 0;
+  skippedRecords = 0;
+
+  while (offset + sizeof(replayRecordHeader_t) <= sizeof(input)) {
+    replayRecordHeader_t header;
+    memcpy(&header, &input[offset], sizeof(header));
+    offset += sizeof(header);
+
+    if (header.kind == ReplayRecordEnd) {
+      break;
+    }
+    if (offset + header.length > sizeof(input) || header.length > sizeof(data)) {
+      return EINVAL;
+    }
+    memcpy(data, &input[offset], header.length);
+    offset += header.length;
+
+    switch (header.kind) {
+      case ReplayRecordMeasurement:
+        if (!isReplayable(header.type, header.length) || !estimatorEnqueueReplay(header.type, data)) {
+          skippedRecords++;
+        }
+        break;
+      case ReplayRecordTick: {
+        uint32_t tick;
+        memcpy(&tick, data, sizeof(tick));
+
+        timing_t start = timing_counter_get();
+        stateEstimator(&state, tick);
+        timing_t end = timing_counter_get();
+
+        uint32_t cycles = (uint32_t)timing_cycles_get(&start, &end);
+        totalCycles += cycles;
+        maxCycles = MAX(maxCycles, cycles);
+
+        if (ticks < ESTIMATOR_REPLAY_OUTPUT_RECORDS) {
+          output[ticks] = (replayStateRecord_t){
+            .tick = tick,
+            .x = state.position.x, .y = state.position.y, .z = state.position.z,
+            .roll = state.attitude.roll, .pitch = state.attitude.pitch, .yaw = state.attitude.yaw,
+          };
+        }
+        ticks++;
+        break;
+      }
+      case ReplayRecordGroundTruth: {
+        replayGroundTruth_t truth;
+        if (header.length != sizeof(truth)) {
+          return EINVAL;
+        }
+        memcpy(&truth, data, sizeof(truth));
+        float dx = state.position.x - truth.x;
+        float dy = state.position.y - truth.y;
+        float dz = state.position.z - truth.z;
+        squaredError += dx * dx + dy * dy + dz * dz;
+        groundTruths++;
+        break;
+      }
+      default:
+        skippedRecords++;
+        break;
+    }
+  }
+
+  avgCycles = ticks > 0 ? totalCycles / ticks : 0;
+  positionErrorRms = groundTruths > 0 ? sqrtf(squaredError / groundTruths) : 0.0f;
+  return 0;
+}
+
+int estimatorReplayRun(void)
+{
+  if (systemIsArmed()) {
+    return EBUSY;
+  }
+
+  k_mutex_lock(&estimatorOwner, K_FOREVER);
+  StateEstimatorType liveEstimator = stateEstimatorGetType();
+  isActive = true;
+  estimatorQueueSetReplay(true);
+
+  // Start from a fresh estimator, as at boot
+  if (replayEstimator != StateEstimatorTypeAutoSelect && replayEstimator < StateEstimatorType_COUNT) {
+    stateEstimatorSwitchTo(replayEstimator);
+  } else {
+    stateEstimatorSwitchTo(liveEstimator);
+  }
+
+  timing_init();
+  timing_start();
+  int result = replay();
+  timing_stop();
+
+  estimatorQueueSetReplay(false);
+  stateEstimatorSwitchTo(liveEstimator);
+  isActive = false;
+  k_mutex_unlock(&estimatorOwner);
+
+  return result;
+}
+
+bool estimatorReplayIsActive(void)
+{
+  return isActive;
+}
+
+bool estimatorReplayLiveUpdate(state_t *state, const uint32_t tick)
+{
+  if (k_mutex_lock(&estimatorOwner, K_NO_WAIT) != 0) {
+    return false;
+  }
+
+  stateEstimator(state, tick);
+  k_mutex_unlock(&estimatorOwner);
+  return true;
+}
+
+static void estimatorReplayTask(void *p1, void *p2, void *p3)
+{
+  while (1) {
+    k_sem_take(&replayStart, K_FOREVER);
+    lastError = estimatorReplayRun();
+  }
+}
+
+static void replayRequested(void)
+{
+  if (runRequest && isInit && !isActive) {
+    k_sem_give(&replayStart);
+  }
+  runRequest = 0;
+}
+
+void estimatorReplayInit(void)
+{
+  if (isInit) {
+    return;
+  }
+
+  memoryRegisterHandler(&memDef);
+
+  k_thread_create(&estimatorReplayTaskThread, estimatorReplayTaskStack,
+                  K_THREAD_STACK_SIZEOF(estimatorReplayTaskStack),
+                  estimatorReplayTask,
+                  NULL, NULL, NULL,
+                  ESTIMATOR_REPLAY_TASK_PRI, 0, K_NO_WAIT);
+  k_thread_name_set(&estimatorReplayTaskThread, ESTIMATOR_REPLAY_TASK_NAME);
+
+  isInit = true;
+}
+
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* buffer)
+{
+  if (memAddr + readLen > sizeof(input) + sizeof(output)) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < readLen; i++) {
+    uint32_t address = memAddr + i;
+    buffer[i] = address < sizeof(input) ? input[address] : ((uint8_t*)output)[address - sizeof(input)];
+  }
+  return true;
+}
+
+static bool handleMemWrite(const uint32_t memAddr, const uint8_t writeLen, const uint8_t* buffer)
+{
+  if (isActive || memAddr + writeLen > sizeof(input)) {
+    return false;
+  }
+
+  memcpy(&input[memAddr], buffer, writeLen);
+  return true;
+}
+
+/**
+ * Replay of recorded measurements through the state estimator
+ */
+PARAM_GROUP_START(estReplay)
+/**
+ * @brief Set to non-zero to replay the uploaded trace while disarmed
+ */
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT8, run, &runRequest, &replayRequested)
+/**
+ * @brief Estimator to replay with, 0 for the active one
+ */
+PARAM_ADD(PARAM_UINT8, estimator, &replayEstimator)
+PARAM_GROUP_STOP(estReplay)
+
+/**
+ * Results of the last replay
+ */
+LOG_GROUP_START(estReplay)
+/**
+ * @brief Error of the last replay, EBUSY if armed, EINVAL for a malformed trace
+ */
+LOG_ADD(LOG_UINT8, error, &lastError)
+/**
+ * @brief Number of stateEstimator() calls
+ */
+LOG_ADD(LOG_UINT32, ticks, &ticks)
+/**
+ * @brief Average cost of a stateEstimator() call [cycles]
+ */
+LOG_ADD(LOG_UINT32, avgCycles, &avgCycles)
+/**
+ * @brief Worst-case cost of a stateEstimator() call [cycles]
+ */
+LOG_ADD(LOG_UINT32, maxCycles, &maxCycles)
+/**
+ * @brief RMS of the position error against the ground truth records [m]
+ */
+LOG_ADD(LOG_FLOAT, posErr, &positionErrorRms)
+/**
+ * @brief Records that could not be replayed
+ */
+LOG_ADD(LOG_UINT32, skipped, &skippedRecords)
+LOG_GROUP_STOP(estReplay)
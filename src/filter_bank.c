@@ -0,0 +1,104 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * filter_bank.c - Cascaded biquad filters on 3-axis vectors
+ */
+#include <math.h>
+#include <string.h>
+
+#include "filter_bank.h"
+
+static void initInstances(filterBank3_t* bank)
+{
+  for (int i = 0; i < 3; i++) {
+    arm_biquad_cascade_df2T_init_f32(&bank->axis[i], bank->stages, bank->coeffs,
+                                     &bank->state[i * 2 * FILTER_BANK_MAX_STAGES]);
+  }
+}
+
+void filterBank3Init(filterBank3_t* bank)
+{
+  memset(bank, 0, sizeof(*bank));
+  initInstances(bank);
+}
+
+static float32_t* addStage(filterBank3_t* bank)
+{
+  if (bank->stages >= FILTER_BANK_MAX_STAGES) {
+    return 0;
+  }
+
+  float32_t* coeffs = &bank->coeffs[5 * bank->stages];
+  bank->stages++;
+  return coeffs;
+}
+
+bool filterBank3AddLowPass(filterBank3_t* bank, float sampleFreq, float cutoffFreq)
+{
+  float32_t* coeffs = addStage(bank);
+  if (!coeffs) {
+    return false;
+  }
+
+  float fr = sampleFreq / cutoffFreq;
+  float ohm = tanf(PI / fr);
+  float c = 1.0f + 2.0f * cosf(PI / 4.0f) * ohm + ohm * ohm;
+  coeffs[0] = ohm * ohm / c;
+  coeffs[1] = 2.0f * coeffs[0];
+  coeffs[2] = coeffs[0];
+  coeffs[3] = -2.0f * (ohm * ohm - 1.0f) / c;
+  coeffs[4] = -(1.0f - 2.0f * cosf(PI / 4.0f) * ohm + ohm * ohm) / c;
+
+  initInstances(bank);
+  return true;
+}
+
+void filterBankNotchCoeffs(float32_t coeffs[5], float sampleFreq, float centerFreq, float q)
+{
+  float w0 = 2.0f * PI * centerFreq / sampleFreq;
+  float alpha = sinf(w0) / (2.0f * q);
+  float cosw0 = cosf(w0);
+  float a0 = 1.0f + alpha;
+
+  coeffs[0] = 1.0f / a0;
+  coeffs[1] = -2.0f * cosw0 / a0;
+  coeffs[2] = 1.0f / a0;
+  coeffs[3] = 2.0f * cosw0 / a0;
+  coeffs[4] = -(1.0f - alpha) / a0;
+}
+
+bool filterBank3AddNotch(filterBank3_t* bank, float sampleFreq, float centerFreq, float q)
+{
+  float32_t* coeffs = addStage(bank);
+  if (!coeffs) {
+    return false;
+  }
+
+  filterBankNotchCoeffs(coeffs, sampleFreq, centerFreq, q);
+
+  initInstances(bank);
+  return true;
+}
+
+void filterBank3Reset(filterBank3_t* bank)
+{
+  memset(bank->state, 0, sizeof(bank->state));
+}
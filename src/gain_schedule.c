@@ -0,0 +1,273 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * gain_schedule.c - Gain scheduling of the PID controller by thrust and battery voltage
+ *
+ * The table is uploaded through the memory subsystem, persisted in the
+ * storage when gainSched.store is set and cached in RAM. The grid is uniform,
+ * so a lookup computes the cell directly from the inputs.
+ *
+ * Uploads go to a staging copy, which replaces the table used by the
+ * controller when the last byte of the table is written, unless the table is
+ * not valid.
+ */
+#include <math.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+
+#include "gain_schedule.h"
+#include "storage.h"
+#include "mem.h"
+#include "math3d.h"
+
+#include "param.h"
+#include "log.h"
+
+#define STORAGE_KEY "gainSched/table"
+
+static bool isInit;
+static uint8_t enabled;
+static uint8_t storeRequest;
+static uint8_t storeFailed;
+
+// Table of the lookups, with the cached reciprocals of its grid steps
+static struct k_spinlock tableLock;
+static gainScheduleTable_t table;
+static float thrustInvStep;
+static float vbatInvStep;
+
+// Target of the memory reads and writes
+static gainScheduleTable_t upload;
+
+// Last lookup, for logging
+static gainScale_t lastScale = {1.0f, 1.0f, 1.0f};
+
+static uint32_t handleMemGetSize(void) { return sizeof(upload); }
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* buffer);
+static bool handleMemWrite(const uint32_t memAddr, const uint8_t writeLen, const uint8_t* buffer);
+static const MemoryHandlerDef_t memDef = {
+  .type = MEM_TYPE_GAIN_SCHEDULE,
+  .getSize = handleMemGetSize,
+  .read = handleMemRead,
+  .write = handleMemWrite,
+};
+
+static float invStep(float min, float max, int points)
+{
+  float range = max - min;
+  return range > 0.0f ? (points - 1) / range : 0.0f;
+}
+
+static bool isValidScale(float scale)
+{
+  return isfinite(scale) && scale > 0.0f;
+}
+
+// The grid has to span a range and the scales have to be positive, a zero or
+// NaN scale would silence the controller
+static bool isValidTable(const gainScheduleTable_t* t)
+{
+  if (!isfinite(t->thrustMin) || !isfinite(t->thrustMax) || !(t->thrustMax > t->thrustMin)) {
+    return false;
+  }
+  if (!isfinite(t->vbatMin) || !isfinite(t->vbatMax) || !(t->vbatMax > t->vbatMin)) {
+    return false;
+  }
+  for (int v = 0; v < GAIN_SCHEDULE_VBAT_POINTS; v++) {
+    for (int i = 0; i < GAIN_SCHEDULE_THRUST_POINTS; i++) {
+      const gainScale_t* scale = &t->scale[v][i];
+      if (!isValidScale(scale->rateRollPitch) || !isValidScale(scale->rateYaw) || !isValidScale(scale->positionXy)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Replace the table of the lookups with the uploaded one
+static void publishUpload(void)
+{
+  float thrustStep = invStep(upload.thrustMin, upload.thrustMax, GAIN_SCHEDULE_THRUST_POINTS);
+  float vbatStep = invStep(upload.vbatMin, upload.vbatMax, GAIN_SCHEDULE_VBAT_POINTS);
+
+  k_spinlock_key_t key = k_spin_lock(&tableLock);
+  table = upload;
+  thrustInvStep = thrustStep;
+  vbatInvStep = vbatStep;
+  k_spin_unlock(&tableLock, key);
+}
+
+static void setDefaultTable(void)
+{
+  upload.thrustMin = 0.0f;
+  upload.thrustMax = 65535.0f;
+  upload.vbatMin = 3.0f;
+  upload.vbatMax = 4.2f;
+  for (int v = 0; v < GAIN_SCHEDULE_VBAT_POINTS; v++) {
+    for (int t = 0; t < GAIN_SCHEDULE_THRUST_POINTS; t++) {
+      upload.scale[v][t] = (gainScale_t){1.0f, 1.0f, 1.0f};
+    }
+  }
+}
+
+void gainScheduleInit(void)
+{
+  if (isInit) {
+    return;
+  }
+
+  if (storageFetch(STORAGE_KEY, &upload, sizeof(upload)) != sizeof(upload) || !isValidTable(&upload)) {
+    setDefaultTable();
+  }
+  publishUpload();
+
+  memoryRegisterHandler(&memDef);
+
+  isInit = true;
+}
+
+bool gainScheduleTest(void)
+{
+  return isInit;
+}
+
+// Cell index and fraction within the cell of x on a grid with the given number of points
+static int gridCell(float x, float min, float invStep, int points, float* fraction)
+{
+  float position = clamp((x - min) * invStep, 0.0f, points - 1);
+  int index = (int)position;
+  if (index > points - 2) {
+    index = points - 2;
+  }
+  *fraction = position - index;
+  return index;
+}
+
+static float bilinear(float s00, float s01, float s10, float s11, float ft, float fv)
+{
+  float s0 = s00 + (s01 - s00) * ft;
+  float s1 = s10 + (s11 - s10) * ft;
+  return s0 + (s1 - s0) * fv;
+}
+
+void gainScheduleLookup(float thrust, float vbat, gainScale_t *scale)
+{
+  if (!enabled) {
+    *scale = (gainScale_t){1.0f, 1.0f, 1.0f};
+    return;
+  }
+
+  float ft, fv;
+  k_spinlock_key_t key = k_spin_lock(&tableLock);
+  int t = gridCell(thrust, table.thrustMin, thrustInvStep, GAIN_SCHEDULE_THRUST_POINTS, &ft);
+  int v = gridCell(vbat, table.vbatMin, vbatInvStep, GAIN_SCHEDULE_VBAT_POINTS, &fv);
+
+  const gainScale_t* s00 = &table.scale[v][t];
+  const gainScale_t* s01 = &table.scale[v][t + 1];
+  const gainScale_t* s10 = &table.scale[v + 1][t];
+  const gainScale_t* s11 = &table.scale[v + 1][t + 1];
+
+  scale->rateRollPitch = bilinear(s00->rateRollPitch, s01->rateRollPitch, s10->rateRollPitch, s11->rateRollPitch, ft, fv);
+  scale->rateYaw = bilinear(s00->rateYaw, s01->rateYaw, s10->rateYaw, s11->rateYaw, ft, fv);
+  scale->positionXy = bilinear(s00->positionXy, s01->positionXy, s10->positionXy, s11->positionXy, ft, fv);
+  k_spin_unlock(&tableLock, key);
+
+  lastScale = *scale;
+}
+
+static bool handleMemRead(const uint32_t memAddr, const uint8_t readLen, uint8_t* buffer)
+{
+  if (memAddr + readLen > sizeof(upload)) {
+    return false;
+  }
+  memcpy(buffer, (uint8_t*)&upload + memAddr, readLen);
+  return true;
+}
+
+static bool handleMemWrite(const uint32_t memAddr, const uint8_t writeLen, const uint8_t* buffer)
+{
+  if (memAddr + writeLen > sizeof(upload)) {
+    return false;
+  }
+  memcpy((uint8_t*)&upload + memAddr, buffer, writeLen);
+  if (memAddr + writeLen == sizeof(upload)) {
+    if (!isValidTable(&upload)) {
+      // Reads back the table in use
+      k_spinlock_key_t key = k_spin_lock(&tableLock);
+      upload = table;
+      k_spin_unlock(&tableLock, key);
+      return false;
+    }
+    publishUpload();
+  }
+  return true;
+}
+
+static void storeTable(void)
+{
+  if (storeRequest) {
+    storeRequest = 0;
+    static gainScheduleTable_t stored;
+    k_spinlock_key_t key = k_spin_lock(&tableLock);
+    stored = table;
+    k_spin_unlock(&tableLock, key);
+    storeFailed = !storageStore(STORAGE_KEY, &stored, sizeof(stored));
+  }
+}
+
+/**
+ * Gain scheduling of the PID controller by thrust and battery voltage. The
+ * table is uploaded through the memory subsystem.
+ */
+PARAM_GROUP_START(gainSched)
+/**
+ * @brief Non-zero to scale the PID outputs by the gain table. The scale
+ * applies to the P, I and D terms alike, after the output limits of the PIDs.
+ */
+PARAM_ADD(PARAM_UINT8, enable, &enabled)
+/**
+ * @brief Set to non-zero to persist the current gain table in the storage
+ */
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT8, store, &storeRequest, &storeTable)
+PARAM_GROUP_STOP(gainSched)
+
+/**
+ * Scales of the last gain table lookup
+ */
+LOG_GROUP_START(gainSched)
+/**
+ * @brief Scale of the roll and pitch rate PIDs
+ */
+LOG_ADD(LOG_FLOAT, rate, &lastScale.rateRollPitch)
+/**
+ * @brief Scale of the yaw rate PID
+ */
+LOG_ADD(LOG_FLOAT, yaw, &lastScale.rateYaw)
+/**
+ * @brief Scale of the x and y position PIDs
+ */
+LOG_ADD(LOG_FLOAT, pos, &lastScale.positionXy)
+/**
+ * @brief Non-zero if the last store to the storage failed
+ */
+LOG_ADD(LOG_UINT8, storeErr, &storeFailed)
+LOG_GROUP_STOP(gainSched)
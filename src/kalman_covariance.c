@@ -0,0 +1,155 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * kalman_covariance.c - Sparse covariance updates of an extended Kalman filter
+ */
+#include <string.h>
+
+#include "kalman_covariance.h"
+#include <zephyr/sys/__assert.h>
+
+void kalmanCovInit(kalmanCovariance_t* cov, uint8_t n, const float* variances)
+{
+  __ASSERT(n <= KC_COV_MAX_STATES, "kalman covariance - too many states");
+
+  memset(cov, 0, sizeof(*cov));
+  cov->n = n;
+  for (int i = 0; i < n; i++) {
+    cov->p[kalmanCovIndex(cov, i, i)] = variances[i];
+  }
+}
+
+void kalmanCovPredict(kalmanCovariance_t* cov, const kalmanSparseEntry_t* f, int count, const float* processNoise)
+{
+  const int n = cov->n;
+  float p[KC_COV_MAX_STATES][KC_COV_MAX_STATES];
+  float fp[KC_COV_MAX_STATES][KC_COV_MAX_STATES];
+
+  // Unpack P
+  float* packed = cov->p;
+  for (int i = 0; i < n; i++) {
+    for (int j = i; j < n; j++) {
+      p[i][j] = p[j][i] = *packed++;
+    }
+  }
+
+  // F P, one row of P per non-zero entry of F
+  memset(fp, 0, sizeof(fp));
+  for (int e = 0; e < count; e++) {
+    const float v = f[e].value;
+    float* dst = fp[f[e].row];
+    const float* src = p[f[e].col];
+    for (int k = 0; k < n; k++) {
+      dst[k] += v * src[k];
+    }
+  }
+
+  // (F P) F', upper triangle only: entry (r, c) of F adds to column r
+  memset(cov->p, 0, sizeof(cov->p));
+  for (int e = 0; e < count; e++) {
+    const int r = f[e].row;
+    const int c = f[e].col;
+    const float v = f[e].value;
+    for (int i = 0; i <= r; i++) {
+      cov->p[kalmanCovIndex(cov, i, r)] += fp[i][c] * v;
+    }
+  }
+
+  if (processNoise) {
+    for (int i = 0; i < n; i++) {
+      cov->p[kalmanCovIndex(cov, i, i)] += processNoise[i];
+    }
+  }
+}
+
+void kalmanCovScalarUpdate(kalmanCovariance_t* cov, const uint8_t* index, const float* h, int count,
+                           float error, float stdMeasNoise, float* stateDelta)
+{
+  const int n = cov->n;
+  const float r = stdMeasNoise * stdMeasNoise;
+  float pht[KC_COV_MAX_STATES];
+  float k[KC_COV_MAX_STATES];
+
+  // P H', only the columns of P that H touches
+  for (int i = 0; i < n; i++) {
+    float sum = 0;
+    for (int m = 0; m < count; m++) {
+      sum += kalmanCovGet(cov, i, index[m]) * h[m];
+    }
+    pht[i] = sum;
+  }
+
+  // S = H P H' + R
+  float s = r;
+  for (int m = 0; m < count; m++) {
+    s += h[m] * pht[index[m]];
+  }
+
+  // K = P H' / S
+  const float sInv = 1.0f / s;
+  for (int i = 0; i < n; i++) {
+    k[i] = pht[i] * sInv;
+    stateDelta[i] += k[i] * error;
+  }
+
+  // A P with A = I - K H. H P is (P H')', so this is P - K (P H')'. It is not
+  // symmetric, so all of it is kept.
+  float ap[KC_COV_MAX_STATES][KC_COV_MAX_STATES];
+  for (int i = 0; i < n; i++) {
+    const float ki = k[i];
+    for (int j = 0; j < n; j++) {
+      ap[i][j] = kalmanCovGet(cov, i, j) - ki * pht[j];
+    }
+  }
+
+  // (A P) H', only the columns of A P that H touches
+  float aph[KC_COV_MAX_STATES];
+  for (int i = 0; i < n; i++) {
+    float sum = 0;
+    for (int m = 0; m < count; m++) {
+      sum += ap[i][index[m]] * h[m];
+    }
+    aph[i] = sum;
+  }
+
+  // A P A' + K R K', with A P A' = A P - (A P H') K'. Both products are taken
+  // from the rounded A P rather than cancelled against each other, which is
+  // what keeps the result positive semidefinite. The upper triangle takes the
+  // mean of (i, j) and (j, i).
+  float* packed = cov->p;
+  for (int i = 0; i < n; i++) {
+    const float ki = k[i];
+    const float kir = ki * r;
+    for (int j = i; j < n; j++) {
+      const float apat = 0.5f * ((ap[i][j] - aph[i] * k[j]) + (ap[j][i] - aph[j] * ki));
+      *packed++ = apat + kir * k[j];
+    }
+  }
+
+  for (int i = 0; i < n; i++) {
+    float* variance = &cov->p[kalmanCovIndex(cov, i, i)];
+    if (*variance > KC_COV_MAX_VARIANCE) {
+      *variance = KC_COV_MAX_VARIANCE;
+    } else if (*variance < KC_COV_MIN_VARIANCE) {
+      *variance = KC_COV_MIN_VARIANCE;
+    }
+  }
+}
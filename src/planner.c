@@ -0,0 +1,109 @@
+/*
+ *    ______
+ *   / ____/________ _____  __  ________      ______ __________ ___
+ *  / /   / ___/ __ `/_  / / / / / ___/ | /| / / __ `/ ___/ __ `__ \
+ * / /___/ /  / /_/ / / /_/ /_/ (__  )| |/ |/ / /_/ / /  / / / / / /
+ * \____/_/   \__,_/ /___/\__, /____/ |__/|__/\__,_/_/  /_/ /_/ /_/
+ *                       /____/
+ *
+ * Crazyswarm advanced control firmware for Crazyflie
+ *
+
+The MIT License (MIT)
+
+Copyright (c) 2018 Wolfgang Hoenig and James Alan Preiss
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Implementation of the on-board planners of the planning state machine
+*/
+
+#include "planner.h"
+
+int plan_go_to_waypoints_from(struct planner *p, const struct traj_eval *curr_eval, bool relative,
+	int n_waypoints, struct vec const *waypoints, float const *yaws, float const *durations, float t)
+{
+	struct vec points[PIECEWISE_MIN_SNAP_MAX_PIECES];
+	float hover_yaws[PIECEWISE_MIN_SNAP_MAX_PIECES];
+
+	if (n_waypoints < 1 || n_waypoints > PIECEWISE_MIN_SNAP_MAX_PIECES) {
+		return 1;
+	}
+
+	for (int i = 0; i < n_waypoints; ++i) {
+		points[i] = waypoints[i];
+		hover_yaws[i] = yaws[i];
+		if (relative) {
+			points[i] = vadd(points[i], curr_eval->pos);
+			hover_yaws[i] += curr_eval->yaw;
+		}
+	}
+
+	int result = piecewise_plan_min_snap(&p->planned_trajectory, p->pieces,
+		curr_eval->pos, curr_eval->yaw, curr_eval->vel, curr_eval->omega.z, curr_eval->acc,
+		n_waypoints, points, hover_yaws, durations);
+	if (result != 0) {
+		return result;
+	}
+	piecewise_prepare(&p->planned_trajectory, p->piece_start);
+	p->planned_trajectory.t_begin = t;
+
+	p->reversed = false;
+	p->state = TRAJECTORY_STATE_FLYING;
+	p->type = TRAJECTORY_TYPE_PIECEWISE;
+	p->trajectory = &p->planned_trajectory;
+	return 0;
+}
+
+int plan_land_from(struct planner *p, const struct traj_eval *curr_eval, float hover_height, float hover_yaw, float duration, float t)
+{
+	if (p->state == TRAJECTORY_STATE_IDLE) {
+		return 1;
+	}
+
+	struct vec hover_pos = mkvec(curr_eval->pos.x, curr_eval->pos.y, hover_height);
+	int result = plan_go_to_from(p, curr_eval, false, hover_pos, hover_yaw, duration, t);
+	if (result != 0) {
+		return result;
+	}
+	p->state = TRAJECTORY_STATE_LANDING;
+	return 0;
+}
+
+void plan_shift_time(struct planner *p, float dt)
+{
+	if (p->type == TRAJECTORY_TYPE_PIECEWISE_COMPRESSED) {
+		if (p->compressed_trajectory) {
+			p->compressed_trajectory->t_begin -= dt;
+		}
+	}
+	else if (p->trajectory) {
+		p->trajectory->t_begin -= dt;
+	}
+}
+
+float plan_end_time(struct planner *p)
+{
+	if (p->type == TRAJECTORY_TYPE_PIECEWISE_COMPRESSED) {
+		return p->compressed_trajectory->t_begin + piecewise_compressed_duration(p->compressed_trajectory);
+	}
+	return p->trajectory->t_begin + piecewise_duration(p->trajectory);
+}
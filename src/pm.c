@@ -43,6 +43,8 @@
 // // #include "deck.h"
 // // #include "platform_defaults.h"
 
+#include "pm.h"
+
 // // Battery time limit conversions to ticks
 // #define PM_BAT_CRITICAL_LOW_TIMEOUT   M2T(1000 * DEFAULT_BAT_LOW_DURATION_TO_TRIGGER_SEC)
 // #define PM_BAT_LOW_TIMEOUT            M2T(1000 * DEFAULT_BAT_LOW_DURATION_TO_TRIGGER_SEC)
@@ -68,10 +70,12 @@
 // #endif
 // }  __attribute__((packed)) PmSyslinkInfo;
 
-// static float     batteryVoltage;
+// Battery voltage, stays 0 (no measurement) until the syslink reports are
+// ported
+static float     batteryVoltage;
 // static uint16_t  batteryVoltageMV;
-// static float     batteryVoltageMin = 6.0;
-// static float     batteryVoltageMax = 0.0;
+static float     batteryVoltageMin = 6.0;
+static float     batteryVoltageMax = 0.0;
 
 // static float     extBatteryVoltage;
 // static uint16_t  extBatteryVoltageMV;
@@ -192,20 +196,20 @@
 // }
 
 
-// float pmGetBatteryVoltage(void)
-// {
-//   return batteryVoltage;
-// }
+float pmGetBatteryVoltage(void)
+{
+  return batteryVoltage;
+}
 
-// float pmGetBatteryVoltageMin(void)
-// {
-//   return batteryVoltageMin;
-// }
+float pmGetBatteryVoltageMin(void)
+{
+  return batteryVoltageMin;
+}
 
-// float pmGetBatteryVoltageMax(void)
-// {
-//   return batteryVoltageMax;
-// }
+float pmGetBatteryVoltageMax(void)
+{
+  return batteryVoltageMax;
+}
 
 // /*
 //  * When a module wants to register a callback to be called on shutdown they
@@ -0,0 +1,365 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * power_distribution.c - Motor mixer of the quadrotor in X configuration
+ *
+ * The legacy and force-torque outputs are mixed with precomputed 4x4 matrices
+ * through CMSIS-DSP. Forces are converted to PWM ratios through a lookup table
+ * of the inverted thrust curve of the motors, which is built once at init.
+ *
+ * With the split rate loop on, the rate task mixes its own output and writes
+ * the motors on each gyro sample. The stabilizer's control then only carries
+ * the thrust, and powerDistribution() hands the stabilizer the latest rate
+ * loop command instead, so the motors follow a single control law.
+ */
+#include <string.h>
+
+#include <zephyr/kernel.h>
+
+#include "power_distribution.h"
+#include "rate_loop.h"
+#include "motors.h"
+#include "cf_math.h"
+#include "pm.h"
+
+#include "param.h"
+#include "log.h"
+
+// Thrust curve of one motor at full battery, force = a * pwm^2 + b * pwm [N],
+// with pwm as a ratio from 0 to 1
+#define PWM_TO_THRUST_A 0.091492681f
+#define PWM_TO_THRUST_B 0.067673604f
+#define MOTOR_MAX_THRUST (PWM_TO_THRUST_A + PWM_TO_THRUST_B)
+
+// Geometry of the Crazyflie 2.x
+#define ARM_LENGTH 0.046f // m
+#define THRUST_TO_TORQUE 0.005964552f // m
+
+#define BATTERY_NOMINAL_VOLTAGE 4.2f
+#define BATTERY_MIN_VOLTAGE 2.8f
+
+// Lookup table of the PWM ratio of a thrust ratio, from 0 to 1
+#define THRUST_LUT_SIZE 33
+
+#define NR_OF_MOTORS STABILIZER_NR_OF_MOTORS
+
+// The rate task writes the motors only while the stabilizer has asked for a
+// motor command this recently, which it only does while the motors may run
+#define RATE_LOOP_PERMIT_MS 10
+
+static bool isInit;
+
+static uint32_t idleThrust;
+static uint8_t batteryCompensation = 1;
+
+// Number of caps that changed the command of each motor
+static uint32_t saturations[NR_OF_MOTORS];
+
+// Rows are the motors, columns are thrust, roll, pitch and yaw
+static float legacyMixData[NR_OF_MOTORS * 4] __attribute__((aligned(4))) = {
+  1.0f, -0.5f,  0.5f,  1.0f,
+  1.0f, -0.5f, -0.5f, -1.0f,
+  1.0f,  0.5f, -0.5f,  1.0f,
+  1.0f,  0.5f,  0.5f, -1.0f,
+};
+static arm_matrix_instance_f32 legacyMix = {NR_OF_MOTORS, 4, legacyMixData};
+
+// Rows are the motors, columns are the total thrust and the torques, filled at init
+static float forceTorqueMixData[NR_OF_MOTORS * 4] __attribute__((aligned(4)));
+static arm_matrix_instance_f32 forceTorqueMix = {NR_OF_MOTORS, 4, forceTorqueMixData};
+
+static float thrustLut[THRUST_LUT_SIZE];
+
+// Latest motor command of the split rate loop, see powerDistributionRateLoop()
+static struct k_spinlock rateLoopLock;
+static motors_thrust_uncapped_t rateLoopThrust;
+static uint32_t rateLoopPermitTime;
+static bool rateLoopPermitted;
+
+static void initForceTorqueMix(void)
+{
+  const float arm = 0.707106781f * ARM_LENGTH;
+  const float signs[NR_OF_MOTORS][3] = {
+    {-1.0f, -1.0f, -1.0f},
+    {-1.0f,  1.0f,  1.0f},
+    { 1.0f,  1.0f, -1.0f},
+    { 1.0f, -1.0f,  1.0f},
+  };
+
+  for (int i = 0; i < NR_OF_MOTORS; i++) {
+    forceTorqueMixData[i * 4 + 0] = 0.25f;
+    forceTorqueMixData[i * 4 + 1] = signs[i][0] * 0.25f / arm;
+    forceTorqueMixData[i * 4 + 2] = signs[i][1] * 0.25f / arm;
+    forceTorqueMixData[i * 4 + 3] = signs[i][2] * 0.25f / THRUST_TO_TORQUE;
+  }
+}
+
+static void initThrustLut(void)
+{
+  const float a = PWM_TO_THRUST_A;
+  const float b = PWM_TO_THRUST_B;
+
+  for (int i = 0; i < THRUST_LUT_SIZE; i++) {
+    float force = MOTOR_MAX_THRUST * i / (THRUST_LUT_SIZE - 1);
+    thrustLut[i] = (-b + sqrtf(b * b + 4.0f * a * force)) / (2.0f * a);
+  }
+}
+
+// The motor commands are 16 bit, the parameter is wider for compatibility
+static void clampIdleThrust(void)
+{
+  if (idleThrust > UINT16_MAX) {
+    idleThrust = UINT16_MAX;
+  }
+}
+
+void powerDistributionInit(void)
+{
+  if (isInit) {
+    return;
+  }
+
+  clampIdleThrust();
+
+  initForceTorqueMix();
+  initThrustLut();
+
+  isInit = true;
+}
+
+bool powerDistributionTest(void)
+{
+  return isInit;
+}
+
+// PWM ratio of a motor force [N] at full battery
+static float forceToPwm(float force)
+{
+  float position = clamp(force * ((THRUST_LUT_SIZE - 1) / MOTOR_MAX_THRUST), 0.0f, THRUST_LUT_SIZE - 1);
+  int index = (int)position;
+  if (index > THRUST_LUT_SIZE - 2) {
+    index = THRUST_LUT_SIZE - 2;
+  }
+  float fraction = position - index;
+  return thrustLut[index] + (thrustLut[index + 1] - thrustLut[index]) * fraction;
+}
+
+// The motor speed follows the average voltage, the PWM ratio times the battery voltage
+static float batteryCompensationFactor(void)
+{
+  if (!batteryCompensation) {
+    return 1.0f;
+  }
+
+  float vbat = pmGetBatteryVoltage();
+  if (vbat < BATTERY_MIN_VOLTAGE) {
+    return 1.0f;
+  }
+  return BATTERY_NOMINAL_VOLTAGE / vbat;
+}
+
+static void mix(const control_t *control, motors_thrust_uncapped_t* motorThrustUncapped)
+{
+  float input[4] __attribute__((aligned(4)));
+  float output[NR_OF_MOTORS] __attribute__((aligned(4)));
+  arm_matrix_instance_f32 inputVector = {4, 1, input};
+  arm_matrix_instance_f32 outputVector = {NR_OF_MOTORS, 1, output};
+
+  switch (control->controlMode) {
+    case controlModeLegacy:
+      input[0] = control->thrust;
+      input[1] = control->roll;
+      input[2] = control->pitch;
+      input[3] = control->yaw;
+      mat_mult(&legacyMix, &inputVector, &outputVector);
+      break;
+    case controlModeForceTorque:
+      input[0] = control->thrustSi;
+      input[1] = control->torqueX;
+      input[2] = control->torqueY;
+      input[3] = control->torqueZ;
+      mat_mult(&forceTorqueMix, &inputVector, &outputVector);
+      for (int i = 0; i < NR_OF_MOTORS; i++) {
+        // Negative forces can not be produced, keep the sign for the cap
+        output[i] = copysignf(forceToPwm(fabsf(output[i])), output[i]) * UINT16_MAX;
+      }
+      break;
+    case controlModeForce:
+      for (int i = 0; i < NR_OF_MOTORS; i++) {
+        output[i] = forceToPwm(control->normalizedForces[i] * MOTOR_MAX_THRUST) * UINT16_MAX;
+      }
+      break;
+    default:
+      memset(output, 0, sizeof(output));
+      break;
+  }
+
+  float compensation = batteryCompensationFactor();
+  for (int i = 0; i < NR_OF_MOTORS; i++) {
+    motorThrustUncapped->list[i] = (int32_t)clamp(output[i] * compensation, INT32_MIN / 2, INT32_MAX / 2);
+  }
+}
+
+void powerDistribution(const control_t *control, motors_thrust_uncapped_t* motorThrustUncapped)
+{
+  if (!rateLoopIsEnabled()) {
+    mix(control, motorThrustUncapped);
+    return;
+  }
+
+  // The control carries no attitude output, repeat the rate loop command
+  k_spinlock_key_t key = k_spin_lock(&rateLoopLock);
+  *motorThrustUncapped = rateLoopThrust;
+  rateLoopPermitTime = k_uptime_get_32();
+  rateLoopPermitted = true;
+  k_spin_unlock(&rateLoopLock, key);
+}
+
+static bool cap(const motors_thrust_uncapped_t* motorThrustUncapped, motors_thrust_pwm_t* motorPwm, bool countSaturations)
+{
+  const float minThrust = idleThrust;
+  const float maxThrust = UINT16_MAX;
+  float motor[NR_OF_MOTORS];
+  float highest = motorThrustUncapped->list[0];
+  float lowest = highest;
+  float sum = 0;
+
+  for (int i = 0; i < NR_OF_MOTORS; i++) {
+    motor[i] = motorThrustUncapped->list[i];
+    highest = fmaxf(highest, motor[i]);
+    lowest = fminf(lowest, motor[i]);
+    sum += motor[i];
+  }
+
+  bool isCapped = highest > maxThrust || lowest < minThrust;
+  if (isCapped) {
+    // The differential part alone does not fit, scale it down around the mean
+    float span = highest - lowest;
+    float range = maxThrust - minThrust;
+    if (span > range) {
+      float mean = sum / NR_OF_MOTORS;
+      float scale = range / span;
+      for (int i = 0; i < NR_OF_MOTORS; i++) {
+        motor[i] = mean + (motor[i] - mean) * scale;
+      }
+      highest = mean + (highest - mean) * scale;
+      lowest = mean + (lowest - mean) * scale;
+    }
+
+    // Give up thrust to keep the differential part
+    float shift = 0;
+    if (highest > maxThrust) {
+      shift = maxThrust - highest;
+    } else if (lowest < minThrust) {
+      shift = minThrust - lowest;
+    }
+
+    for (int i = 0; i < NR_OF_MOTORS; i++) {
+      if (countSaturations && (motorThrustUncapped->list[i] > maxThrust || motorThrustUncapped->list[i] < minThrust)) {
+        saturations[i]++;
+      }
+      motor[i] = clamp(motor[i] + shift, minThrust, maxThrust);
+    }
+  }
+
+  for (int i = 0; i < NR_OF_MOTORS; i++) {
+    motorPwm->list[i] = (uint16_t)motor[i];
+  }
+
+  return isCapped;
+}
+
+bool powerDistributionCap(const motors_thrust_uncapped_t* motorThrustUncapped, motors_thrust_pwm_t* motorPwm)
+{
+  // The rate task counts the saturations of the command the stabilizer repeats
+  return cap(motorThrustUncapped, motorPwm, !rateLoopIsEnabled());
+}
+
+void powerDistributionRateLoop(const control_t *control)
+{
+  motors_thrust_uncapped_t motorThrustUncapped;
+  mix(control, &motorThrustUncapped);
+
+  k_spinlock_key_t key = k_spin_lock(&rateLoopLock);
+  rateLoopThrust = motorThrustUncapped;
+  bool permitted = rateLoopPermitted && k_uptime_get_32() - rateLoopPermitTime <= RATE_LOOP_PERMIT_MS;
+  rateLoopPermitted = permitted;
+  k_spin_unlock(&rateLoopLock, key);
+
+  // Disarmed or stopped, the stabilizer keeps the motors
+  if (!permitted) {
+    return;
+  }
+
+  motors_thrust_pwm_t motorPwm;
+  cap(&motorThrustUncapped, &motorPwm, true);
+  for (int i = 0; i < NR_OF_MOTORS; i++) {
+    motorsSetRatio(i, motorPwm.list[i]);
+  }
+}
+
+uint32_t powerDistributionGetIdleThrust(void)
+{
+  return idleThrust;
+}
+
+float powerDistributionGetMaxThrust(void)
+{
+  return NR_OF_MOTORS * MOTOR_MAX_THRUST;
+}
+
+/**
+ * Power distribution parameters
+ */
+PARAM_GROUP_START(powerDist)
+/**
+ * @brief Lowest motor command of the cap, keeps the propellers spinning while armed (0 - 65535, larger values are clamped)
+ */
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT32 | PARAM_PERSISTENT, idleThrust, &idleThrust, &clampIdleThrust)
+/**
+ * @brief Non-zero to compensate the motor commands for the battery voltage.
+ * No effect while the battery voltage reads below 2.8 V, as it does until the
+ * power management reports it.
+ */
+PARAM_ADD(PARAM_UINT8, batComp, &batteryCompensation)
+PARAM_GROUP_STOP(powerDist)
+
+/**
+ * Saturation of the motor commands
+ */
+LOG_GROUP_START(powerDist)
+/**
+ * @brief Number of times the command of motor 1 was saturated
+ */
+LOG_ADD(LOG_UINT32, sat1, &saturations[0])
+/**
+ * @brief Number of times the command of motor 2 was saturated
+ */
+LOG_ADD(LOG_UINT32, sat2, &saturations[1])
+/**
+ * @brief Number of times the command of motor 3 was saturated
+ */
+LOG_ADD(LOG_UINT32, sat3, &saturations[2])
+/**
+ * @brief Number of times the command of motor 4 was saturated
+ */
+LOG_ADD(LOG_UINT32, sat4, &saturations[3])
+LOG_GROUP_STOP(powerDist)
@@ -0,0 +1,804 @@
+/*
+ *    ______
+ *   / ____/________ _____  __  ________      ______ __________ ___
+ *  / /   / ___/ __ `/_  / / / / / ___/ | /| / / __ `/ ___/ __ `__ \
+ * / /___/ /  / /_/ / / /_/ /_/ (__  )| |/ |/ / /_/ / /  / / / / / /
+ * \____/_/   \__,_/ /___/\__, /____/ |__/|__/\__,_/_/  /_/ /_/ /_/
+ *                       /____/
+ *
+ * Crazyswarm advanced control firmware for Crazyflie
+ *
+
+The MIT License (MIT)
+
+Copyright (c) 2018 Wolfgang Hoenig and James Alan Preiss
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+/*
+Implementation of piecewise polynomial trajectory evaluation
+*/
+
+#include <string.h>
+
+#include "pptraj.h"
+
+#define GRAV (9.81f)
+
+//
+// 1d polynomial functions.
+//
+
+float polyval(float const p[PP_SIZE], float t)
+{
+	float x = 0.0f;
+	for (int i = PP_DEGREE; i >= 0; --i) {
+		x = x * t + p[i];
+	}
+	return x;
+}
+
+void polylinear(float p[PP_SIZE], float duration, float x0, float x1)
+{
+	p[0] = x0;
+	p[1] = (x1 - x0) / duration;
+	for (int i = 2; i < PP_SIZE; ++i) {
+		p[i] = 0;
+	}
+}
+
+// factorials up to PP_DEGREE
+static const float facs[PP_SIZE] = { 1, 1, 2, 6, 24, 120, 720, 5040 };
+
+void polybezier(float p[PP_SIZE], float duration, float* x, int dim)
+{
+	// power basis of the Bezier curve of degree n on s in [0, 1]:
+	// p[j] = n! / (n - j)! * sum_i (-1)^(i + j) x[i] / (i! (j - i)!)
+	int const n = dim - 1;
+	for (int j = 0; j <= n; ++j) {
+		float sum = 0;
+		for (int i = 0; i <= j; ++i) {
+			float term = x[i] / (facs[i] * facs[j - i]);
+			sum += ((i + j) % 2 == 0) ? term : -term;
+		}
+		p[j] = facs[n] / facs[n - j] * sum;
+	}
+	for (int j = dim; j < PP_SIZE; ++j) {
+		p[j] = 0;
+	}
+	polystretchtime(p, duration);
+}
+
+void polyder(float p[PP_SIZE])
+{
+	for (int i = 1; i < PP_SIZE; ++i) {
+		p[i - 1] = i * p[i];
+	}
+	p[PP_SIZE - 1] = 0;
+}
+
+void polystretchtime(float p[PP_SIZE], float s)
+{
+	float recip = 1.0f / s;
+	float scale = recip;
+	for (int i = 1; i < PP_SIZE; ++i) {
+		p[i] *= scale;
+		scale *= recip;
+	}
+}
+
+void polyreflect(float p[PP_SIZE])
+{
+	for (int i = 1; i < PP_SIZE; i += 2) {
+		p[i] = -p[i];
+	}
+}
+
+//
+// 4d single polynomial piece for x-y-z-yaw.
+//
+
+void polyder4d(struct poly4d *p)
+{
+	for (int dim = 0; dim < 4; ++dim) {
+		polyder(p->p[dim]);
+	}
+}
+
+static struct vec polyval_xyz(struct poly4d const *p, float t)
+{
+	return mkvec(polyval(p->p[0], t), polyval(p->p[1], t), polyval(p->p[2], t));
+}
+
+static float polyval_yaw(struct poly4d const *p, float t)
+{
+	return polyval(p->p[3], t);
+}
+
+struct traj_eval poly4d_eval(struct poly4d const *p, float t)
+{
+	// flat variables
+	struct traj_eval out;
+	out.pos = polyval_xyz(p, t);
+	out.yaw = polyval_yaw(p, t);
+
+	// 1st derivative
+	struct poly4d deriv = *p;
+	polyder4d(&deriv);
+	out.vel = polyval_xyz(&deriv, t);
+	float dyaw = polyval_yaw(&deriv, t);
+
+	// 2nd derivative
+	polyder4d(&deriv);
+	out.acc = polyval_xyz(&deriv, t);
+
+	// 3rd derivative
+	polyder4d(&deriv);
+	struct vec jerk = polyval_xyz(&deriv, t);
+
+	struct vec thrust = vadd(out.acc, mkvec(0, 0, GRAV));
+	struct vec z_body = vnormalize(thrust);
+	struct vec x_world = mkvec(cosf(out.yaw), sinf(out.yaw), 0);
+	struct vec y_body = vnormalize(vcross(z_body, x_world));
+	struct vec x_body = vcross(y_body, z_body);
+
+	struct vec jerk_orth_zbody = vorthunit(jerk, z_body);
+	struct vec h_w = vscl(1.0f / vmag(thrust), jerk_orth_zbody);
+
+	out.omega.x = -vdot(h_w, y_body);
+	out.omega.y = vdot(h_w, x_body);
+	out.omega.z = z_body.z * dyaw;
+
+	return out;
+}
+
+//
+// piecewise polynomial trajectories
+//
+
+void piecewise_prepare(struct piecewise_traj *traj, float* piece_start)
+{
+	float t = 0;
+	for (int i = 0; i < traj->n_pieces; ++i) {
+		piece_start[i] = t;
+		t += traj->pieces[i].duration;
+	}
+	piece_start[traj->n_pieces] = t;
+
+	traj->piece_start = piece_start;
+	traj->cursor = 0;
+#ifdef PPTRAJ_FIXED_POINT
+	traj->fixed_pieces = NULL;
+#endif
+}
+
+void piecewise_unprepare(struct piecewise_traj *traj)
+{
+	traj->piece_start = NULL;
+	traj->cursor = 0;
+#ifdef PPTRAJ_FIXED_POINT
+	traj->fixed_pieces = NULL;
+#endif
+}
+
+// true if piece i is active at the given unscaled relative time.
+// the end of a piece is inclusive, so a time on a piece boundary
+// belongs to the earlier piece.
+static inline bool piece_contains(float const *piece_start, int i, float t)
+{
+	return t > piece_start[i] && t <= piece_start[i + 1];
+}
+
+int piecewise_find_piece(struct piecewise_traj *traj, float t_relative)
+{
+	int const n = traj->n_pieces;
+	float const *start = traj->piece_start;
+
+	if (start == NULL) {
+		// not prepared, walk the pieces
+		int i = 0;
+		for (; i < n - 1; ++i) {
+			if (t_relative <= traj->pieces[i].duration) {
+				break;
+			}
+			t_relative -= traj->pieces[i].duration;
+		}
+		return i;
+	}
+
+	if (t_relative <= start[1]) {
+		traj->cursor = 0;
+		return 0;
+	}
+	if (t_relative > start[n - 1]) {
+		traj->cursor = n - 1;
+		return n - 1;
+	}
+
+	// while flying, the active piece is either the last one or a neighbour
+	int i = traj->cursor;
+	if (piece_contains(start, i, t_relative)) {
+		return i;
+	}
+	if (i + 1 < n && piece_contains(start, i + 1, t_relative)) {
+		traj->cursor = i + 1;
+		return i + 1;
+	}
+	if (i > 0 && piece_contains(start, i - 1, t_relative)) {
+		traj->cursor = i - 1;
+		return i - 1;
+	}
+
+	// seek: find the last piece starting before t_relative
+	int lo = 1;
+	int hi = n - 1;
+	while (lo < hi) {
+		int mid = (lo + hi + 1) / 2;
+		if (start[mid] < t_relative) {
+			lo = mid;
+		} else {
+			hi = mid - 1;
+		}
+	}
+	traj->cursor = lo;
+	return lo;
+}
+
+static float piece_begin(struct piecewise_traj const *traj, int i)
+{
+	if (traj->piece_start != NULL) {
+		return traj->piece_start[i];
+	}
+	float t = 0;
+	for (int j = 0; j < i; ++j) {
+		t += traj->pieces[j].duration;
+	}
+	return t;
+}
+
+static struct traj_eval scale_eval(struct piecewise_traj const *traj, struct traj_eval ev)
+{
+	ev.pos = vadd(ev.pos, traj->shift);
+	ev.vel = vscl(1.0f / traj->timescale, ev.vel);
+	ev.acc = vscl(1.0f / (traj->timescale * traj->timescale), ev.acc);
+	ev.omega = vscl(1.0f / traj->timescale, ev.omega);
+	return ev;
+}
+
+struct traj_eval piecewise_eval(
+	struct piecewise_traj *traj, float t)
+{
+	if (t - traj->t_begin > piecewise_duration(traj)) {
+		// if we get here, the trajectory has ended
+		struct poly4d const *end_piece = &(traj->pieces[traj->n_pieces - 1]);
+		struct traj_eval ev = poly4d_eval(end_piece, end_piece->duration);
+		ev.pos = vadd(ev.pos, traj->shift);
+		ev.vel = vzero();
+		ev.acc = vzero();
+		ev.omega = vzero();
+		return ev;
+	}
+
+	float t_relative = (t - traj->t_begin) / traj->timescale;
+	int i = piecewise_find_piece(traj, t_relative);
+#ifdef PPTRAJ_FIXED_POINT
+	if (traj->fixed_pieces != NULL) {
+		struct traj_eval ev = poly4d_fixed_eval(&traj->fixed_pieces[i], t_relative - piece_begin(traj, i));
+		return scale_eval(traj, ev);
+	}
+#endif
+	struct poly4d const *piece = &(traj->pieces[i]);
+	struct traj_eval ev = poly4d_eval(piece, t_relative - piece_begin(traj, i));
+	return scale_eval(traj, ev);
+}
+
+struct traj_eval piecewise_eval_reversed(
+	struct piecewise_traj *traj, float t)
+{
+	float const duration = piecewise_duration(traj) / traj->timescale;
+	float t_relative = (t - traj->t_begin) / traj->timescale;
+
+	if (t_relative > duration) {
+		// if we get here, the trajectory has ended
+		struct poly4d const *end_piece = &(traj->pieces[0]);
+		struct traj_eval ev = poly4d_eval(end_piece, 0.0f);
+		ev.pos = vadd(ev.pos, traj->shift);
+		ev.vel = vzero();
+		ev.acc = vzero();
+		ev.omega = vzero();
+		return ev;
+	}
+
+	// time along the trajectory in forward direction
+	float t_forward = duration - t_relative;
+	int i = piecewise_find_piece(traj, t_forward);
+#ifdef PPTRAJ_FIXED_POINT
+	if (traj->fixed_pieces != NULL) {
+		// evaluate forward and reflect, i.e. negate the odd derivatives
+		struct traj_eval ev = poly4d_fixed_eval(&traj->fixed_pieces[i], t_forward - piece_begin(traj, i));
+		ev.vel = vneg(ev.vel);
+		ev.omega = vneg(ev.omega);
+		return scale_eval(traj, ev);
+	}
+#endif
+	struct poly4d piece_reversed = traj->pieces[i];
+	for (int j = 0; j < 4; ++j) {
+		polyreflect(piece_reversed.p[j]);
+	}
+	struct traj_eval ev = poly4d_eval(&piece_reversed, piece_begin(traj, i) - t_forward);
+	return scale_eval(traj, ev);
+}
+
+
+// ---------------------------------//
+// minimum snap through waypoints   //
+// ---------------------------------//
+
+// A minimum snap trajectory through fixed waypoints consists of 7th order
+// pieces that are continuous up to the 6th derivative. Each piece is fully
+// determined by position, velocity, acceleration and jerk at both of its
+// ends, so the free variables are velocity, acceleration and jerk at the
+// interior waypoints. Continuity of snap, crackle and pop at the interior
+// waypoints gives a banded linear system in these variables, where each
+// equation only involves the waypoint and its two neighbours.
+
+#define MINSNAP_FREE (3) // free derivatives per interior waypoint
+#define MINSNAP_N (MINSNAP_FREE * (PIECEWISE_MIN_SNAP_MAX_PIECES - 1))
+#define MINSNAP_KL (2 * MINSNAP_FREE - 1) // lower bandwidth
+#define MINSNAP_KU (2 * MINSNAP_FREE - 1) // upper bandwidth
+#define MINSNAP_BAND (2 * MINSNAP_KL + MINSNAP_KU + 1) // incl. fill-in from pivoting
+
+// inverse of the matrix that maps the coefficients 4..7 of a polynomial
+// on [0, 1] to its value and first three derivatives at 1.
+static const float hermite7_inv[4][4] = {
+	{  35.0f, -15.0f,  5.0f / 2.0f, -1.0f / 6.0f},
+	{ -84.0f,  39.0f, -7.0f,         1.0f / 2.0f},
+	{  70.0f, -34.0f, 13.0f / 2.0f, -1.0f / 2.0f},
+	{ -20.0f,  10.0f, -2.0f,         1.0f / 6.0f},
+};
+
+// k! / (k - i)!, i.e. the factor of the i'th derivative of s^k
+static float falling_factorial(int k, int i)
+{
+	float f = 1;
+	for (int j = 0; j < i; ++j) {
+		f *= k - j;
+	}
+	return f;
+}
+
+// compute the coefficients of the 7th order polynomial on the normalized
+// time s = t / duration with the given value and first three (real-time)
+// derivatives at both ends.
+static void hermite7(float duration, float const start[4], float const end[4], float a[PP_SIZE])
+{
+	float rhs[4];
+	float T_i = 1;
+	for (int i = 0; i < 4; ++i) {
+		a[i] = T_i * start[i] / falling_factorial(i, i);
+		T_i *= duration;
+	}
+	T_i = 1;
+	for (int i = 0; i < 4; ++i) {
+		rhs[i] = T_i * end[i];
+		for (int k = i; k < 4; ++k) {
+			rhs[i] -= falling_factorial(k, i) * a[k];
+		}
+		T_i *= duration;
+	}
+	for (int k = 0; k < 4; ++k) {
+		a[4 + k] = 0;
+		for (int i = 0; i < 4; ++i) {
+			a[4 + k] += hermite7_inv[k][i] * rhs[i];
+		}
+	}
+}
+
+// compute the (real-time) 4th to 6th derivatives of a normalized polynomial
+// at its start (d[0..2]) and end (d[3..5]).
+static void hermite7_high_derivatives(float duration, float const a[PP_SIZE], float d[2 * MINSNAP_FREE])
+{
+	for (int m = 4; m < 4 + MINSNAP_FREE; ++m) {
+		float scale = 1.0f / powf(duration, m);
+		float end = 0;
+		for (int k = m; k < PP_SIZE; ++k) {
+			end += falling_factorial(k, m) * a[k];
+		}
+		d[m - 4] = falling_factorial(m, m) * a[m] * scale;
+		d[MINSNAP_FREE + m - 4] = end * scale;
+	}
+}
+
+// workspace of the banded solver. Kept out of the stack of the calling task.
+static float minsnap_band[MINSNAP_N][MINSNAP_BAND];
+static float minsnap_rhs[MINSNAP_N][4];
+
+static inline int min_int(int a, int b)
+{
+	return a < b ? a : b;
+}
+
+static inline float* band_at(int row, int col)
+{
+	return &minsnap_band[row][col - row + MINSNAP_KL];
+}
+
+// solve the banded system in place with partial pivoting.
+// the solution is left in minsnap_rhs. returns false if the system is singular.
+static bool band_solve(int n)
+{
+	for (int k = 0; k < n; ++k) {
+		int last_row = min_int(k + MINSNAP_KL, n - 1);
+		int last_col = min_int(k + MINSNAP_KL + MINSNAP_KU, n - 1);
+
+		int pivot = k;
+		for (int i = k + 1; i <= last_row; ++i) {
+			if (fabsf(*band_at(i, k)) > fabsf(*band_at(pivot, k))) {
+				pivot = i;
+			}
+		}
+		if (fabsf(*band_at(pivot, k)) < 1e-9f) {
+			return false;
+		}
+		if (pivot != k) {
+			for (int j = k; j <= last_col; ++j) {
+				float tmp = *band_at(k, j);
+				*band_at(k, j) = *band_at(pivot, j);
+				*band_at(pivot, j) = tmp;
+			}
+			for (int dim = 0; dim < 4; ++dim) {
+				float tmp = minsnap_rhs[k][dim];
+				minsnap_rhs[k][dim] = minsnap_rhs[pivot][dim];
+				minsnap_rhs[pivot][dim] = tmp;
+			}
+		}
+
+		for (int i = k + 1; i <= last_row; ++i) {
+			float f = *band_at(i, k) / *band_at(k, k);
+			if (f == 0.0f) {
+				continue;
+			}
+			for (int j = k; j <= last_col; ++j) {
+				*band_at(i, j) -= f * *band_at(k, j);
+			}
+			for (int dim = 0; dim < 4; ++dim) {
+				minsnap_rhs[i][dim] -= f * minsnap_rhs[k][dim];
+			}
+		}
+	}
+
+	for (int k = n - 1; k >= 0; --k) {
+		int last_col = min_int(k + MINSNAP_KL + MINSNAP_KU, n - 1);
+		for (int dim = 0; dim < 4; ++dim) {
+			float x = minsnap_rhs[k][dim];
+			for (int j = k + 1; j <= last_col; ++j) {
+				x -= *band_at(k, j) * minsnap_rhs[j][dim];
+			}
+			minsnap_rhs[k][dim] = x / *band_at(k, k);
+		}
+	}
+	return true;
+}
+
+int piecewise_plan_min_snap(struct piecewise_traj *pp, struct poly4d *pieces,
+	struct vec p0, float y0, struct vec v0, float dy0, struct vec a0,
+	int n_waypoints, struct vec const *points, float const *yaws, float const *durations)
+{
+	if (n_waypoints < 1 || n_waypoints > PIECEWISE_MIN_SNAP_MAX_PIECES) {
+		return 1;
+	}
+	for (int i = 0; i < n_waypoints; ++i) {
+		if (!(durations[i] > 0.0f)) {
+			return 1;
+		}
+	}
+
+	// state[knot][dim][derivative] for all waypoints including the start.
+	// the free derivatives are zero until the system is solved.
+	float state[PIECEWISE_MIN_SNAP_MAX_PIECES + 1][4][4] = {0};
+	for (int dim = 0; dim < 3; ++dim) {
+		state[0][dim][0] = vindex(p0, dim);
+		state[0][dim][1] = vindex(v0, dim);
+		state[0][dim][2] = vindex(a0, dim);
+	}
+	state[0][3][0] = y0;
+	state[0][3][1] = dy0;
+	for (int knot = 1; knot <= n_waypoints; ++knot) {
+		for (int dim = 0; dim < 3; ++dim) {
+			state[knot][dim][0] = vindex(points[knot - 1], dim);
+		}
+		state[knot][3][0] = yaws[knot - 1];
+	}
+
+	int const n = MINSNAP_FREE * (n_waypoints - 1);
+	if (n > 0) {
+		memset(minsnap_band, 0, sizeof(minsnap_band));
+		memset(minsnap_rhs, 0, sizeof(minsnap_rhs));
+
+		for (int piece = 0; piece < n_waypoints; ++piece) {
+			float const T = durations[piece];
+			float a[PP_SIZE];
+			float d[2 * MINSNAP_FREE];
+
+			// contribution of each free derivative at the ends of this piece
+			for (int side = 0; side < 2; ++side) {
+				int knot = piece + side;
+				if (knot == 0 || knot == n_waypoints) {
+					continue;
+				}
+				for (int i = 1; i <= MINSNAP_FREE; ++i) {
+					float start[4] = {0}, end[4] = {0};
+					(side == 0 ? start : end)[i] = 1;
+					hermite7(T, start, end, a);
+					hermite7_high_derivatives(T, a, d);
+
+					int col = MINSNAP_FREE * (knot - 1) + i - 1;
+					// continuity at the start of the piece: -d(start) of this piece
+					if (piece > 0) {
+						for (int m = 0; m < MINSNAP_FREE; ++m) {
+							*band_at(MINSNAP_FREE * (piece - 1) + m, col) -= d[m];
+						}
+					}
+					// continuity at the end of the piece: +d(end) of this piece
+					if (piece < n_waypoints - 1) {
+						for (int m = 0; m < MINSNAP_FREE; ++m) {
+							*band_at(MINSNAP_FREE * piece + m, col) += d[MINSNAP_FREE + m];
+						}
+					}
+				}
+			}
+
+			// contribution of the known positions and boundary conditions
+			for (int dim = 0; dim < 4; ++dim) {
+				hermite7(T, state[piece][dim], state[piece + 1][dim], a);
+				hermite7_high_derivatives(T, a, d);
+				for (int m = 0; m < MINSNAP_FREE; ++m) {
+					if (piece > 0) {
+						minsnap_rhs[MINSNAP_FREE * (piece - 1) + m][dim] += d[m];
+					}
+					if (piece < n_waypoints - 1) {
+						minsnap_rhs[MINSNAP_FREE * piece + m][dim] -= d[MINSNAP_FREE + m];
+					}
+				}
+			}
+		}
+
+		if (!band_solve(n)) {
+			return 1;
+		}
+
+		for (int knot = 1; knot < n_waypoints; ++knot) {
+			for (int dim = 0; dim < 4; ++dim) {
+				for (int i = 1; i <= MINSNAP_FREE; ++i) {
+					state[knot][dim][i] = minsnap_rhs[MINSNAP_FREE * (knot - 1) + i - 1][dim];
+				}
+			}
+		}
+	}
+
+	for (int piece = 0; piece < n_waypoints; ++piece) {
+		float const T = durations[piece];
+		struct poly4d *p = &pieces[piece];
+		p->duration = T;
+		for (int dim = 0; dim < 4; ++dim) {
+			hermite7(T, state[piece][dim], state[piece + 1][dim], p->p[dim]);
+			// back to real time
+			float scale = 1;
+			for (int k = 0; k < PP_SIZE; ++k) {
+				p->p[dim][k] /= scale;
+				scale *= T;
+			}
+		}
+	}
+
+	pp->pieces = pieces;
+	pp->n_pieces = n_waypoints;
+	pp->timescale = 1.0f;
+	pp->shift = vzero();
+	pp->piece_start = NULL;
+	pp->cursor = 0;
+#ifdef PPTRAJ_FIXED_POINT
+	pp->fixed_pieces = NULL;
+#endif
+	return 0;
+}
+
+//
+// feasibility verification
+//
+
+// degree of the squared norm of the velocity
+#define VERIFY_MAX_DEGREE (2 * (PP_DEGREE - 1))
+
+// verify_der[k] holds the k-th derivative of the polynomial whose roots are searched
+static float verify_der[VERIFY_MAX_DEGREE][VERIFY_MAX_DEGREE + 1];
+static float verify_roots[2][VERIFY_MAX_DEGREE];
+
+static float polyval_degree(float const *p, int degree, float t)
+{
+	float x = p[degree];
+	for (int i = degree - 1; i >= 0; --i) {
+		x = x * t + p[i];
+	}
+	return x;
+}
+
+// find a root of p in [lo, hi], where p is monotone. returns false if there is none.
+static bool bisect_root(float const *p, int degree, float lo, float hi, float *root)
+{
+	float f_lo = polyval_degree(p, degree, lo);
+	float f_hi = polyval_degree(p, degree, hi);
+	if (f_hi == 0) {
+		*root = hi;
+		return true;
+	}
+	if ((f_lo < 0) == (f_hi < 0)) {
+		return false;
+	}
+	for (int i = 0; i < 32; ++i) {
+		float mid = 0.5f * (lo + hi);
+		float f_mid = polyval_degree(p, degree, mid);
+		if ((f_mid < 0) == (f_lo < 0)) {
+			lo = mid;
+			f_lo = f_mid;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	*root = 0.5f * (lo + hi);
+	return true;
+}
+
+// find the real roots of p in (a, b] in ascending order. the roots of the
+// linear derivative split the interval into monotone segments of the
+// quadratic one, whose roots split the interval for the cubic one, and so on.
+static int poly_roots(float const *p, int degree, float a, float b, float *roots)
+{
+	while (degree > 0 && p[degree] == 0) {
+		--degree;
+	}
+	if (degree == 0) {
+		return 0;
+	}
+
+	for (int i = 0; i <= degree; ++i) {
+		verify_der[0][i] = p[i];
+	}
+	for (int k = 1; k < degree; ++k) {
+		for (int i = 0; i <= degree - k; ++i) {
+			verify_der[k][i] = (i + 1) * verify_der[k - 1][i + 1];
+		}
+	}
+
+	float *curr = verify_roots[0];
+	float *next = verify_roots[1];
+	int n = 0;
+	for (int k = degree - 1; k >= 0; --k) {
+		int m = 0;
+		float lo = a;
+		for (int j = 0; j <= n; ++j) {
+			float hi = (j < n) ? curr[j] : b;
+			if (hi > lo && bisect_root(verify_der[k], degree - k, lo, hi, &next[m])) {
+				++m;
+			}
+			lo = hi;
+		}
+		float *tmp = curr;
+		curr = next;
+		next = tmp;
+		n = m;
+	}
+
+	for (int i = 0; i < n; ++i) {
+		roots[i] = curr[i];
+	}
+	return n;
+}
+
+// largest norm of the k-th derivative of the x, y, z polynomials of a piece
+static float poly4d_max_derivative_norm(struct poly4d const *piece, int k)
+{
+	int const degree = PP_DEGREE - k;
+	float sq[VERIFY_MAX_DEGREE + 1] = {0};
+	for (int dim = 0; dim < 3; ++dim) {
+		float d[PP_SIZE];
+		for (int i = 0; i <= degree; ++i) {
+			d[i] = piece->p[dim][i + k] * falling_factorial(i + k, k);
+		}
+		for (int i = 0; i <= degree; ++i) {
+			for (int j = 0; j <= degree; ++j) {
+				sq[i + j] += d[i] * d[j];
+			}
+		}
+	}
+
+	float dsq[VERIFY_MAX_DEGREE];
+	for (int i = 0; i < 2 * degree; ++i) {
+		dsq[i] = (i + 1) * sq[i + 1];
+	}
+	float roots[VERIFY_MAX_DEGREE];
+	int n = poly_roots(dsq, 2 * degree - 1, 0, piece->duration, roots);
+
+	float max = fmaxf(polyval_degree(sq, 2 * degree, 0),
+		polyval_degree(sq, 2 * degree, piece->duration));
+	for (int i = 0; i < n; ++i) {
+		max = fmaxf(max, polyval_degree(sq, 2 * degree, roots[i]));
+	}
+	return sqrtf(max);
+}
+
+// value of the k-th derivative of p at t
+static float polyval_derivative(float const p[PP_SIZE], int k, float t)
+{
+	float d[PP_SIZE];
+	for (int i = 0; i <= PP_DEGREE - k; ++i) {
+		d[i] = p[i + k] * falling_factorial(i + k, k);
+	}
+	return polyval_degree(d, PP_DEGREE - k, t);
+}
+
+void piecewise_bounds(struct piecewise_traj const *traj, struct piecewise_bounds *bounds)
+{
+	bounds->max_vel = 0;
+	bounds->max_acc = 0;
+	bounds->max_jerk = 0;
+	bounds->max_discontinuity = 0;
+
+	for (int i = 0; i < traj->n_pieces; ++i) {
+		struct poly4d const *piece = &traj->pieces[i];
+		bounds->max_vel = fmaxf(bounds->max_vel, poly4d_max_derivative_norm(piece, 1));
+		bounds->max_acc = fmaxf(bounds->max_acc, poly4d_max_derivative_norm(piece, 2));
+		bounds->max_jerk = fmaxf(bounds->max_jerk, poly4d_max_derivative_norm(piece, 3));
+
+		if (i + 1 < traj->n_pieces) {
+			// yaw is left out, its joins may wrap or turn in place
+			struct poly4d const *next = &traj->pieces[i + 1];
+			for (int dim = 0; dim < 3; ++dim) {
+				for (int k = 0; k < 3; ++k) {
+					float jump = polyval_derivative(piece->p[dim], k, piece->duration)
+						- polyval_derivative(next->p[dim], k, 0);
+					bounds->max_discontinuity = fmaxf(bounds->max_discontinuity, fabsf(jump));
+				}
+			}
+		}
+	}
+}
+
+enum piecewise_verify_result piecewise_check_bounds(struct piecewise_bounds const *bounds,
+	float timescale, struct piecewise_limits const *limits)
+{
+	// stretching time by s scales the k-th derivative by 1/s^k
+	float const s = 1.0f / timescale;
+	if (limits->max_discontinuity > 0 && bounds->max_discontinuity > limits->max_discontinuity) {
+		return PIECEWISE_DISCONTINUOUS;
+	}
+	if (limits->max_vel > 0 && bounds->max_vel * s > limits->max_vel) {
+		return PIECEWISE_TOO_FAST;
+	}
+	if (limits->max_acc > 0 && bounds->max_acc * s * s > limits->max_acc) {
+		return PIECEWISE_TOO_MUCH_ACC;
+	}
+	if (limits->max_jerk > 0 && bounds->max_jerk * s * s * s > limits->max_jerk) {
+		return PIECEWISE_TOO_MUCH_JERK;
+	}
+	return PIECEWISE_FEASIBLE;
+}
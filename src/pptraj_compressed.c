@@ -0,0 +1,279 @@
+/*
+ *    _____     ______  ___     __    ___       __        __  _
+ *   / ___/__  / / /  |/  /__  / /_  / _ \___  / /  ___  / /_(_)______
+ *  / /__/ _ \/ / / /|_/ / _ \/ __/ / , _/ _ \/ _ \/ _ \/ __/ / __(_-<
+ *  \___/\___/_/_/_/  /_/\___/\__/ /_/|_|\___/_.__/\___/\__/_/\__/___/
+ *
+ * Compressed piecewise polynomial trajectories for Crazyflie.
+ *
+ * Copyright (c) 2019 CollMot Robotics. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * pptraj_compressed.c - Decoder for compressed piecewise polynomial
+ *                       trajectories
+ */
+
+/*
+ * Layout of a compressed trajectory in memory (little endian):
+ *
+ * - start point: x, y, z in millimeters and yaw in 1/10 degrees, each as int16
+ * - a sequence of pieces, each consisting of:
+ *   - 1 byte of storage types, two bits per coordinate (x in the lowest bits,
+ *     then y, z and yaw), see enum piecewise_traj_storage_type
+ *   - duration of the piece in milliseconds as uint16
+ *   - the control points of x, y, z and yaw (in this order) as int16, in the
+ *     same units as the start point. The first control point of each
+ *     coordinate is the end point of the previous piece and is not stored.
+ *     CONSTANT stores no point, LINEAR one, BEZIER three and FULL seven.
+ * - a terminating piece header with a duration of zero
+ */
+
+#include <string.h>
+
+#include "pptraj_compressed.h"
+
+#define HEADER_SIZE (4 * sizeof(int16_t))
+#define PIECE_HEADER_SIZE (sizeof(uint8_t) + sizeof(uint16_t))
+
+static const uint8_t control_point_count[] = {
+	[PPTRAJ_STORAGE_CONSTANT] = 0,
+	[PPTRAJ_STORAGE_LINEAR] = 1,
+	[PPTRAJ_STORAGE_BEZIER] = 3,
+	[PPTRAJ_STORAGE_FULL] = 7,
+};
+
+static inline int16_t read_int16(const uint8_t* data)
+{
+	int16_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static inline uint16_t read_uint16(const uint8_t* data)
+{
+	uint16_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static inline float coordinate_to_float(int16_t value, int axis)
+{
+	if (axis == 3) {
+		return radians(value / 10.0f);
+	}
+	return value / 1000.0f;
+}
+
+static inline uint32_t piece_size(uint8_t types)
+{
+	uint32_t n = 0;
+	for (int axis = 0; axis < 4; ++axis) {
+		n += control_point_count[(types >> (2 * axis)) & 0x03];
+	}
+	return PIECE_HEADER_SIZE + n * sizeof(int16_t);
+}
+
+static inline bool is_end_of_trajectory(const void* data)
+{
+	return read_uint16((const uint8_t*)data + 1) == 0;
+}
+
+// decodes the piece at piece->data, starting at the given point
+static void decode_piece(struct piecewise_traj_compressed_piece* piece, float const start[4])
+{
+	const uint8_t* data = piece->data;
+	uint8_t types = data[0];
+	float duration = read_uint16(data + 1) / 1000.0f;
+	data += PIECE_HEADER_SIZE;
+
+	piece->poly4d.duration = duration;
+	for (int axis = 0; axis < 4; ++axis) {
+		uint8_t type = (types >> (2 * axis)) & 0x03;
+		uint8_t n = control_point_count[type];
+		float points[PP_SIZE];
+
+		points[0] = start[axis];
+		for (int i = 0; i < n; ++i) {
+			points[i + 1] = coordinate_to_float(read_int16(data), axis);
+			data += sizeof(int16_t);
+		}
+
+		float* p = piece->poly4d.p[axis];
+		switch (type) {
+			case PPTRAJ_STORAGE_CONSTANT:
+				polylinear(p, duration, points[0], points[0]);
+				break;
+			case PPTRAJ_STORAGE_LINEAR:
+				polylinear(p, duration, points[0], points[1]);
+				break;
+			default:
+				polybezier(p, duration, points, n + 1);
+				break;
+		}
+		piece->end[axis] = points[n];
+	}
+}
+
+// decodes the piece following the given one into next
+static void decode_next_piece(struct piecewise_traj_compressed_piece const *piece,
+	struct piecewise_traj_compressed_piece *next)
+{
+	next->data = (const uint8_t*)piece->data + piece_size(*(const uint8_t*)piece->data);
+	next->t_begin_relative = piece->t_begin_relative + piece->poly4d.duration;
+	decode_piece(next, piece->end);
+}
+
+static void piecewise_compressed_rewind(struct piecewise_traj_compressed *traj)
+{
+	const uint8_t* data = traj->data;
+	float start[4];
+	for (int axis = 0; axis < 4; ++axis) {
+		start[axis] = coordinate_to_float(read_int16(data + axis * sizeof(int16_t)), axis);
+	}
+
+	traj->current_piece.data = data + HEADER_SIZE;
+	traj->current_piece.t_begin_relative = 0;
+	decode_piece(&traj->current_piece, start);
+	traj->next_piece_valid = false;
+}
+
+// moves to the next piece. returns false if the current piece is the last one.
+static bool piecewise_compressed_advance(struct piecewise_traj_compressed *traj)
+{
+	if (traj->next_piece_valid) {
+		traj->current_piece = traj->next_piece;
+		traj->next_piece_valid = false;
+		return true;
+	}
+
+	const uint8_t* next = (const uint8_t*)traj->current_piece.data
+		+ piece_size(*(const uint8_t*)traj->current_piece.data);
+	if (is_end_of_trajectory(next)) {
+		return false;
+	}
+
+	struct piecewise_traj_compressed_piece piece;
+	decode_next_piece(&traj->current_piece, &piece);
+	traj->current_piece = piece;
+	traj->inline_decodes++;
+	return true;
+}
+
+bool piecewise_compressed_validate(const void* data, uint32_t size)
+{
+	const uint8_t* ptr = data;
+	const uint8_t* end = ptr + size;
+
+	if (size < HEADER_SIZE) {
+		return false;
+	}
+	ptr += HEADER_SIZE;
+
+	bool has_pieces = false;
+	while (ptr + PIECE_HEADER_SIZE <= end) {
+		if (is_end_of_trajectory(ptr)) {
+			return has_pieces;
+		}
+		ptr += piece_size(*ptr);
+		if (ptr > end) {
+			return false;
+		}
+		has_pieces = true;
+	}
+
+	// ran out of memory before the terminating piece
+	return false;
+}
+
+void piecewise_compressed_load(
+	struct piecewise_traj_compressed *traj, const void* data)
+{
+	traj->data = data;
+	traj->t_begin = 0;
+	traj->timescale = 1;
+	traj->shift = vzero();
+	traj->inline_decodes = 0;
+
+	traj->duration = 0;
+	const uint8_t* ptr = (const uint8_t*)data + HEADER_SIZE;
+	while (!is_end_of_trajectory(ptr)) {
+		traj->duration += read_uint16(ptr + 1) / 1000.0f;
+		ptr += piece_size(*ptr);
+	}
+
+	piecewise_compressed_rewind(traj);
+}
+
+bool piecewise_compressed_decode_next(
+	struct piecewise_traj_compressed_piece const *piece,
+	struct piecewise_traj_compressed_piece *next)
+{
+	if (piece->data == NULL) {
+		return false;
+	}
+
+	const uint8_t* data = (const uint8_t*)piece->data + piece_size(*(const uint8_t*)piece->data);
+	if (is_end_of_trajectory(data)) {
+		return false;
+	}
+
+	decode_next_piece(piece, next);
+	return true;
+}
+
+bool piecewise_compressed_publish_next(struct piecewise_traj_compressed *traj,
+	struct piecewise_traj_compressed_piece const *piece,
+	struct piecewise_traj_compressed_piece const *next)
+{
+	if (traj->next_piece_valid
+		|| traj->current_piece.data != piece->data
+		|| traj->current_piece.t_begin_relative != piece->t_begin_relative) {
+		return false;
+	}
+
+	traj->next_piece = *next;
+	traj->next_piece_valid = true;
+	return true;
+}
+
+struct traj_eval piecewise_compressed_eval(
+	struct piecewise_traj_compressed *traj, float t)
+{
+	float t_relative = (t - traj->t_begin) / traj->timescale;
+
+	if (t_relative < traj->current_piece.t_begin_relative) {
+		// going back in time, start over
+		piecewise_compressed_rewind(traj);
+	}
+
+	struct piecewise_traj_compressed_piece const *piece = &traj->current_piece;
+	while (t_relative > piece->t_begin_relative + piece->poly4d.duration) {
+		if (!piecewise_compressed_advance(traj)) {
+			// if we get here, the trajectory has ended
+			struct traj_eval ev = poly4d_eval(&piece->poly4d, piece->poly4d.duration);
+			ev.pos = vadd(ev.pos, traj->shift);
+			ev.vel = vzero();
+			ev.acc = vzero();
+			ev.omega = vzero();
+			return ev;
+		}
+	}
+
+	struct traj_eval ev = poly4d_eval(&piece->poly4d, t_relative - piece->t_begin_relative);
+	ev.pos = vadd(ev.pos, traj->shift);
+	ev.vel = vscl(1.0f / traj->timescale, ev.vel);
+	ev.acc = vscl(1.0f / (traj->timescale * traj->timescale), ev.acc);
+	ev.omega = vscl(1.0f / traj->timescale, ev.omega);
+	return ev;
+}
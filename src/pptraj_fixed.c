@@ -0,0 +1,184 @@
+/*
+ *    ______
+ *   / ____/________ _____  __  ________      ______ __________ ___
+ *  / /   / ___/ __ `/_  / / / / / ___/ | /| / / __ `/ ___/ __ `__ \
+ * / /___/ /  / /_/ / / /_/ /_/ (__  )| |/ |/ / /_/ / /  / / / / / /
+ * \____/_/   \__,_/ /___/\__, /____/ |__/|__/\__,_/_/  /_/ /_/ /_/
+ *                       /____/
+ *
+ * Crazyswarm advanced control firmware for Crazyflie
+ *
+
+The MIT License (MIT)
+
+Copyright (c) 2018 Wolfgang Hoenig and James Alan Preiss
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Fixed-point evaluation of piecewise polynomial trajectories
+*/
+
+#ifdef PPTRAJ_FIXED_POINT
+
+#include <math.h>
+
+#include "pptraj.h"
+
+#define GRAV (9.81f)
+
+// k! / (k - m)!, i.e. the factor of the m'th derivative of s^k
+static int32_t falling_factorial_int(int k, int m)
+{
+	int32_t f = 1;
+	for (int j = 0; j < m; ++j) {
+		f *= k - j;
+	}
+	return f;
+}
+
+void poly4d_to_fixed(struct poly4d const *p, struct poly4d_fixed *fixed)
+{
+	float const T = p->duration;
+	fixed->duration = T;
+
+	// the duration in Q30, so that s = t / duration can be computed exactly in integers
+	int time_exponent;
+	frexpf(T, &time_exponent);
+	fixed->time_exponent = 30 - time_exponent;
+	fixed->duration_q = lrintf(ldexpf(T, fixed->time_exponent));
+
+	for (int dim = 0; dim < 4; ++dim) {
+		// coefficients in normalized time. the integers hold 7 bits more than
+		// a float, so scaling in float only loses what the input never had.
+		float b[PP_SIZE];
+		float sum = 0;
+		float T_k = 1;
+		for (int k = 0; k < PP_SIZE; ++k) {
+			b[k] = p->p[dim][k] * T_k;
+			sum += fabsf(b[k]);
+			T_k *= T;
+		}
+
+		// the horner sum is bounded by the sum of the coefficients,
+		// keep it below 2^30 to leave room for rounding
+		int exponent = 0;
+		if (sum > 0) {
+			frexpf(sum, &exponent);
+			exponent = 30 - exponent;
+		}
+		if (exponent > 127) {
+			exponent = 127;
+		}
+		fixed->exponent[dim] = exponent;
+		for (int k = 0; k < PP_SIZE; ++k) {
+			fixed->p[dim][k] = (int32_t)lrintf(ldexpf(b[k], exponent));
+		}
+
+		// the derivatives have larger coefficients, shift them back into range
+		for (int m = 1; m <= 3; ++m) {
+			int64_t der_sum = 0;
+			for (int k = m; k < PP_SIZE; ++k) {
+				der_sum += (int64_t)falling_factorial_int(k, m) * llabs(fixed->p[dim][k]);
+			}
+			int shift = 0;
+			while ((der_sum >> shift) >= ((int64_t)1 << 30)) {
+				++shift;
+			}
+			fixed->der_shift[dim][m - 1] = shift;
+		}
+	}
+}
+
+// evaluate the m-th derivative of one axis with s in Q31. the result is in
+// units of 2^(der_shift - exponent) per duration^m.
+static int32_t polyval_fixed(struct poly4d_fixed const *p, int dim, int m, uint32_t s)
+{
+	int const shift = (m == 0) ? 0 : p->der_shift[dim][m - 1];
+	int32_t acc = 0;
+	for (int k = PP_DEGREE; k >= m; --k) {
+		int32_t c = (int32_t)(((int64_t)falling_factorial_int(k, m) * p->p[dim][k]) >> shift);
+		acc = (int32_t)(((int64_t)acc * s) >> 31) + c;
+	}
+	return acc;
+}
+
+static float polyval_fixed_to_float(struct poly4d_fixed const *p, int dim, int m, uint32_t s, float inv_T_m)
+{
+	int const shift = (m == 0) ? 0 : p->der_shift[dim][m - 1];
+	return ldexpf((float)polyval_fixed(p, dim, m, s), shift - p->exponent[dim]) * inv_T_m;
+}
+
+struct traj_eval poly4d_fixed_eval(struct poly4d_fixed const *p, float t)
+{
+	float const inv_T = 1.0f / p->duration;
+	int64_t t_q = llrintf(ldexpf(t, p->time_exponent));
+	if (t_q < 0) {
+		t_q = 0;
+	}
+	if (t_q > p->duration_q) {
+		t_q = p->duration_q;
+	}
+	// s in Q31
+	uint32_t const s = (uint32_t)((t_q << 31) / p->duration_q);
+
+	float d[4][4];
+	float inv_T_m = 1;
+	for (int m = 0; m < 4; ++m) {
+		for (int dim = 0; dim < 4; ++dim) {
+			d[dim][m] = polyval_fixed_to_float(p, dim, m, s, inv_T_m);
+		}
+		inv_T_m *= inv_T;
+	}
+
+	// flat outputs to attitude rates, as in poly4d_eval()
+	struct traj_eval out;
+	out.pos = mkvec(d[0][0], d[1][0], d[2][0]);
+	out.vel = mkvec(d[0][1], d[1][1], d[2][1]);
+	out.acc = mkvec(d[0][2], d[1][2], d[2][2]);
+	struct vec jerk = mkvec(d[0][3], d[1][3], d[2][3]);
+	out.yaw = d[3][0];
+	float dyaw = d[3][1];
+
+	struct vec thrust = vadd(out.acc, mkvec(0, 0, GRAV));
+	struct vec z_body = vnormalize(thrust);
+	struct vec x_world = mkvec(cosf(out.yaw), sinf(out.yaw), 0);
+	struct vec y_body = vnormalize(vcross(z_body, x_world));
+	struct vec x_body = vcross(y_body, z_body);
+
+	struct vec jerk_orth_zbody = vorthunit(jerk, z_body);
+	struct vec h_w = vscl(1.0f / vmag(thrust), jerk_orth_zbody);
+
+	out.omega.x = -vdot(h_w, y_body);
+	out.omega.y = vdot(h_w, x_body);
+	out.omega.z = z_body.z * dyaw;
+
+	return out;
+}
+
+void piecewise_prepare_fixed(struct piecewise_traj *traj, struct poly4d_fixed* fixed_pieces)
+{
+	for (int i = 0; i < traj->n_pieces; ++i) {
+		poly4d_to_fixed(&traj->pieces[i], &fixed_pieces[i]);
+	}
+	traj->fixed_pieces = fixed_pieces;
+}
+
+#endif // PPTRAJ_FIXED_POINT
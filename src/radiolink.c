@@ -13,6 +13,7 @@
 #include "radiolink.h"
 #include "syslink.h" // needed
 #include "crtp.h"
+#include "crtp_commander_high_level.h"
 #include "configblock.h"
 // #include "led.h"
 // #include "ledseq.h"
@@ -147,8 +148,11 @@ void radiolinkSyslinkDispatch(SyslinkPacket *slp)
   } else if (slp->type == SYSLINK_RADIO_RAW_BROADCAST)
   {
     slp->length--; // Decrease to get CRTP size.
-    // broadcasts are best effort, so no need to handle the case where the queue is full
-    k_msgq_put(&crtpPacketDelivery, &slp->length, K_NO_WAIT);
+    // time syncs are handled right away, so that queueing does not add jitter
+    if (!crtpCommanderHighLevelHandleTimeSync((CRTPPacket*)&slp->length)) {
+      // broadcasts are best effort, so no need to handle the case where the queue is full
+      k_msgq_put(&crtpPacketDelivery, &slp->length, K_NO_WAIT);
+    }
     // ledseqRun(&seq_linkUp);
     // no ack for broadcasts
   } else if (slp->type == SYSLINK_RADIO_RSSI)
@@ -0,0 +1,167 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * rate_loop.c - Rate loop driven by the IMU data-ready
+ *
+ * The inner rate loop of the PID controller runs in its own task, woken by
+ * each new gyro sample, so the sensor-to-motor latency does not depend on
+ * when the stabilizer gets scheduled. The position and attitude loops keep
+ * running in the stabilizer and publish the desired rates.
+ *
+ * The split is off until the rateLoop.enable param is set. The gyro samples
+ * come from estimatorEnqueueData(), which the sensors call with each sample.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/timing/timing.h>
+
+#include "config.h"
+#include "rate_loop.h"
+#include "controller_pid.h"
+
+#include "param.h"
+#include "log.h"
+
+static bool isInit;
+static uint8_t enable;
+static rateLoopOutput_t rateLoopOutput;
+
+K_THREAD_STACK_DEFINE(rateLoopTaskStack, RATE_LOOP_TASK_STACKSIZE);
+static struct k_thread rateLoopTaskThread;
+
+static K_SEM_DEFINE(dataReady, 0, 1);
+static struct k_spinlock gyroLock;
+static Axis3f gyroLatest;
+static timing_t gyroTimestamp;
+
+// statistics
+static uint32_t latencyNs;
+static uint32_t latencyMaxNs;
+static uint32_t missedSamples;
+
+static void enableChanged(void)
+{
+  controllerPidEnableRateLoop(rateLoopIsEnabled());
+}
+
+static void rateLoopTask(void *p1, void *p2, void *p3)
+{
+  control_t control;
+
+  while (1) {
+    k_sem_take(&dataReady, K_FOREVER);
+    if (!rateLoopIsEnabled()) {
+      continue;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&gyroLock);
+    Axis3f gyro = gyroLatest;
+    timing_t start = gyroTimestamp;
+    k_spin_unlock(&gyroLock, key);
+
+    controllerPidRateLoop(&control, &gyro);
+    if (rateLoopOutput) {
+      rateLoopOutput(&control);
+    }
+
+    timing_t end = timing_counter_get();
+    latencyNs = (uint32_t)timing_cycles_to_ns(timing_cycles_get(&start, &end));
+    if (latencyNs > latencyMaxNs) {
+      latencyMaxNs = latencyNs;
+    }
+  }
+}
+
+void rateLoopInit(rateLoopOutput_t output)
+{
+  if (isInit) {
+    return;
+  }
+
+  rateLoopOutput = output;
+  timing_init();
+  timing_start();
+
+  k_thread_create(&rateLoopTaskThread, rateLoopTaskStack,
+                  K_THREAD_STACK_SIZEOF(rateLoopTaskStack),
+                  rateLoopTask,
+                  NULL, NULL, NULL,
+                  RATE_LOOP_TASK_PRI, 0, K_NO_WAIT);
+  k_thread_name_set(&rateLoopTaskThread, RATE_LOOP_TASK_NAME);
+
+  isInit = true;
+  enableChanged();
+}
+
+bool rateLoopTest(void)
+{
+  return isInit;
+}
+
+bool rateLoopIsEnabled(void)
+{
+  return isInit && enable;
+}
+
+void rateLoopImuDataReady(const Axis3f *gyro)
+{
+  if (!rateLoopIsEnabled()) {
+    return;
+  }
+
+  k_spinlock_key_t key = k_spin_lock(&gyroLock);
+  gyroLatest = *gyro;
+  gyroTimestamp = timing_counter_get();
+  k_spin_unlock(&gyroLock, key);
+
+  // The previous sample has not been used yet, it is replaced by this one
+  if (k_sem_count_get(&dataReady) != 0) {
+    missedSamples++;
+  }
+  k_sem_give(&dataReady);
+}
+
+/**
+ * Timing of the rate loop, from the IMU data-ready to the motor output
+ */
+LOG_GROUP_START(rateLoop)
+/**
+ * @brief Latency of the last gyro sample [ns]
+ */
+LOG_ADD(LOG_UINT32, latency, &latencyNs)
+/**
+ * @brief Largest latency since boot [ns]
+ */
+LOG_ADD(LOG_UINT32, latencyMax, &latencyMaxNs)
+/**
+ * @brief Gyro samples replaced before the rate loop could run
+ */
+LOG_ADD(LOG_UINT32, missed, &missedSamples)
+LOG_GROUP_STOP(rateLoop)
+
+/**
+ * Split rate loop of the PID controller
+ */
+PARAM_GROUP_START(rateLoop)
+/**
+ * @brief Non-zero to run the PID rate loop on each gyro sample and write the motors from it (default: 0)
+ */
+PARAM_ADD_WITH_CALLBACK(PARAM_UINT8, enable, &enable, &enableChanged)
+PARAM_GROUP_STOP(rateLoop)
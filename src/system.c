@@ -31,6 +31,10 @@
 #include "sound.h"
 #include "sysload.h"
 #include "estimator_kalman.h"
+#include "controller_bench.h"
+#include "estimator_replay.h"
+#include "rate_loop.h"
+#include "power_distribution.h"
 // #include "estimator_ukf.h"
 #include "deck.h"
 #include "extrx.h"
@@ -179,12 +183,15 @@ void systemTaskFunction(void *arg)
   deckInit();
   estimator = deckGetRequiredEstimator();
   stabilizerInit(estimator);
+  rateLoopInit(powerDistributionRateLoop);
   if (deckGetRequiredLowInterferenceRadioMode() && platformConfigPhysicalLayoutAntennasAreClose())
   {
     platformSetLowInterferenceRadioMode();
   }
 
   memInit();
+  controllerBenchInit();
+  estimatorReplayInit();
 
 #ifdef PROXIMITY_ENABLED
   proximityInit();
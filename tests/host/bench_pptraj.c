@@ -0,0 +1,171 @@
+/*
+Micro-benchmark of the trajectory engine. Evaluates randomized trajectories
+at random times and reports the average and worst-case time per evaluation
+of the float, fixed point and compressed paths.
+
+usage: bench_pptraj [trajectories]
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pptraj.h"
+#include "pptraj_compressed.h"
+
+#define PIECES 30
+#define EVALS 1000
+
+struct stats
+{
+	double total_ns;
+	double max_ns;
+	long evals;
+};
+
+static uint32_t xorshift(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+// uniform in [0, 1)
+static float uniform(uint32_t *state)
+{
+	return (xorshift(state) >> 8) / (float)(1 << 24);
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void record(struct stats *s, double ns)
+{
+	s->total_ns += ns;
+	s->max_ns = fmax(s->max_ns, ns);
+	s->evals++;
+}
+
+static void report(char const *name, struct stats const *s)
+{
+	printf("%-12s %8.1f ns/eval  worst %8.1f ns  (%ld evals)\n",
+		name, s->total_ns / s->evals, s->max_ns, s->evals);
+}
+
+// a random trajectory of PIECES full Bezier pieces, uncompressed and compressed
+static void make_trajectory(uint32_t *seed, struct poly4d pieces[PIECES], uint8_t *compressed, size_t size)
+{
+	size_t n = 0;
+	float x[4][8] = {{0}};
+	for (int dim = 0; dim < 4; ++dim) {
+		int16_t start = 0;
+		memcpy(&compressed[n], &start, sizeof(start));
+		n += sizeof(start);
+	}
+
+	for (int i = 0; i < PIECES; ++i) {
+		uint16_t duration_ms = 200 + xorshift(seed) % 2000;
+		pieces[i].duration = duration_ms / 1000.0f;
+		compressed[n++] = 0xFF; // all axes PPTRAJ_STORAGE_FULL
+		memcpy(&compressed[n], &duration_ms, sizeof(duration_ms));
+		n += sizeof(duration_ms);
+
+		for (int dim = 0; dim < 4; ++dim) {
+			x[dim][0] = x[dim][7];
+			for (int k = 1; k < 8; ++k) {
+				int16_t point = (int16_t)(2000 * uniform(seed) - 1000);
+				x[dim][k] = dim == 3 ? radians(point / 10.0f) : point / 1000.0f;
+				memcpy(&compressed[n], &point, sizeof(point));
+				n += sizeof(point);
+			}
+			polybezier(pieces[i].p[dim], pieces[i].duration, x[dim], 8);
+		}
+	}
+
+	compressed[n++] = 0;
+	memset(&compressed[n], 0, 2);
+	n += 2;
+	if (n > size) {
+		abort();
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int trajectories = argc > 1 ? atoi(argv[1]) : 1000;
+	uint32_t seed = 0x9E3779B9;
+
+	static struct poly4d pieces[PIECES];
+	static struct poly4d_fixed fixed_pieces[PIECES];
+	static uint8_t compressed[8 + PIECES * (3 + 4 * 7 * 2) + 3];
+	float piece_start[PIECES + 1];
+	struct stats float_stats = {0};
+	struct stats fixed_stats = {0};
+	struct stats compressed_stats = {0};
+	volatile float sink = 0;
+
+	for (int j = 0; j < trajectories; ++j) {
+		make_trajectory(&seed, pieces, compressed, sizeof(compressed));
+		if (!piecewise_compressed_validate(compressed, sizeof(compressed))) {
+			printf("generated an invalid compressed trajectory\n");
+			return 1;
+		}
+
+		struct piecewise_traj traj = {
+			.timescale = 1.0f,
+			.n_pieces = PIECES,
+			.pieces = pieces,
+		};
+		piecewise_prepare(&traj, piece_start);
+		struct piecewise_traj fixed = traj;
+		piecewise_prepare_fixed(&fixed, fixed_pieces);
+		struct piecewise_traj_compressed compressed_traj;
+		piecewise_compressed_load(&compressed_traj, compressed);
+		float const duration = piecewise_duration(&traj);
+
+		// increasing times, as in flight
+		for (int i = 0; i < EVALS; ++i) {
+			float t = duration * i / EVALS;
+
+			double start = now_ns();
+			sink += piecewise_eval(&traj, t).pos.x;
+			record(&float_stats, now_ns() - start);
+
+			start = now_ns();
+			sink += piecewise_eval(&fixed, t).pos.x;
+			record(&fixed_stats, now_ns() - start);
+
+			start = now_ns();
+			sink += piecewise_compressed_eval(&compressed_traj, t).pos.x;
+			record(&compressed_stats, now_ns() - start);
+		}
+
+		// random seeks
+		for (int i = 0; i < EVALS; ++i) {
+			float t = duration * uniform(&seed);
+
+			double start = now_ns();
+			sink += piecewise_eval(&traj, t).pos.x;
+			record(&float_stats, now_ns() - start);
+
+			start = now_ns();
+			sink += piecewise_eval(&fixed, t).pos.x;
+			record(&fixed_stats, now_ns() - start);
+		}
+	}
+
+	printf("%d trajectories of %d pieces, timer overhead included\n", trajectories, PIECES);
+	report("float", &float_stats);
+	report("fixed", &fixed_stats);
+	report("compressed", &compressed_stats);
+	return 0;
+}
@@ -0,0 +1 @@
+/* Kconfig output of a build with no options set, for the host tests */
@@ -0,0 +1,116 @@
+/* The parts of the Zephyr kernel API used by the host tests, single threaded */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef MIN
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+#define BUILD_ASSERT(EXPR, MSG) _Static_assert(EXPR, MSG)
+
+struct k_spinlock {
+	int locked;
+};
+
+typedef int k_spinlock_key_t;
+
+static inline k_spinlock_key_t k_spin_lock(struct k_spinlock *lock)
+{
+	lock->locked = 1;
+	return 0;
+}
+
+static inline void k_spin_unlock(struct k_spinlock *lock, k_spinlock_key_t key)
+{
+	(void)key;
+	lock->locked = 0;
+}
+
+/* nothing else runs, so there is nothing to wait for */
+static inline int32_t k_msleep(int32_t ms)
+{
+	(void)ms;
+	return 0;
+}
+
+/* threads never start, the test calls their work directly */
+typedef struct {
+	int ticks;
+} k_timeout_t;
+
+#define K_NO_WAIT ((k_timeout_t){0})
+#define K_FOREVER ((k_timeout_t){-1})
+
+#define K_THREAD_STACK_DEFINE(name, size) static char name[size]
+#define K_THREAD_STACK_SIZEOF(name) sizeof(name)
+
+struct k_thread {
+	int unused;
+};
+
+static inline void *k_thread_create(struct k_thread *thread, char *stack, size_t stack_size,
+	void (*entry)(void *, void *, void *), void *p1, void *p2, void *p3,
+	int prio, uint32_t options, k_timeout_t delay)
+{
+	return thread;
+}
+
+static inline int k_thread_name_set(struct k_thread *thread, const char *name)
+{
+	return 0;
+}
+
+struct k_sem {
+	unsigned int count;
+};
+
+#define K_SEM_DEFINE(name, initial, limit) struct k_sem name = {initial}
+
+static inline void k_sem_give(struct k_sem *sem)
+{
+	sem->count++;
+}
+
+static inline int k_sem_take(struct k_sem *sem, k_timeout_t timeout)
+{
+	if (sem->count == 0) {
+		return -11;
+	}
+	sem->count--;
+	return 0;
+}
+
+/* not recursive: with one thread, a locked mutex stands for one held elsewhere */
+struct k_mutex {
+	int locked;
+};
+
+#define K_MUTEX_DEFINE(name) struct k_mutex name
+
+static inline int k_mutex_lock(struct k_mutex *mutex, k_timeout_t timeout)
+{
+	if (mutex->locked) {
+		return -16;
+	}
+	mutex->locked = 1;
+	return 0;
+}
+
+static inline int k_mutex_unlock(struct k_mutex *mutex)
+{
+	mutex->locked = 0;
+	return 0;
+}
+
+/* uptime in ms, set by the test */
+extern uint32_t host_uptime_ms;
+
+static inline uint32_t k_uptime_get_32(void)
+{
+	return host_uptime_ms;
+}
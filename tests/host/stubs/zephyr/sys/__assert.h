@@ -0,0 +1,6 @@
+/* Zephyr assertions on the host, checked with assert() */
+#pragma once
+
+#include <assert.h>
+
+#define __ASSERT(test, fmt, ...) assert(test)
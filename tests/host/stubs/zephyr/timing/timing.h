@@ -0,0 +1,29 @@
+/* Cycle counter of the host tests, one cycle per read */
+#pragma once
+
+#include <stdint.h>
+
+typedef uint64_t timing_t;
+
+static inline void timing_init(void)
+{
+}
+
+static inline void timing_start(void)
+{
+}
+
+static inline void timing_stop(void)
+{
+}
+
+static inline timing_t timing_counter_get(void)
+{
+	static timing_t counter;
+	return ++counter;
+}
+
+static inline uint64_t timing_cycles_get(volatile timing_t *const start, volatile timing_t *const end)
+{
+	return *end - *start;
+}
@@ -0,0 +1,225 @@
+/*
+Checks the admission layer of the estimator queues: every measurement is
+queued while no budget is set, measurements merged over budget carry the
+mean of their readings and timestamps, and a merged measurement is queued
+once it has waited for the burst window, whether or not its sensor sends
+again. Also checks that each gyro sample is handed to the rate loop, and
+that a replay takes the queues over from the live producers, those that
+push without the lock and those that take it.
+*/
+
+#include <math.h>
+#include <stdio.h>
+
+#include "estimator.h"
+#include "rate_loop.h"
+
+uint32_t host_uptime_ms;
+
+static int gyro_samples;
+static float gyro_x;
+
+void rateLoopImuDataReady(const Axis3f *gyro)
+{
+	gyro_samples++;
+	gyro_x = gyro->x;
+}
+
+static int failures;
+
+static void check(char const *what, double value, double expected, double tol)
+{
+	if (!(fabs(value - expected) <= tol)) {
+		printf("%s is %.9g, expected %.9g\n", what, value, expected);
+		failures++;
+	}
+}
+
+static void enqueue_tof(uint32_t timestamp, float distance)
+{
+	tofMeasurement_t tof = {.timestamp = timestamp, .distance = distance, .stdDev = 0.01f};
+	estimatorEnqueueData(MeasurementTypeTOF, &tof);
+}
+
+static int count_queued(MeasurementType type)
+{
+	measurement_t m;
+	int n = 0;
+	while (estimatorDequeueType(type, &m.data)) {
+		n++;
+	}
+	return n;
+}
+
+static void test_unlimited_by_default(void)
+{
+	host_uptime_ms = 100;
+	for (int i = 0; i < 4; i++) {
+		enqueue_tof(host_uptime_ms, 1.0f);
+		sweepAngleMeasurement_t sweep = {0};
+		for (int j = 0; j < 4; j++) {
+			estimatorEnqueueData(MeasurementTypeSweepAngle, &sweep);
+		}
+	}
+
+	check("default TOF queued", count_queued(MeasurementTypeTOF), 4, 0);
+	check("default sweep queued", count_queued(MeasurementTypeSweepAngle), 16, 0);
+	check("default TOF merged", estimatorGetAdmissionStats(MeasurementTypeTOF)->merged, 0, 0);
+}
+
+static void test_gyro_to_rate_loop(void)
+{
+	gyroscopeMeasurement_t gyro = {.gyro = {.x = 12.5f}};
+	estimatorEnqueueData(MeasurementTypeGyroscope, &gyro);
+	tofMeasurement_t tof = {0};
+	estimatorEnqueueData(MeasurementTypeTOF, &tof);
+
+	check("gyro samples handed to the rate loop", gyro_samples, 1, 0);
+	check("gyro sample of the rate loop", gyro_x, 12.5, 0);
+	check("gyro queued", count_queued(MeasurementTypeGyroscope), 1, 0);
+	count_queued(MeasurementTypeTOF);
+}
+
+static void test_merged_mean(void)
+{
+	// one token every 100 ms, and no more than half of one left from the
+	// idle time before, so the three are merged
+	estimatorSetAdmissionBudget(MeasurementTypeTOF, 10);
+	for (int i = 0; i < 3; i++) {
+		host_uptime_ms = 1000 + 10 * i;
+		enqueue_tof(host_uptime_ms, 1.0f + i);
+	}
+
+	// the sensor stops, the consumer queues the merged measurement after
+	// the burst window
+	tofMeasurement_t tof;
+	host_uptime_ms = 1049;
+	check("merged TOF queued before the window", estimatorDequeueType(MeasurementTypeTOF, &tof), 0, 0);
+	host_uptime_ms = 1050;
+	if (!estimatorDequeueType(MeasurementTypeTOF, &tof)) {
+		printf("merged TOF not queued after the window\n");
+		failures++;
+		return;
+	}
+	check("merged TOF distance", tof.distance, 2.0, 1e-6);
+	check("merged TOF timestamp", tof.timestamp, 1010, 0);
+	check("merged TOF count", estimatorGetAdmissionStats(MeasurementTypeTOF)->merged, 2, 0);
+	check("merged TOF dropped", estimatorGetAdmissionStats(MeasurementTypeTOF)->dropped, 0, 0);
+}
+
+static void test_producer_flush(void)
+{
+	estimatorSetAdmissionBudget(MeasurementTypeAbsoluteHeight, 1);
+
+	host_uptime_ms = 2000;
+	heightMeasurement_t height = {.timestamp = 2000, .height = 1.0f};
+	estimatorEnqueueData(MeasurementTypeAbsoluteHeight, &height);
+	host_uptime_ms = 2010;
+	height.timestamp = 2010;
+	height.height = 2.0f;
+	estimatorEnqueueData(MeasurementTypeAbsoluteHeight, &height);
+
+	// queued by the next one after the window instead of being dropped
+	host_uptime_ms = 2060;
+	height.timestamp = 2060;
+	height.height = 3.0f;
+	estimatorEnqueueData(MeasurementTypeAbsoluteHeight, &height);
+
+	measurement_t m;
+	if (!estimatorDequeue(&m) || m.type != MeasurementTypeAbsoluteHeight) {
+		printf("stale height not queued by its producer\n");
+		failures++;
+		return;
+	}
+	check("stale height", m.data.height.height, 1.5, 1e-6);
+	check("stale height timestamp", m.data.height.timestamp, 2005, 0);
+	check("height dropped", estimatorGetAdmissionStats(MeasurementTypeAbsoluteHeight)->dropped, 0, 0);
+}
+
+static void test_timestamp_wrap(void)
+{
+	estimatorSetAdmissionBudget(MeasurementTypeYawError, 1);
+
+	host_uptime_ms = 3000;
+	yawErrorMeasurement_t yaw = {.timestamp = 0xFFFFFFFB, .yawError = 0.1f};
+	estimatorEnqueueData(MeasurementTypeYawError, &yaw);
+	host_uptime_ms = 3010;
+	yaw.timestamp = 0x00000005;
+	estimatorEnqueueData(MeasurementTypeYawError, &yaw);
+
+	host_uptime_ms = 3050;
+	if (!estimatorDequeueType(MeasurementTypeYawError, &yaw)) {
+		printf("merged yaw error not queued after the window\n");
+		failures++;
+		return;
+	}
+	check("yaw error timestamp across the wrap", (int32_t)yaw.timestamp, 0, 0);
+}
+
+static void test_flow_accumulated(void)
+{
+	estimatorSetAdmissionBudget(MeasurementTypeFlow, 1);
+
+	flowMeasurement_t flow = {.dpixelx = 1.0f, .dt = 0.01f};
+	for (int i = 0; i < 3; i++) {
+		host_uptime_ms = 4000 + 10 * i;
+		flow.timestamp = host_uptime_ms;
+		estimatorEnqueueData(MeasurementTypeFlow, &flow);
+	}
+
+	host_uptime_ms = 4050;
+	if (!estimatorDequeueType(MeasurementTypeFlow, &flow)) {
+		printf("merged flow not queued after the window\n");
+		failures++;
+		return;
+	}
+	// the pixels are counted over the whole interval, which ends at the newest
+	check("flow pixels", flow.dpixelx, 3.0, 1e-6);
+	check("flow dt", flow.dt, 0.03, 1e-6);
+	check("flow timestamp", flow.timestamp, 4020, 0);
+}
+
+static void test_replay_handover(void)
+{
+	gyroscopeMeasurement_t gyro = {.gyro = {.x = 1.0f}};
+	positionMeasurement_t position = {.x = 1.0f};
+	estimatorEnqueueData(MeasurementTypeGyroscope, &gyro);
+	estimatorEnqueueData(MeasurementTypePosition, &position);
+
+	// the live measurements queued before the handover are dropped
+	estimatorQueueSetReplay(true);
+	check("live gyro during a replay", estimatorEnqueueData(MeasurementTypeGyroscope, &gyro), 0, 0);
+	check("live position during a replay", estimatorEnqueueData(MeasurementTypePosition, &position), 0, 0);
+	gyro.gyro.x = 2.0f;
+	position.x = 2.0f;
+	check("replayed gyro", estimatorEnqueueReplay(MeasurementTypeGyroscope, &gyro), 1, 0);
+	check("replayed position", estimatorEnqueueReplay(MeasurementTypePosition, &position), 1, 0);
+
+	measurement_t m;
+	check("gyro dequeued during a replay", estimatorDequeueType(MeasurementTypeGyroscope, &m.data), 1, 0);
+	check("replayed gyro sample", m.data.gyroscope.gyro.x, 2.0, 0);
+	check("position dequeued during a replay", estimatorDequeueType(MeasurementTypePosition, &m.data), 1, 0);
+	check("replayed position sample", m.data.position.x, 2.0, 0);
+
+	// and the replayed ones left at the end
+	estimatorEnqueueReplay(MeasurementTypeGyroscope, &gyro);
+	estimatorQueueSetReplay(false);
+	check("live gyro after a replay", estimatorEnqueueData(MeasurementTypeGyroscope, &gyro), 1, 0);
+	check("live position after a replay", estimatorEnqueueData(MeasurementTypePosition, &position), 1, 0);
+	check("gyro queued after a replay", count_queued(MeasurementTypeGyroscope), 1, 0);
+	check("position queued after a replay", count_queued(MeasurementTypePosition), 1, 0);
+}
+
+int main(void)
+{
+	test_unlimited_by_default();
+	test_gyro_to_rate_loop();
+	test_merged_mean();
+	test_producer_flush();
+	test_timestamp_wrap();
+	test_flow_accumulated();
+	test_replay_handover();
+
+	printf("%d failures\n", failures);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,287 @@
+/*
+Replays a recorded trace through estimator_replay.c, the estimator queues and
+the estimator history. The trace is uploaded and the states are read back
+through the memory handler of the replay, as a client would. The toy
+estimator predicts on the accelerometer and fuses delayed position readings
+through the history, so the states follow the ground truth only if every
+measurement reaches it in its place. Also checks that the live estimator and
+the live measurements are held off while the replay owns the estimator.
+*/
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+
+#include "estimator.h"
+#include "estimator_history.h"
+#include "estimator_replay.h"
+#include "mem.h"
+#include "rate_loop.h"
+#include "system.h"
+
+#define STEPS 60
+#define STEP_MS 10
+#define ACCELERATION 2.0f
+// a position reading every few steps, this many steps late
+#define READING_EVERY 4
+#define READING_DELAY 3
+
+uint32_t host_uptime_ms;
+
+static int failures;
+
+static void check(char const *what, double value, double expected, double tol)
+{
+	if (!(fabs(value - expected) <= tol)) {
+		printf("%s is %.9g, expected %.9g\n", what, value, expected);
+		failures++;
+	}
+}
+
+/* the firmware around the replay */
+
+static MemoryHandlerDef_t const *replay_mem;
+
+void memoryRegisterHandler(const MemoryHandlerDef_t *handlerDef)
+{
+	replay_mem = handlerDef;
+}
+
+static bool armed;
+
+bool systemIsArmed()
+{
+	return armed;
+}
+
+void rateLoopImuDataReady(const Axis3f *gyro)
+{
+}
+
+/* toy estimator along x, fed through the queues and the history */
+
+typedef struct {
+	float x;
+	float v;
+} toy_state_t;
+
+static void toy_predict(void *state, const estimatorHistoryInput_t *input)
+{
+	toy_state_t *s = state;
+	s->x += s->v * input->dt + 0.5f * input->acc.x * input->dt * input->dt;
+	s->v += input->acc.x * input->dt;
+}
+
+// pulls hard towards the reading, a reading fused in the wrong step shows
+static void toy_update(void *state, const measurement_t *measurement)
+{
+	toy_state_t *s = state;
+	float error = measurement->data.tof.distance - s->x;
+	s->x += 0.8f * error;
+}
+
+static const estimatorHistoryOps_t toy_ops = {.predict = toy_predict, .update = toy_update};
+
+static toy_state_t toy;
+static uint8_t toy_snapshots[ESTIMATOR_HISTORY_LENGTH * sizeof(toy_state_t)];
+static estimatorHistory_t history;
+static StateEstimatorType estimator_type = StateEstimatorTypeComplementary;
+static int switches;
+static int live_updates;
+static int locked_out;
+static int fused_in_place;
+
+void stateEstimatorSwitchTo(StateEstimatorType estimator)
+{
+	estimator_type = estimator;
+	memset(&toy, 0, sizeof(toy));
+	estimatorHistoryInit(&history, &toy_ops, &toy, toy_snapshots, sizeof(toy), 8);
+	switches++;
+}
+
+StateEstimatorType stateEstimatorGetType(void)
+{
+	return estimator_type;
+}
+
+void stateEstimator(state_t *state, const uint32_t tick)
+{
+	if (!estimatorReplayIsActive()) {
+		live_updates++;
+		return;
+	}
+
+	// the stabilizer and the sensors keep running during the replay
+	state_t live;
+	accelerationMeasurement_t acc = {.acc = {.x = 100.0f}};
+	if (!estimatorReplayLiveUpdate(&live, tick) && !estimatorEnqueueData(MeasurementTypeAcceleration, &acc)) {
+		locked_out++;
+	}
+
+	measurement_t m;
+	while (estimatorDequeue(&m)) {
+		if (m.type == MeasurementTypeAcceleration) {
+			estimatorHistoryInput_t input = {
+				.timestamp = tick,
+				.acc = m.data.acceleration.acc,
+				.dt = STEP_MS / 1000.0f,
+			};
+			estimatorHistoryPredict(&history, &input);
+		} else if (m.type == MeasurementTypeTOF) {
+			fused_in_place += estimatorHistoryFuse(&history, &m, m.data.tof.timestamp);
+		}
+	}
+	state->position.x = toy.x;
+}
+
+/* the trace */
+
+static uint8_t trace[ESTIMATOR_REPLAY_INPUT_SIZE];
+static uint32_t trace_length;
+
+static void add_record(uint8_t kind, uint8_t type, void const *payload, uint16_t length)
+{
+	replayRecordHeader_t header = {.kind = kind, .type = type, .length = length};
+	memcpy(&trace[trace_length], &header, sizeof(header));
+	memcpy(&trace[trace_length + sizeof(header)], payload, length);
+	trace_length += sizeof(header) + length;
+}
+
+static float true_x(uint32_t ms)
+{
+	float t = ms / 1000.0f;
+	return 0.5f * ACCELERATION * t * t;
+}
+
+static void record_trace(void)
+{
+	trace_length = 0;
+	for (int step = 1; step <= STEPS; ++step) {
+		uint32_t tick = step * STEP_MS;
+
+		accelerationMeasurement_t acc = {.acc = {.x = ACCELERATION}};
+		add_record(ReplayRecordMeasurement, MeasurementTypeAcceleration, &acc, sizeof(acc));
+		if (step % READING_EVERY == 0) {
+			// off by a constant, so that a reading fused late moves the state
+			uint32_t taken = tick - READING_DELAY * STEP_MS;
+			tofMeasurement_t tof = {.timestamp = taken, .distance = true_x(taken) + 0.01f};
+			add_record(ReplayRecordMeasurement, MeasurementTypeTOF, &tof, sizeof(tof));
+		}
+		add_record(ReplayRecordTick, 0, &tick, sizeof(tick));
+
+		replayGroundTruth_t truth = {.x = true_x(tick)};
+		add_record(ReplayRecordGroundTruth, 0, &truth, sizeof(truth));
+	}
+	add_record(ReplayRecordEnd, 0, "", 0);
+}
+
+static bool upload_trace(void)
+{
+	for (uint32_t offset = 0; offset < trace_length; offset += 128) {
+		uint32_t length = MIN(128, trace_length - offset);
+		if (!replay_mem->write(offset, length, &trace[offset])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static replayStateRecord_t read_state(int index)
+{
+	replayStateRecord_t record;
+	replay_mem->read(ESTIMATOR_REPLAY_INPUT_SIZE + index * sizeof(record), sizeof(record), (uint8_t *)&record);
+	return record;
+}
+
+/* expected state after a step, the same filter run without queues or history
+   with every reading arrived by then fused in its place */
+
+static float expected_x(int last_step)
+{
+	toy_state_t s = {0};
+	measurement_t m = {.type = MeasurementTypeTOF};
+	for (int step = 1; step <= last_step; ++step) {
+		estimatorHistoryInput_t input = {.acc = {.x = ACCELERATION}, .dt = STEP_MS / 1000.0f};
+		toy_predict(&s, &input);
+		int arrival = step + READING_DELAY;
+		if (arrival % READING_EVERY == 0 && arrival <= last_step) {
+			m.data.tof.distance = true_x(step * STEP_MS) + 0.01f;
+			toy_update(&s, &m);
+		}
+	}
+	return s.x;
+}
+
+static void test_replay(void)
+{
+	record_trace();
+	if (!upload_trace()) {
+		printf("trace upload refused\n");
+		failures++;
+		return;
+	}
+
+	check("replay result", estimatorReplayRun(), 0, 0);
+	check("estimator switches", switches, 2, 0);
+	check("estimator after the replay", estimatorReplayIsActive(), 0, 0);
+
+	for (int step = 1; step <= STEPS; ++step) {
+		replayStateRecord_t record = read_state(step - 1);
+		char what[48];
+		snprintf(what, sizeof(what), "tick of state %d", step);
+		check(what, record.tick, step * STEP_MS, 0);
+		snprintf(what, sizeof(what), "x of state %d", step);
+		check(what, record.x, expected_x(step), 1e-5);
+	}
+	check("late readings fused in their place", fused_in_place, STEPS / READING_EVERY, 0);
+	check("live estimator updates during the replay", live_updates, 0, 0);
+	check("ticks held off from the live side", locked_out, STEPS, 0);
+
+	// the owner is back with the live loop
+	state_t live;
+	check("live update after the replay", estimatorReplayLiveUpdate(&live, 0), 1, 0);
+	check("live estimator updates after the replay", live_updates, 1, 0);
+	accelerationMeasurement_t acc = {0};
+	check("live measurement after the replay", estimatorEnqueueData(MeasurementTypeAcceleration, &acc), 1, 0);
+}
+
+static void test_malformed_trace(void)
+{
+	trace_length = 0;
+	tofMeasurement_t tof = {0};
+	add_record(ReplayRecordMeasurement, MeasurementTypeTOF, &tof, sizeof(tof));
+	// runs past the end of the trace memory
+	replayRecordHeader_t header = {.kind = ReplayRecordTick, .length = 0xFFFF};
+	memcpy(&trace[trace_length], &header, sizeof(header));
+	trace_length += sizeof(header);
+	upload_trace();
+
+	check("malformed trace", estimatorReplayRun(), EINVAL, 0);
+	check("estimator after a malformed trace", estimatorReplayIsActive(), 0, 0);
+}
+
+static void test_armed(void)
+{
+	armed = true;
+	check("replay while armed", estimatorReplayRun(), EBUSY, 0);
+	armed = false;
+}
+
+int main(void)
+{
+	estimatorReplayInit();
+	if (!replay_mem) {
+		printf("no memory handler registered\n");
+		return 1;
+	}
+
+	test_replay();
+	test_malformed_trace();
+	test_armed();
+
+	printf("%d failures\n", failures);
+	return failures == 0 ? 0 : 1;
+}
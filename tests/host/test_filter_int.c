@@ -0,0 +1,185 @@
+/*
+Checks the fixed-point second order low pass filter of filter.h against a
+double precision evaluation of the float filter it is derived from, on
+random 16 bit input, its gain and phase against the float filter on sines
+around the cutoff, and the rounding of the output at the ends of the range.
+*/
+
+#include <math.h>
+#include <stdio.h>
+
+#include "filter.h"
+
+#define SAMPLE_FREQ 1000.0f
+#define SAMPLES 20000
+
+// samples left out of the sweep measurement while the filters settle
+#define SETTLE_SAMPLES 2000
+#define SINE_AMPLITUDE 20000.0
+
+static int failures;
+
+static uint32_t xorshift(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+static void check(char const *what, float cutoff, double value, double limit)
+{
+	if (!(value <= limit)) {
+		printf("%g Hz: %s is %.3g, limit %.3g\n", cutoff, what, value, limit);
+		failures++;
+	}
+}
+
+// the float filter in double precision, from the same coefficients
+struct reference
+{
+	double a[2], b[2], i[2], o[2];
+};
+
+static void reference_init(struct reference *ref, struct SecondOrderLowPass const *filter)
+{
+	*ref = (struct reference){
+		.a = {filter->a[0], filter->a[1]},
+		.b = {filter->b[0], filter->b[1]},
+	};
+}
+
+static double reference_update(struct reference *ref, double value)
+{
+	double out = ref->b[0] * value + ref->b[1] * ref->i[0] + ref->b[0] * ref->i[1]
+		- ref->a[0] * ref->o[0] - ref->a[1] * ref->o[1];
+	ref->i[1] = ref->i[0];
+	ref->i[0] = value;
+	ref->o[1] = ref->o[0];
+	ref->o[0] = out;
+	return out;
+}
+
+static void check_cutoff(float cutoff)
+{
+	float const tau = 1.0f / (2.0f * (float)M_PI * cutoff);
+	float const q = 0.7071f;
+	uint32_t seed = 0x1234567;
+
+	struct SecondOrderLowPass coeffs;
+	init_second_order_low_pass(&coeffs, tau, q, 1.0f / SAMPLE_FREQ, 0.0f);
+	struct reference ref;
+	reference_init(&ref, &coeffs);
+	struct SecondOrderLowPass_int filter;
+	init_second_order_low_pass_int(&filter, tau, q, 1.0f / SAMPLE_FREQ, 0);
+
+	// full scale noise, the worst case for the accumulator
+	double sum_squares = 0;
+	double max_error = 0;
+	for (int n = 0; n < SAMPLES; ++n) {
+		int32_t value = (int16_t)xorshift(&seed);
+		double error = update_second_order_low_pass_int(&filter, value) - reference_update(&ref, value);
+		sum_squares += error * error;
+		max_error = fmax(max_error, fabs(error));
+	}
+	// the output is rounded to the input resolution, 1/sqrt(12) LSB rms
+	check("rms error", cutoff, sqrt(sum_squares / SAMPLES), 0.4);
+	check("max error", cutoff, max_error, 1.0);
+
+	// a constant input settles where the float filter does, which is off by
+	// a few LSB at low cutoffs because of its float coefficients
+	init_second_order_low_pass_int(&filter, tau, q, 1.0f / SAMPLE_FREQ, 0);
+	reference_init(&ref, &coeffs);
+	int32_t out = 0;
+	double expected = 0;
+	for (int n = 0; n < SAMPLES; ++n) {
+		out = update_second_order_low_pass_int(&filter, 12345);
+		expected = reference_update(&ref, 12345);
+	}
+	check("dc error", cutoff, fabs(out - expected), 0.5);
+}
+
+// in-phase and quadrature sums of a response to a sine of freq
+struct response
+{
+	double in_phase, quadrature;
+};
+
+static void response_add(struct response *r, double value, double phase)
+{
+	r->in_phase += value * cos(phase);
+	r->quadrature += value * sin(phase);
+}
+
+// gain in dB and phase in degrees of a relative to b, both measured alike so
+// that the leakage of the sums cancels
+static void response_compare(struct response const *a, struct response const *b, double *gain, double *phase)
+{
+	*gain = 20.0 * log10(hypot(a->in_phase, a->quadrature) / hypot(b->in_phase, b->quadrature));
+	*phase = (atan2(a->quadrature, a->in_phase) - atan2(b->quadrature, b->in_phase)) * 180.0 / M_PI;
+	*phase = fabs(remainder(*phase, 360.0));
+}
+
+static void check_sweep(float cutoff)
+{
+	float const tau = 1.0f / (2.0f * (float)M_PI * cutoff);
+	float const q = 0.7071f;
+	static float const ratios[] = {0.25f, 0.5f, 0.8f, 1.0f, 1.25f, 2.0f, 4.0f};
+
+	for (size_t k = 0; k < sizeof(ratios) / sizeof(ratios[0]); ++k) {
+		double const freq = cutoff * ratios[k];
+		struct SecondOrderLowPass reference;
+		init_second_order_low_pass(&reference, tau, q, 1.0f / SAMPLE_FREQ, 0.0f);
+		struct SecondOrderLowPass_int filter;
+		init_second_order_low_pass_int(&filter, tau, q, 1.0f / SAMPLE_FREQ, 0);
+
+		struct response expected = {0}, actual = {0};
+		for (int n = 0; n < SETTLE_SAMPLES + SAMPLES; ++n) {
+			double const phase = 2.0 * M_PI * freq * n / SAMPLE_FREQ;
+			int32_t value = (int32_t)lround(SINE_AMPLITUDE * sin(phase));
+			float ref_out = update_second_order_low_pass(&reference, value);
+			int32_t out = update_second_order_low_pass_int(&filter, value);
+			if (n >= SETTLE_SAMPLES) {
+				response_add(&expected, ref_out, phase);
+				response_add(&actual, out, phase);
+			}
+		}
+
+		double gain, phase;
+		response_compare(&actual, &expected, &gain, &phase);
+		char what[48];
+		snprintf(what, sizeof(what), "gain at %g Hz [dB]", freq);
+		check(what, cutoff, fabs(gain), 0.01);
+		snprintf(what, sizeof(what), "phase at %g Hz [deg]", freq);
+		check(what, cutoff, phase, 0.05);
+	}
+}
+
+int main(void)
+{
+	check_cutoff(80.0f);
+	check_cutoff(20.0f);
+	check_cutoff(5.0f);
+
+	check_sweep(80.0f);
+	check_sweep(20.0f);
+	check_sweep(5.0f);
+
+	// the rounding of the output must not overflow at the ends of the range
+	struct SecondOrderLowPass_int filter = {0};
+	filter.o[0] = INT32_MAX;
+	if (get_second_order_low_pass_int(&filter) != 1 << (31 - SECOND_ORDER_LOW_PASS_INT_STATE_FRAC)) {
+		printf("output of INT32_MAX is %d\n", get_second_order_low_pass_int(&filter));
+		failures++;
+	}
+	filter.o[0] = INT32_MIN;
+	if (get_second_order_low_pass_int(&filter) != -(1 << (31 - SECOND_ORDER_LOW_PASS_INT_STATE_FRAC))) {
+		printf("output of INT32_MIN is %d\n", get_second_order_low_pass_int(&filter));
+		failures++;
+	}
+
+	printf("%d failures\n", failures);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,250 @@
+/*
+Checks the sparse covariance prediction and scalar update of
+kalman_covariance.c against dense double precision evaluations of
+P = F P F' + Q and of the Joseph form, on random covariances, transition
+matrices and measurement rows with the sparsity of the Kalman filter.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "kalman_covariance.h"
+
+#define N KC_COV_MAX_STATES
+#define TRIALS 500
+
+static int failures;
+
+static uint32_t xorshift(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+// uniform in [lo, hi]
+static float uniform(uint32_t *state, float lo, float hi)
+{
+	return lo + (hi - lo) * (xorshift(state) >> 8) / (float)(1 << 24);
+}
+
+static void unpack(kalmanCovariance_t const *cov, double p[N][N])
+{
+	for (int i = 0; i < N; ++i) {
+		for (int j = 0; j < N; ++j) {
+			p[i][j] = kalmanCovGet(cov, i, j);
+		}
+	}
+}
+
+// largest difference relative to the largest variance
+static double relative_error(kalmanCovariance_t const *cov, double expected[N][N])
+{
+	double scale = 0, error = 0;
+	for (int i = 0; i < N; ++i) {
+		scale = fmax(scale, fabs(expected[i][i]));
+		for (int j = 0; j < N; ++j) {
+			error = fmax(error, fabs(kalmanCovGet(cov, i, j) - expected[i][j]));
+		}
+	}
+	return error / scale;
+}
+
+static void check(char const *what, int trial, double value, double limit)
+{
+	if (!(value <= limit)) {
+		if (failures < 10) {
+			printf("trial %d: %s is %.3g, limit %.3g\n", trial, what, value, limit);
+		}
+		failures++;
+	}
+}
+
+// a random covariance A A' + D, well within the variance bounds
+static void random_covariance(uint32_t *seed, kalmanCovariance_t *cov)
+{
+	float variances[N];
+	for (int i = 0; i < N; ++i) {
+		variances[i] = uniform(seed, 0.01f, 1.0f);
+	}
+	kalmanCovInit(cov, N, variances);
+
+	float a[N][N];
+	for (int i = 0; i < N; ++i) {
+		for (int j = 0; j < N; ++j) {
+			a[i][j] = uniform(seed, -0.3f, 0.3f);
+		}
+	}
+	for (int i = 0; i < N; ++i) {
+		for (int j = i; j < N; ++j) {
+			float sum = 0;
+			for (int k = 0; k < N; ++k) {
+				sum += a[i][k] * a[j][k];
+			}
+			cov->p[kalmanCovIndex(cov, i, j)] += sum;
+		}
+	}
+}
+
+// identity plus about half of the off-diagonal entries, in random order
+static int random_transition(uint32_t *seed, kalmanSparseEntry_t f[N * N], double dense[N][N])
+{
+	int count = 0;
+	memset(dense, 0, sizeof(double) * N * N);
+	for (int i = 0; i < N; ++i) {
+		for (int j = 0; j < N; ++j) {
+			if (i == j || xorshift(seed) % 2 == 0) {
+				float v = (i == j ? 1.0f : 0.0f) + uniform(seed, -0.1f, 0.1f);
+				f[count++] = (kalmanSparseEntry_t){.row = i, .col = j, .value = v};
+				dense[i][j] = v;
+			}
+		}
+	}
+	for (int i = count - 1; i > 0; --i) {
+		int j = xorshift(seed) % (i + 1);
+		kalmanSparseEntry_t tmp = f[i];
+		f[i] = f[j];
+		f[j] = tmp;
+	}
+	return count;
+}
+
+static void check_predict(uint32_t *seed, int trial)
+{
+	kalmanCovariance_t cov;
+	random_covariance(seed, &cov);
+	kalmanSparseEntry_t f[N * N];
+	double fd[N][N], p[N][N], fp[N][N], expected[N][N];
+	int count = random_transition(seed, f, fd);
+	float q[N];
+	for (int i = 0; i < N; ++i) {
+		q[i] = uniform(seed, 0.0f, 0.01f);
+	}
+
+	unpack(&cov, p);
+	for (int i = 0; i < N; ++i) {
+		for (int j = 0; j < N; ++j) {
+			fp[i][j] = 0;
+			for (int k = 0; k < N; ++k) {
+				fp[i][j] += fd[i][k] * p[k][j];
+			}
+		}
+	}
+	for (int i = 0; i < N; ++i) {
+		for (int j = 0; j < N; ++j) {
+			expected[i][j] = i == j ? q[i] : 0;
+			for (int k = 0; k < N; ++k) {
+				expected[i][j] += fp[i][k] * fd[j][k];
+			}
+		}
+	}
+
+	kalmanCovPredict(&cov, f, count, q);
+	check("prediction error", trial, relative_error(&cov, expected), 1e-5);
+}
+
+static void check_update(uint32_t *seed, int trial)
+{
+	kalmanCovariance_t cov;
+	random_covariance(seed, &cov);
+
+	// one to three distinct states
+	uint8_t index[3];
+	float h[3];
+	int count = 1 + xorshift(seed) % 3;
+	for (int m = 0; m < count; ++m) {
+		int taken;
+		do {
+			index[m] = xorshift(seed) % N;
+			taken = 0;
+			for (int k = 0; k < m; ++k) {
+				taken |= index[k] == index[m];
+			}
+		} while (taken);
+		h[m] = uniform(seed, -1.0f, 1.0f);
+	}
+	float const error = uniform(seed, -0.5f, 0.5f);
+	float const std_noise = uniform(seed, 0.05f, 0.5f);
+
+	// dense Joseph form in double
+	double p[N][N], hd[N] = {0}, pht[N], k[N], expected[N][N];
+	unpack(&cov, p);
+	for (int m = 0; m < count; ++m) {
+		hd[index[m]] = h[m];
+	}
+	double s = (double)std_noise * std_noise;
+	for (int i = 0; i < N; ++i) {
+		pht[i] = 0;
+		for (int j = 0; j < N; ++j) {
+			pht[i] += p[i][j] * hd[j];
+		}
+		s += hd[i] * pht[i];
+	}
+	for (int i = 0; i < N; ++i) {
+		k[i] = pht[i] / s;
+	}
+	double a[N][N], ap[N][N];
+	for (int i = 0; i < N; ++i) {
+		for (int j = 0; j < N; ++j) {
+			a[i][j] = (i == j) - k[i] * hd[j];
+		}
+	}
+	for (int i = 0; i < N; ++i) {
+		for (int j = 0; j < N; ++j) {
+			ap[i][j] = 0;
+			for (int l = 0; l < N; ++l) {
+				ap[i][j] += a[i][l] * p[l][j];
+			}
+		}
+	}
+	for (int i = 0; i < N; ++i) {
+		for (int j = 0; j < N; ++j) {
+			expected[i][j] = k[i] * (double)std_noise * std_noise * k[j];
+			for (int l = 0; l < N; ++l) {
+				expected[i][j] += ap[i][l] * a[j][l];
+			}
+		}
+	}
+
+	float delta[N] = {0};
+	kalmanCovScalarUpdate(&cov, index, h, count, error, std_noise, delta);
+	check("update error", trial, relative_error(&cov, expected), 1e-5);
+
+	double delta_error = 0;
+	for (int i = 0; i < N; ++i) {
+		delta_error = fmax(delta_error, fabs(delta[i] - k[i] * error));
+	}
+	check("state delta error", trial, delta_error, 1e-5);
+}
+
+// the variances are bounded after an update
+static void check_bounds(void)
+{
+	float const variances[N] = {1e3f, 1e-9f, 1, 1, 1, 1, 1, 1, 1};
+	kalmanCovariance_t cov;
+	kalmanCovInit(&cov, N, variances);
+	uint8_t const index[1] = {2};
+	float const h[1] = {1.0f};
+	float delta[N] = {0};
+	kalmanCovScalarUpdate(&cov, index, h, 1, 0.0f, 1.0f, delta);
+	check("bounded large variance", 0, fabs(kalmanCovGet(&cov, 0, 0) - KC_COV_MAX_VARIANCE), 0);
+	check("bounded small variance", 0, fabs(kalmanCovGet(&cov, 1, 1) - KC_COV_MIN_VARIANCE), 0);
+}
+
+int main(void)
+{
+	uint32_t seed = 0x5EED1234;
+
+	for (int trial = 0; trial < TRIALS; ++trial) {
+		check_predict(&seed, trial);
+		check_update(&seed, trial);
+	}
+	check_bounds();
+
+	printf("%d trials, %d failures\n", TRIALS, failures);
+	return failures == 0 ? 0 : 1;
+}
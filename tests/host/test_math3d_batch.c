@@ -0,0 +1,189 @@
+/*
+Checks the batch and accumulating operations of math3d.h against the by-value
+operations they replace, on random rotations, matrices and vectors: qvrot_accum
+and qvrot_accum_batch against qvrot, mvmul_accum_batch against mvmul, and
+mmul_chain against repeated mmul. Also checks the batch operations with their
+output aliasing an input, which the header allows unless noted otherwise.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "math3d.h"
+
+#define N 16
+#define TRIALS 200
+#define TOL 1e-5f
+
+static int failures;
+
+static uint32_t xorshift(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+// uniform in [lo, hi]
+static float uniform(uint32_t *state, float lo, float hi)
+{
+	return lo + (hi - lo) * (xorshift(state) >> 8) / (float)(1 << 24);
+}
+
+static struct vec random_vec(uint32_t *seed)
+{
+	return mkvec(uniform(seed, -2, 2), uniform(seed, -2, 2), uniform(seed, -2, 2));
+}
+
+static struct quat random_quat(uint32_t *seed)
+{
+	return qnormalize(mkquat(uniform(seed, -1, 1), uniform(seed, -1, 1), uniform(seed, -1, 1), uniform(seed, -1, 1)));
+}
+
+static struct mat33 random_mat(uint32_t *seed)
+{
+	struct mat33 m;
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			m.m[i][j] = uniform(seed, -1, 1);
+		}
+	}
+	return m;
+}
+
+static void check_vec(char const *what, int trial, struct vec value, struct vec expected)
+{
+	float error = vmag(vsub(value, expected));
+	if (!(error <= TOL * fmaxf(1.0f, vmag(expected)))) {
+		if (failures < 10) {
+			printf("trial %d: %s is (%g, %g, %g), expected (%g, %g, %g)\n", trial, what,
+				value.x, value.y, value.z, expected.x, expected.y, expected.z);
+		}
+		failures++;
+	}
+}
+
+static void check_mat(char const *what, int trial, struct mat33 value, struct mat33 expected)
+{
+	for (int i = 0; i < 3; ++i) {
+		check_vec(what, trial, mrow(value, i), mrow(expected, i));
+	}
+}
+
+static void check_accum(uint32_t *seed, int trial)
+{
+	struct quat const q = random_quat(seed);
+	struct mat33 const m = random_mat(seed);
+	float const s = uniform(seed, -1, 1);
+	struct vec v[N], acc[N], expected[N];
+	for (int i = 0; i < N; ++i) {
+		v[i] = random_vec(seed);
+		acc[i] = random_vec(seed);
+	}
+
+	// qvrot_accum
+	for (int i = 0; i < N; ++i) {
+		struct vec a = acc[i];
+		qvrot_accum(&a, q, s, v[i]);
+		check_vec("qvrot_accum", trial, a, vadd(acc[i], vscl(s, qvrot(q, v[i]))));
+	}
+
+	// qvrot_accum_batch, into other vectors and into the rotated ones
+	for (int i = 0; i < N; ++i) {
+		expected[i] = vadd(acc[i], vscl(s, qvrot(q, v[i])));
+	}
+	struct vec out[N];
+	memcpy(out, acc, sizeof(out));
+	qvrot_accum_batch(out, q, s, v, N);
+	for (int i = 0; i < N; ++i) {
+		check_vec("qvrot_accum_batch", trial, out[i], expected[i]);
+	}
+	memcpy(out, v, sizeof(out));
+	qvrot_accum_batch(out, q, s, out, N);
+	for (int i = 0; i < N; ++i) {
+		check_vec("qvrot_accum_batch in place", trial, out[i], vadd(v[i], vscl(s, qvrot(q, v[i]))));
+	}
+
+	// mvmul_accum_batch, the same two ways
+	memcpy(out, acc, sizeof(out));
+	mvmul_accum_batch(out, &m, s, v, N);
+	for (int i = 0; i < N; ++i) {
+		check_vec("mvmul_accum_batch", trial, out[i], vadd(acc[i], vscl(s, mvmul(m, v[i]))));
+	}
+	memcpy(out, v, sizeof(out));
+	mvmul_accum_batch(out, &m, s, out, N);
+	for (int i = 0; i < N; ++i) {
+		check_vec("mvmul_accum_batch in place", trial, out[i], vadd(v[i], vscl(s, mvmul(m, v[i]))));
+	}
+}
+
+static void check_in_place(uint32_t *seed, int trial)
+{
+	struct quat const q = random_quat(seed);
+	struct mat33 const m = random_mat(seed);
+	float const s = uniform(seed, -1, 1);
+	struct vec a[N], b[N], out[N];
+	for (int i = 0; i < N; ++i) {
+		a[i] = random_vec(seed);
+		b[i] = random_vec(seed);
+	}
+
+	memcpy(out, a, sizeof(out));
+	vadd_batch(out, out, b, N);
+	for (int i = 0; i < N; ++i) {
+		check_vec("vadd_batch in place", trial, out[i], vadd(a[i], b[i]));
+	}
+
+	memcpy(out, a, sizeof(out));
+	vaxpy_batch(out, s, out, N);
+	for (int i = 0; i < N; ++i) {
+		check_vec("vaxpy_batch in place", trial, out[i], vadd(a[i], vscl(s, a[i])));
+	}
+
+	memcpy(out, a, sizeof(out));
+	mvmul_batch(out, &m, out, N);
+	for (int i = 0; i < N; ++i) {
+		check_vec("mvmul_batch in place", trial, out[i], mvmul(m, a[i]));
+	}
+
+	memcpy(out, a, sizeof(out));
+	qvrot_batch(out, q, out, N);
+	for (int i = 0; i < N; ++i) {
+		check_vec("qvrot_batch in place", trial, out[i], qvrot(q, a[i]));
+	}
+}
+
+static void check_chain(uint32_t *seed, int trial)
+{
+	struct mat33 m[5];
+	for (int i = 0; i < 5; ++i) {
+		m[i] = random_mat(seed);
+	}
+
+	check_mat("mmul_chain of none", trial, mmul_chain(m, 0), meye());
+	struct mat33 expected = m[0];
+	check_mat("mmul_chain of one", trial, mmul_chain(m, 1), expected);
+	for (int n = 2; n <= 5; ++n) {
+		expected = mmul(expected, m[n - 1]);
+		check_mat("mmul_chain", trial, mmul_chain(m, n), expected);
+	}
+}
+
+int main(void)
+{
+	uint32_t seed = 0xBA7C4ED;
+
+	for (int trial = 0; trial < TRIALS; ++trial) {
+		check_accum(&seed, trial);
+		check_in_place(&seed, trial);
+		check_chain(&seed, trial);
+	}
+
+	printf("%d trials, %d failures\n", TRIALS, failures);
+	return failures == 0 ? 0 : 1;
+}
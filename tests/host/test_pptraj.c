@@ -0,0 +1,361 @@
+/*
+Golden tests of the trajectory engine: compressed trajectories of each
+storage type against a de Casteljau evaluation of their control points, and
+prepared, reversed and time-scaled evaluation of uncompressed trajectories
+against the plain forward evaluation.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pptraj.h"
+#include "pptraj_compressed.h"
+
+static int failures;
+
+#define CHECK_NEAR(value, expected, tol) check_near(__FILE__, __LINE__, #value, (value), (expected), (tol))
+
+static void check_near(char const *file, int line, char const *what, double value, double expected, double tol)
+{
+	if (!(fabs(value - expected) <= tol)) {
+		printf("%s:%d: %s is %.9g, expected %.9g\n", file, line, what, value, expected);
+		failures++;
+	}
+}
+
+#define CHECK(cond) check_true(__FILE__, __LINE__, #cond, (cond))
+
+static void check_true(char const *file, int line, char const *what, bool cond)
+{
+	if (!cond) {
+		printf("%s:%d: %s is false\n", file, line, what);
+		failures++;
+	}
+}
+
+//
+// compressed trajectory builder
+//
+
+static uint8_t const control_points[] = {
+	[PPTRAJ_STORAGE_CONSTANT] = 0,
+	[PPTRAJ_STORAGE_LINEAR] = 1,
+	[PPTRAJ_STORAGE_BEZIER] = 3,
+	[PPTRAJ_STORAGE_FULL] = 7,
+};
+
+struct builder
+{
+	uint8_t data[512];
+	size_t size;
+};
+
+static void put_int16(struct builder *b, int16_t value)
+{
+	memcpy(&b->data[b->size], &value, sizeof(value));
+	b->size += sizeof(value);
+}
+
+static void put_uint16(struct builder *b, uint16_t value)
+{
+	memcpy(&b->data[b->size], &value, sizeof(value));
+	b->size += sizeof(value);
+}
+
+// start point in mm and decidegrees
+static void begin(struct builder *b, int16_t const start[4])
+{
+	b->size = 0;
+	for (int axis = 0; axis < 4; ++axis) {
+		put_int16(b, start[axis]);
+	}
+}
+
+// points[axis] holds the control points of the axis, without the start point
+static void add_piece(struct builder *b, uint8_t const types[4], uint16_t duration_ms, int16_t const points[4][7])
+{
+	uint8_t packed = 0;
+	for (int axis = 0; axis < 4; ++axis) {
+		packed |= types[axis] << (2 * axis);
+	}
+	b->data[b->size++] = packed;
+	put_uint16(b, duration_ms);
+	for (int axis = 0; axis < 4; ++axis) {
+		for (int i = 0; i < control_points[types[axis]]; ++i) {
+			put_int16(b, points[axis][i]);
+		}
+	}
+}
+
+static void end(struct builder *b)
+{
+	b->data[b->size++] = 0;
+	put_uint16(b, 0);
+}
+
+static double to_unit(int16_t value, int axis)
+{
+	return axis == 3 ? value / 10.0 * M_PI / 180.0 : value / 1000.0;
+}
+
+// value of the Bezier curve through n + 1 control points at s in [0, 1]
+static double de_casteljau(double const *points, int n, double s)
+{
+	double b[8];
+	memcpy(b, points, (n + 1) * sizeof(double));
+	for (int r = 1; r <= n; ++r) {
+		for (int i = 0; i <= n - r; ++i) {
+			b[i] = (1 - s) * b[i] + s * b[i + 1];
+		}
+	}
+	return b[0];
+}
+
+// the value a piece of the given type takes on at s
+static double piece_value(uint8_t type, double start, int16_t const *points, int axis, double s)
+{
+	double p[8] = {start};
+	int n = control_points[type];
+	for (int i = 0; i < n; ++i) {
+		p[i + 1] = to_unit(points[i], axis);
+	}
+	if (type == PPTRAJ_STORAGE_CONSTANT) {
+		return start;
+	}
+	return de_casteljau(p, n, s);
+}
+
+static float axis_value(struct traj_eval const *ev, int axis)
+{
+	switch (axis) {
+		case 0: return ev->pos.x;
+		case 1: return ev->pos.y;
+		case 2: return ev->pos.z;
+		default: return ev->yaw;
+	}
+}
+
+// a two piece trajectory with every axis in the given storage type
+static void test_storage_type(uint8_t type)
+{
+	static int16_t const start[4] = {100, -200, 300, 450};
+	static int16_t const points[2][4][7] = {
+		{
+			{400, 900, 1200, 800, 600, 700, 1000},
+			{-100, 0, 300, 200, -50, -400, -300},
+			{500, 800, 900, 1100, 1000, 900, 800},
+			{300, 0, -300, -600, -300, 0, 150},
+		},
+		{
+			{1500, 1700, 1400, 1000, 900, 1200, 1300},
+			{-100, 100, 200, 400, 300, 100, 0},
+			{600, 400, 300, 200, 300, 250, 200},
+			{0, 200, 400, 900, 1200, 1500, 1800},
+		},
+	};
+	static uint16_t const durations[2] = {1500, 2250};
+
+	uint8_t const types[4] = {type, type, type, type};
+	struct builder b;
+	begin(&b, start);
+	add_piece(&b, types, durations[0], points[0]);
+	add_piece(&b, types, durations[1], points[1]);
+	end(&b);
+
+	CHECK(piecewise_compressed_validate(b.data, b.size));
+	CHECK(!piecewise_compressed_validate(b.data, b.size - 1));
+
+	struct piecewise_traj_compressed traj;
+	piecewise_compressed_load(&traj, b.data);
+	CHECK_NEAR(piecewise_compressed_duration(&traj), 3.75, 1e-6);
+
+	for (int i = 0; i <= 100; ++i) {
+		double t = 3.75 * i / 100;
+		int piece = t <= 1.5 ? 0 : 1;
+		double s = piece == 0 ? t / 1.5 : (t - 1.5) / 2.25;
+		struct traj_eval ev = piecewise_compressed_eval(&traj, t);
+
+		for (int axis = 0; axis < 4; ++axis) {
+			double piece_start = to_unit(start[axis], axis);
+			if (piece == 1) {
+				int n = control_points[type];
+				piece_start = n == 0 ? piece_start : to_unit(points[0][axis][n - 1], axis);
+			}
+			double expected = piece_value(type, piece_start, points[piece][axis], axis, s);
+			CHECK_NEAR(axis_value(&ev, axis), expected, 1e-4);
+		}
+	}
+
+	// a linear piece moves at a constant velocity
+	if (type == PPTRAJ_STORAGE_LINEAR) {
+		struct traj_eval ev = piecewise_compressed_eval(&traj, 0.7f);
+		CHECK_NEAR(ev.vel.x, (0.4 - 0.1) / 1.5, 1e-5);
+		CHECK_NEAR(ev.acc.x, 0, 1e-5);
+	}
+
+	// after the end, the trajectory rests at its final point
+	struct traj_eval last = piecewise_compressed_eval(&traj, 10.0f);
+	CHECK_NEAR(vmag(last.vel), 0, 0);
+	CHECK_NEAR(vmag(last.acc), 0, 0);
+}
+
+// a trajectory with a different storage type per axis
+static void test_mixed_storage_types(void)
+{
+	static int16_t const start[4] = {0, 0, 1000, 0};
+	static int16_t const points[4][7] = {
+		{0},
+		{3000},
+		{0, 3000, 2000},
+		{900, 900, 900, 900, 900, 900, 900},
+	};
+	static uint8_t const types[4] = {
+		PPTRAJ_STORAGE_CONSTANT, PPTRAJ_STORAGE_LINEAR, PPTRAJ_STORAGE_BEZIER, PPTRAJ_STORAGE_FULL,
+	};
+
+	struct builder b;
+	begin(&b, start);
+	add_piece(&b, types, 3000, points);
+	end(&b);
+	CHECK(piecewise_compressed_validate(b.data, b.size));
+
+	struct piecewise_traj_compressed traj;
+	piecewise_compressed_load(&traj, b.data);
+
+	// golden values: x stays, y moves 1 m/s, z is a cubic Bezier curve
+	// 1, 0, 3, 2 and yaw a full curve with all control points at 90 degrees
+	struct traj_eval ev = piecewise_compressed_eval(&traj, 1.5f);
+	CHECK_NEAR(ev.pos.x, 0, 1e-6);
+	CHECK_NEAR(ev.pos.y, 1.5, 1e-5);
+	CHECK_NEAR(ev.pos.z, 0.125 * 1 + 0.375 * 0 + 0.375 * 3 + 0.125 * 2, 1e-5);
+	CHECK_NEAR(ev.yaw, M_PI / 2 * (1 - 1.0 / 128), 1e-5);
+	CHECK_NEAR(ev.vel.y, 1, 1e-5);
+}
+
+static void test_compressed_validate(void)
+{
+	static int16_t const start[4] = {0};
+	static int16_t const points[4][7] = {{0}};
+	static uint8_t const types[4] = {PPTRAJ_STORAGE_FULL};
+
+	struct builder b;
+	begin(&b, start);
+	CHECK(!piecewise_compressed_validate(b.data, b.size));
+	end(&b);
+	// a terminator without pieces is not a trajectory
+	CHECK(!piecewise_compressed_validate(b.data, b.size));
+
+	begin(&b, start);
+	add_piece(&b, types, 1000, points);
+	// not terminated
+	CHECK(!piecewise_compressed_validate(b.data, b.size));
+	end(&b);
+	CHECK(piecewise_compressed_validate(b.data, b.size));
+}
+
+//
+// uncompressed trajectories
+//
+
+#define PIECES 6
+
+static void make_trajectory(struct poly4d pieces[PIECES])
+{
+	float x[4][8] = {{0}};
+	for (int i = 0; i < PIECES; ++i) {
+		pieces[i].duration = 0.5f + 0.25f * i;
+		for (int dim = 0; dim < 4; ++dim) {
+			// continue from the last control point of the previous piece
+			x[dim][0] = x[dim][7];
+			for (int k = 1; k < 8; ++k) {
+				x[dim][k] = sinf(1.3f * i + 0.7f * k + dim);
+			}
+			polybezier(pieces[i].p[dim], pieces[i].duration, x[dim], 8);
+		}
+	}
+}
+
+static void check_eval_near(struct traj_eval const *a, struct traj_eval const *b, float vel_sign, float vel_scale)
+{
+	CHECK_NEAR(a->pos.x, b->pos.x, 1e-4);
+	CHECK_NEAR(a->pos.y, b->pos.y, 1e-4);
+	CHECK_NEAR(a->pos.z, b->pos.z, 1e-4);
+	CHECK_NEAR(a->yaw, b->yaw, 1e-4);
+	CHECK_NEAR(a->vel.x, vel_sign * vel_scale * b->vel.x, 1e-3);
+	CHECK_NEAR(a->vel.y, vel_sign * vel_scale * b->vel.y, 1e-3);
+	CHECK_NEAR(a->vel.z, vel_sign * vel_scale * b->vel.z, 1e-3);
+	CHECK_NEAR(a->acc.x, vel_scale * vel_scale * b->acc.x, 1e-2);
+}
+
+static void test_piecewise(void)
+{
+	struct poly4d pieces[PIECES];
+	make_trajectory(pieces);
+
+	struct piecewise_traj plain = {
+		.t_begin = 1.0f,
+		.timescale = 1.0f,
+		.n_pieces = PIECES,
+		.pieces = pieces,
+	};
+	struct piecewise_traj prepared = plain;
+	float piece_start[PIECES + 1];
+	piecewise_prepare(&prepared, piece_start);
+
+	float const duration = piecewise_duration(&plain);
+	CHECK_NEAR(piecewise_duration(&prepared), duration, 1e-6);
+	CHECK_NEAR(duration, PIECES * 0.5f + 0.25f * PIECES * (PIECES - 1) / 2, 1e-5);
+
+	// forward, then seeking backwards and forwards through the cursor
+	static float const fractions[] = {0, 0.1f, 0.2f, 0.5f, 0.9f, 1, 0.3f, 0.05f, 0.95f, 0.6f};
+	for (size_t i = 0; i < sizeof(fractions) / sizeof(fractions[0]); ++i) {
+		float t = plain.t_begin + fractions[i] * duration;
+		struct traj_eval a = piecewise_eval(&plain, t);
+		struct traj_eval b = piecewise_eval(&prepared, t);
+		check_eval_near(&b, &a, 1, 1);
+	}
+
+	// piece joins are continuous
+	float t_join = plain.t_begin;
+	for (int i = 0; i < PIECES - 1; ++i) {
+		t_join += pieces[i].duration;
+		struct traj_eval before = piecewise_eval(&prepared, t_join - 1e-4f);
+		struct traj_eval after = piecewise_eval(&prepared, t_join + 1e-4f);
+		CHECK_NEAR(vdist(before.pos, after.pos), 0, 1e-2);
+	}
+
+	// reversed and time-scaled evaluation match the forward one
+	for (int i = 0; i <= 50; ++i) {
+		float t = duration * i / 50;
+		struct traj_eval forward = piecewise_eval(&prepared, plain.t_begin + t);
+
+		struct traj_eval reversed = piecewise_eval_reversed(&prepared, plain.t_begin + duration - t);
+		check_eval_near(&reversed, &forward, -1, 1);
+
+		prepared.timescale = 2.0f;
+		struct traj_eval scaled = piecewise_eval(&prepared, plain.t_begin + 2.0f * t);
+		prepared.timescale = 1.0f;
+		check_eval_near(&scaled, &forward, 1, 0.5f);
+	}
+
+	// after the end, the trajectory rests at its final point
+	struct traj_eval last = piecewise_eval(&prepared, plain.t_begin + duration + 1.0f);
+	struct traj_eval end_point = poly4d_eval(&pieces[PIECES - 1], pieces[PIECES - 1].duration);
+	CHECK_NEAR(vdist(last.pos, end_point.pos), 0, 1e-6);
+	CHECK_NEAR(vmag(last.vel), 0, 0);
+}
+
+int main(void)
+{
+	test_storage_type(PPTRAJ_STORAGE_CONSTANT);
+	test_storage_type(PPTRAJ_STORAGE_LINEAR);
+	test_storage_type(PPTRAJ_STORAGE_BEZIER);
+	test_storage_type(PPTRAJ_STORAGE_FULL);
+	test_mixed_storage_types();
+	test_compressed_validate();
+	test_piecewise();
+
+	printf("%d failures\n", failures);
+	return failures == 0 ? 0 : 1;
+}
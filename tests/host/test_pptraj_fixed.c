@@ -0,0 +1,119 @@
+/*
+Checks the fixed-point evaluation of pptraj against a double precision
+evaluation of the same float coefficients.
+*/
+
+#include <math.h>
+#include <stdio.h>
+
+#include "pptraj.h"
+
+#define TRIALS 2000
+#define EVALS 50
+
+static int failures;
+
+static uint32_t xorshift(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+// uniform in [lo, hi]
+static float uniform(uint32_t *state, float lo, float hi)
+{
+	return lo + (hi - lo) * (xorshift(state) >> 8) / (float)(1 << 24);
+}
+
+// k! / (k - m)!
+static double falling_factorial(int k, int m)
+{
+	double f = 1;
+	for (int j = 0; j < m; ++j) {
+		f *= k - j;
+	}
+	return f;
+}
+
+// m-th derivative of p at t
+static double polyval_double(float const p[PP_SIZE], int m, double t)
+{
+	double x = 0;
+	for (int k = PP_DEGREE; k >= m; --k) {
+		x = x * t + falling_factorial(k, m) * p[k];
+	}
+	return x;
+}
+
+// error allowed for the m-th derivative at t: the coefficients are scaled to
+// normalized time in float, the horner evaluation is off by at most (8 - m)
+// units in its last place, and the result is converted back to float and
+// divided by duration^m.
+static double tolerance(struct poly4d const *piece, struct poly4d_fixed const *fixed, int dim, int m, double t)
+{
+	double const T = piece->duration;
+	double sum = 0;
+	for (int k = m; k < PP_SIZE; ++k) {
+		sum += falling_factorial(k, m) * fabs(piece->p[dim][k] * pow(T, k));
+	}
+	int const shift = (m == 0) ? 0 : fixed->der_shift[dim][m - 1];
+	double const ulp = ldexp(1.0, shift - fixed->exponent[dim]);
+	double const result = fabs(polyval_double(piece->p[dim], m, t));
+	return (sum * ldexp(1.0, -22) + (8 - m) * ulp) / pow(T, m) + result * (m + 2) * ldexp(1.0, -23);
+}
+
+static void check(char const *what, int trial, double value, double expected, double tol)
+{
+	if (!(fabs(value - expected) <= tol)) {
+		if (failures < 10) {
+			printf("trial %d: %s is %.9g, expected %.9g (tolerance %.3g)\n", trial, what, value, expected, tol);
+		}
+		failures++;
+	}
+}
+
+int main(void)
+{
+	uint32_t seed = 0x2545F491;
+	double max_pos_error = 0;
+
+	for (int trial = 0; trial < TRIALS; ++trial) {
+		// pieces as a planner would produce them: a few meters of travel,
+		// durations from a fraction of a second to several seconds
+		struct poly4d piece;
+		piece.duration = uniform(&seed, 0.1f, 8.0f);
+		for (int dim = 0; dim < 4; ++dim) {
+			float scale = uniform(&seed, 0.01f, 5.0f);
+			for (int k = 0; k < PP_SIZE; ++k) {
+				piece.p[dim][k] = scale * uniform(&seed, -1.0f, 1.0f) / powf(piece.duration, k);
+			}
+		}
+
+		struct poly4d_fixed fixed;
+		poly4d_to_fixed(&piece, &fixed);
+
+		for (int i = 0; i <= EVALS; ++i) {
+			float t = piece.duration * i / EVALS;
+			struct traj_eval ev = poly4d_fixed_eval(&fixed, t);
+			float const pos[3] = {ev.pos.x, ev.pos.y, ev.pos.z};
+			float const vel[3] = {ev.vel.x, ev.vel.y, ev.vel.z};
+			float const acc[3] = {ev.acc.x, ev.acc.y, ev.acc.z};
+
+			for (int dim = 0; dim < 3; ++dim) {
+				double expected = polyval_double(piece.p[dim], 0, t);
+				check("pos", trial, pos[dim], expected, tolerance(&piece, &fixed, dim, 0, t));
+				check("vel", trial, vel[dim], polyval_double(piece.p[dim], 1, t), tolerance(&piece, &fixed, dim, 1, t));
+				check("acc", trial, acc[dim], polyval_double(piece.p[dim], 2, t), tolerance(&piece, &fixed, dim, 2, t));
+				max_pos_error = fmax(max_pos_error, fabs(pos[dim] - expected));
+			}
+			check("yaw", trial, ev.yaw, polyval_double(piece.p[3], 0, t), tolerance(&piece, &fixed, 3, 0, t));
+		}
+	}
+
+	printf("%d pieces, largest position error %.3g m, %d failures\n", TRIALS, max_pos_error, failures);
+	return failures == 0 ? 0 : 1;
+}